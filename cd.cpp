@@ -8,43 +8,330 @@
 #include <string>
 #include <sstream>
 #include <iomanip>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "routing.h"
 
 using namespace std;
 
-// ------------------------ HAVERSINE ------------------------
-double haversine(double lat1, double lon1, double lat2, double lon2) {
-    const double R = 6371.0;
-    const double p = 3.14159265358979323846 / 180.0;
+// ============================================================
+//                       ROUTE MAP
+// ============================================================
+// Offline map of the road network, drawn from node coordinates.
+// - nodes are projected once to a local km plane (x east, y south of the centre)
+// - roads are kept at several levels of detail: level 0 is every road, coarser levels
+//   merge the nodes of each grid cell (LOD_BASE_KM, doubled per level) into one point,
+//   and a frame uses the coarsest level whose cells stay under LOD_MAX_PX on screen
+// - each level's segments are bucketed on a coarse grid, so a frame only walks the
+//   buckets inside the viewport
+// - the road layer is rendered into an offscreen surface that is reused until the view
+//   changes; a new route only invalidates the screen box around the old and new route
+class RouteMap : public Gtk::DrawingArea {
+public:
+    explicit RouteMap(RtGraph *graph);
+    void set_route(const std::vector<int>& path);
+
+protected:
+    bool on_draw(const Cairo::RefPtr<Cairo::Context>& cr) override;
+    bool on_button_press_event(GdkEventButton *ev) override;
+    bool on_button_release_event(GdkEventButton *ev) override;
+    bool on_motion_notify_event(GdkEventMotion *ev) override;
+    bool on_scroll_event(GdkEventScroll *ev) override;
+
+private:
+    static constexpr double LOD_BASE_KM = 0.05;
+    static constexpr double LOD_MAX_PX = 4.0;
+    static constexpr size_t LOD_MIN_SEGS = 4000;   // stop coarsening below this many segments
+    static constexpr int BUCKETS = 64;             // per side of the bucket grid
+
+    struct Pt { double x, y; };
+    struct Seg { int a, b; };
+    struct Lod {
+        double cell_km;                            // 0 for full detail
+        std::vector<Pt> pts;
+        std::vector<Seg> segs;
+        std::vector<int> bucket_off, bucket_seg;   // segments touching bucket i: bucket_seg[bucket_off[i] .. bucket_off[i+1])
+    };
 
-    lat1 *= p; lon1 *= p;
-    lat2 *= p; lon2 *= p;
+    RtGraph *rg;
+    std::vector<Pt> node_pt;
+    std::vector<char> has_pt;
+    std::vector<int> stations;                     // typed nodes, drawn as markers
+    std::vector<Lod> lods;
+    double min_x = 0, min_y = 0, max_x = 0, max_y = 0, bucket_km = 1;
+    int bw = 1, bh = 1;
+
+    double scale = 1, ox = 0, oy = 0;              // screen = km * scale + offset
+    bool fitted = false, dragging = false;
+    double drag_x = 0, drag_y = 0;
+
+    Cairo::RefPtr<Cairo::ImageSurface> base;
+    double base_scale = 0, base_ox = 0, base_oy = 0;
+    std::vector<unsigned> seen;                    // per segment: last frame that drew it
+    unsigned frame = 0;
+
+    std::vector<int> route;
+
+    void build_lod(double cell_km);
+    const Lod& pick_lod() const;
+    void fit_view(int w, int h);
+    void render_base(int w, int h);
+    void queue_route_area();
+    Pt screen(const Pt& p) const { return {p.x * scale + ox, p.y * scale + oy}; }
+};
 
-    double d1 = lat2 - lat1;
-    double d2 = lon2 - lon1;
+RouteMap::RouteMap(RtGraph *graph) : rg(graph) {
+    set_size_request(640, 400);
+    add_events(Gdk::BUTTON_PRESS_MASK | Gdk::BUTTON_RELEASE_MASK | Gdk::POINTER_MOTION_MASK | Gdk::SCROLL_MASK);
+
+    const double km_per_deg = 6371.0 * 3.14159265358979323846 / 180.0;
+    int n = rt_node_count(rg), placed = 0;
+    double lat0 = 0, lon0 = 0, lat, lon;
+    for(int i = 0; i < n; i++)
+        if(rt_coords(rg, i, &lat, &lon)){ lat0 += lat; lon0 += lon; placed++; }
+    if(placed){ lat0 /= placed; lon0 /= placed; }
+    double kx = km_per_deg * cos(lat0 * 3.14159265358979323846 / 180.0);
+
+    node_pt.assign(n, {0, 0});
+    has_pt.assign(n, 0);
+    bool first = true;
+    for(int i = 0; i < n; i++){
+        if(!rt_coords(rg, i, &lat, &lon)) continue;
+        Pt p{(lon - lon0) * kx, (lat0 - lat) * km_per_deg};
+        node_pt[i] = p; has_pt[i] = 1;
+        if(first){ min_x = max_x = p.x; min_y = max_y = p.y; first = false; }
+        min_x = std::min(min_x, p.x); max_x = std::max(max_x, p.x);
+        min_y = std::min(min_y, p.y); max_y = std::max(max_y, p.y);
+        if(rt_type(rg, i) && (rt_node_matches(rg, i, "hospital") || rt_node_matches(rg, i, "police") || rt_node_matches(rg, i, "fire")))
+            stations.push_back(i);
+    }
+    double span = std::max({max_x - min_x, max_y - min_y, 0.01});
+    bucket_km = span / BUCKETS;
+    bw = int((max_x - min_x) / bucket_km) + 1;
+    bh = int((max_y - min_y) / bucket_km) + 1;
+
+    build_lod(0);
+    for(double c = LOD_BASE_KM; lods.back().segs.size() > LOD_MIN_SEGS && c < span; c *= 2){
+        size_t finer = lods.back().segs.size();
+        build_lod(c);
+        if(lods.back().segs.size() > finer * 4 / 5) lods.pop_back();   // cells still below node spacing
+    }
+}
 
-    double a = sin(d1/2)*sin(d1/2) +
-               cos(lat1)*cos(lat2) * sin(d2/2)*sin(d2/2);
+void RouteMap::build_lod(double cell_km) {
+    Lod lod;
+    lod.cell_km = cell_km;
+    int n = node_pt.size();
+    std::vector<int> rep(n, -1);               // node -> point of this level
+    if(cell_km == 0){
+        for(int i = 0; i < n; i++) if(has_pt[i]){ rep[i] = lod.pts.size(); lod.pts.push_back(node_pt[i]); }
+    } else {
+        // merged point = centroid of the cell's nodes
+        std::unordered_map<long long, int> cell;
+        std::vector<int> count;
+        for(int i = 0; i < n; i++){
+            if(!has_pt[i]) continue;
+            long long cx = (long long)((node_pt[i].x - min_x) / cell_km), cy = (long long)((node_pt[i].y - min_y) / cell_km);
+            auto it = cell.emplace((cx << 32) | cy, (int)lod.pts.size());
+            if(it.second){ lod.pts.push_back({0, 0}); count.push_back(0); }
+            int k = it.first->second;
+            lod.pts[k].x += node_pt[i].x; lod.pts[k].y += node_pt[i].y; count[k]++;
+            rep[i] = k;
+        }
+        for(size_t k = 0; k < lod.pts.size(); k++){ lod.pts[k].x /= count[k]; lod.pts[k].y /= count[k]; }
+    }
 
-    return 2 * R * atan2(sqrt(a), sqrt(1 - a));
+    // one segment per connected pair of points; two-way roads and merged parallels collapse
+    std::unordered_set<long long> pairs;
+    std::vector<int> nb(16);
+    for(int u = 0; u < n; u++){
+        if(rep[u] < 0) continue;
+        int d = rt_neighbors(rg, u, nb.data(), nullptr, nb.size());
+        if(d > (int)nb.size()){ nb.resize(d); rt_neighbors(rg, u, nb.data(), nullptr, d); }
+        for(int i = 0; i < d; i++){
+            int a = rep[u], b = rep[nb[i]];
+            if(b < 0 || a == b) continue;
+            if(a > b) std::swap(a, b);
+            if(pairs.insert(((long long)a << 32) | b).second) lod.segs.push_back({a, b});
+        }
+    }
+
+    // bucket every segment into each grid cell its bounding box touches (counting pass, then fill)
+    auto cells = [&](const Seg& s, int& x0, int& x1, int& y0, int& y1){
+        const Pt &p = lod.pts[s.a], &q = lod.pts[s.b];
+        x0 = std::clamp(int((std::min(p.x, q.x) - min_x) / bucket_km), 0, bw - 1);
+        x1 = std::clamp(int((std::max(p.x, q.x) - min_x) / bucket_km), 0, bw - 1);
+        y0 = std::clamp(int((std::min(p.y, q.y) - min_y) / bucket_km), 0, bh - 1);
+        y1 = std::clamp(int((std::max(p.y, q.y) - min_y) / bucket_km), 0, bh - 1);
+    };
+    lod.bucket_off.assign(bw * bh + 1, 0);
+    int x0, x1, y0, y1;
+    for(auto& s : lod.segs){
+        cells(s, x0, x1, y0, y1);
+        for(int y = y0; y <= y1; y++) for(int x = x0; x <= x1; x++) lod.bucket_off[y * bw + x + 1]++;
+    }
+    for(int i = 0; i < bw * bh; i++) lod.bucket_off[i + 1] += lod.bucket_off[i];
+    lod.bucket_seg.resize(lod.bucket_off.back());
+    std::vector<int> fill(lod.bucket_off.begin(), lod.bucket_off.end() - 1);
+    for(size_t si = 0; si < lod.segs.size(); si++){
+        cells(lod.segs[si], x0, x1, y0, y1);
+        for(int y = y0; y <= y1; y++) for(int x = x0; x <= x1; x++) lod.bucket_seg[fill[y * bw + x]++] = si;
+    }
+    lods.push_back(std::move(lod));
+}
+
+const RouteMap::Lod& RouteMap::pick_lod() const {
+    for(size_t k = lods.size() - 1; k > 0; k--)
+        if(lods[k].cell_km * scale <= LOD_MAX_PX) return lods[k];
+    return lods[0];
+}
+
+void RouteMap::fit_view(int w, int h) {
+    double sx = w / std::max(max_x - min_x, 0.01), sy = h / std::max(max_y - min_y, 0.01);
+    scale = 0.92 * std::min(sx, sy);
+    ox = w / 2.0 - scale * (min_x + max_x) / 2;
+    oy = h / 2.0 - scale * (min_y + max_y) / 2;
+    fitted = true;
+}
+
+void RouteMap::render_base(int w, int h) {
+    if(!base || base->get_width() != w || base->get_height() != h)
+        base = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, w, h);
+    auto cr = Cairo::Context::create(base);
+    cr->set_source_rgb(0.96, 0.96, 0.94);
+    cr->paint();
+
+    // visible buckets only; a segment spanning several buckets is drawn once per frame
+    const Lod& lod = pick_lod();
+    if(seen.size() < lod.segs.size()) seen.resize(lod.segs.size(), 0);
+    if(++frame == 0){ std::fill(seen.begin(), seen.end(), 0); frame = 1; }
+    int bx0 = std::clamp(int(((0 - ox) / scale - min_x) / bucket_km), 0, bw - 1);
+    int bx1 = std::clamp(int(((w - ox) / scale - min_x) / bucket_km), 0, bw - 1);
+    int by0 = std::clamp(int(((0 - oy) / scale - min_y) / bucket_km), 0, bh - 1);
+    int by1 = std::clamp(int(((h - oy) / scale - min_y) / bucket_km), 0, bh - 1);
+    cr->set_source_rgb(0.55, 0.57, 0.62);
+    cr->set_line_width(lod.cell_km > 0 ? 1.0 : 1.5);
+    for(int y = by0; y <= by1; y++) for(int x = bx0; x <= bx1; x++){
+        int b = y * bw + x;
+        for(int i = lod.bucket_off[b]; i < lod.bucket_off[b + 1]; i++){
+            int s = lod.bucket_seg[i];
+            if(seen[s] == frame) continue;
+            seen[s] = frame;
+            Pt p = screen(lod.pts[lod.segs[s].a]), q = screen(lod.pts[lod.segs[s].b]);
+            cr->move_to(p.x, p.y);
+            cr->line_to(q.x, q.y);
+        }
+    }
+    cr->stroke();
+
+    for(int v : stations){
+        Pt p = screen(node_pt[v]);
+        if(p.x < -5 || p.y < -5 || p.x > w + 5 || p.y > h + 5) continue;
+        if(rt_node_matches(rg, v, "hospital")) cr->set_source_rgb(0.85, 0.1, 0.1);
+        else if(rt_node_matches(rg, v, "police")) cr->set_source_rgb(0.1, 0.25, 0.8);
+        else cr->set_source_rgb(0.95, 0.5, 0.0);
+        cr->arc(p.x, p.y, 4, 0, 2 * 3.14159265358979323846);
+        cr->fill();
+    }
+    base_scale = scale; base_ox = ox; base_oy = oy;
 }
 
-// URL-encode (simple, safe for query params)
-static std::string url_encode(const std::string &value) {
-    std::ostringstream escaped;
-    escaped.fill('0');
-    escaped << std::hex << std::uppercase;
-
-    for (unsigned char c : value) {
-        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
-            escaped << c;
-        } else if (c == ' ') {
-            escaped << '+';
-        } else {
-            escaped << '%' << std::setw(2) << int(c);
+bool RouteMap::on_draw(const Cairo::RefPtr<Cairo::Context>& cr) {
+    int w = get_allocated_width(), h = get_allocated_height();
+    if(w <= 1 || h <= 1 || lods.empty()) return true;
+    if(!fitted) fit_view(w, h);
+
+    // while dragging, slide the last road layer instead of re-rendering it
+    bool same_size = base && base->get_width() == w && base->get_height() == h;
+    bool same_view = base_scale == scale && base_ox == ox && base_oy == oy;
+    if(!same_size || (!same_view && !(dragging && base_scale == scale))) render_base(w, h);
+    cr->set_source(base, ox - base_ox, oy - base_oy);
+    cr->paint();
+
+    if(route.size() > 1){
+        cr->set_line_width(4.0);
+        cr->set_line_cap(Cairo::LINE_CAP_ROUND);
+        cr->set_line_join(Cairo::LINE_JOIN_ROUND);
+        cr->set_source_rgba(0.0, 0.6, 0.25, 0.9);
+        bool pen = false;
+        for(int v : route){
+            if(!has_pt[v]){ pen = false; continue; }
+            Pt p = screen(node_pt[v]);
+            if(pen) cr->line_to(p.x, p.y); else cr->move_to(p.x, p.y);
+            pen = true;
+        }
+        cr->stroke();
+    }
+    if(!route.empty()){
+        const int ends[2] = {route.front(), route.back()};
+        for(int k = 0; k < 2; k++){
+            if(!has_pt[ends[k]]) continue;
+            Pt p = screen(node_pt[ends[k]]);
+            cr->set_source_rgb(k ? 0.85 : 0.0, k ? 0.1 : 0.6, k ? 0.1 : 0.25);
+            cr->arc(p.x, p.y, 6, 0, 2 * 3.14159265358979323846);
+            cr->fill();
         }
     }
+    return true;
+}
+
+// screen box around the current route, padded for the line width and end markers
+void RouteMap::queue_route_area() {
+    double x0 = 1e18, y0 = 1e18, x1 = -1e18, y1 = -1e18;
+    for(int v : route){
+        if(!has_pt[v]) continue;
+        Pt p = screen(node_pt[v]);
+        x0 = std::min(x0, p.x); x1 = std::max(x1, p.x);
+        y0 = std::min(y0, p.y); y1 = std::max(y1, p.y);
+    }
+    if(x0 > x1) return;
+    queue_draw_area(int(x0) - 8, int(y0) - 8, int(x1 - x0) + 17, int(y1 - y0) + 17);
+}
+
+void RouteMap::set_route(const std::vector<int>& path) {
+    queue_route_area();
+    route = path;
+    queue_route_area();
+}
+
+bool RouteMap::on_button_press_event(GdkEventButton *ev) {
+    if(ev->button != 1) return false;
+    dragging = true; drag_x = ev->x; drag_y = ev->y;
+    return true;
+}
+
+bool RouteMap::on_button_release_event(GdkEventButton *ev) {
+    if(ev->button != 1) return false;
+    dragging = false;
+    queue_draw();                               // re-render the road layer at the new offset
+    return true;
+}
 
-    return escaped.str();
+bool RouteMap::on_motion_notify_event(GdkEventMotion *ev) {
+    if(!dragging) return false;
+    ox += ev->x - drag_x; oy += ev->y - drag_y;
+    drag_x = ev->x; drag_y = ev->y;
+    queue_draw();
+    return true;
+}
+
+bool RouteMap::on_scroll_event(GdkEventScroll *ev) {
+    double f = 1.0;
+    if(ev->direction == GDK_SCROLL_UP) f = 1.25;
+    else if(ev->direction == GDK_SCROLL_DOWN) f = 0.8;
+    else if(ev->direction == GDK_SCROLL_SMOOTH) f = pow(1.25, -ev->delta_y);
+    if(f == 1.0) return false;
+    // zoom about the pointer
+    ox = ev->x - (ev->x - ox) * f;
+    oy = ev->y - (ev->y - oy) * f;
+    scale *= f;
+    queue_draw();
+    return true;
 }
 
 // ============================================================
@@ -52,43 +339,52 @@ static std::string url_encode(const std::string &value) {
 // ============================================================
 class DispatchWindow : public Gtk::Window {
 public:
-    DispatchWindow();
+    explicit DispatchWindow(RtGraph *graph);
+    ~DispatchWindow() override;
 
 private:
     // GUI
     Gtk::Box main_box{Gtk::ORIENTATION_VERTICAL};
     Gtk::Grid grid;
     Gtk::Label lbl_title, lbl_location, lbl_emergency, lbl_severity, lbl_status;
-    Gtk::ComboBoxText cb_location;
+    Gtk::ComboBoxText cb_location{true}; // with entry: accepts a typed "lat,lon" GPS fix
     Gtk::ComboBoxText cb_emergency, cb_severity;
     Gtk::Button btn_dispatch, btn_route;
     Gtk::Box button_box{Gtk::ORIENTATION_HORIZONTAL};
 
-    // Data
-    struct Station {
-        std::string name;
-        double lat, lon;
-        std::string type; // "hospital", "police", "fire"
-    };
-
-    std::map<std::string, Station> stations;
-    std::map<std::string, std::pair<double,double>> location_coords;
-
-    // Graph
-    std::map<std::string,int> node_index;
-    std::vector<std::string> index_node;
-    std::vector<std::vector<std::pair<int,double>>> graph;  // (to, weight)
-    std::vector<int> parent;
-
-    // Last dispatch
-    std::string last_location;
-    std::string nearest_hospital, nearest_fire, nearest_police;
+    // Road network (nodes.csv / edges.csv) behind the shared routing core
+    RtGraph *rg;
+    RouteMap map_view{rg};
+
+    // Async routing: one worker thread runs the newest request; a newer click bumps
+    // query_gen, which makes an in-flight search abandon itself.
+    struct RouteJob { unsigned gen; int start; std::string loc, snapped; };
+    // stations and routes are indexed hospital, police, fire; station -1 when none is reachable
+    struct RouteResult { unsigned gen; std::string loc, snapped; int station[3]; double eta[3]; std::vector<int> path[3]; bool cached; };
+    std::thread routing_thread;
+    std::mutex job_mu;
+    std::condition_variable job_cv;
+    bool job_pending = false, routing_stop = false;
+    RouteJob job;
+    std::mutex result_mu;
+    RouteResult result;
+    RouteResult last{};                       // last completed dispatch, gen 0 before the first
+    Glib::Dispatcher route_ready;
+    std::atomic<unsigned> query_gen{0};
+    std::atomic<int> search_settled{0};
+    sigc::connection progress_timer;
+    std::string routing_from;
 
     // Methods
-    void build_graph();
-    std::pair<double,double> get_coordinates(const std::string& name);
-    std::vector<double> dijkstra(int start);
-    std::vector<int> build_path(int start, int goal);
+    std::string node_label(int node) const;
+    static int search_progress(void *ctx, int settled, int total);
+    void routing_worker();
+    RouteResult run_route_job(const RouteJob& j);
+    void on_route_ready();
+    bool on_progress_tick();
+
+    int selected_kind();
+    void show_route();
 
     // Buttons
     void on_dispatch_clicked();
@@ -98,9 +394,9 @@ private:
 // ============================================================
 //                       CONSTRUCTOR
 // ============================================================
-DispatchWindow::DispatchWindow() {
+DispatchWindow::DispatchWindow(RtGraph *graph) : rg(graph) {
     set_title("Emergency Dispatch System (Dijkstra)");
-    set_default_size(700, 560);
+    set_default_size(900, 760);
     add(main_box);
 
     lbl_title.set_markup("<span size='xx-large' weight='bold'>🚒 Emergency Dispatch</span>");
@@ -137,6 +433,9 @@ DispatchWindow::DispatchWindow() {
     btn_dispatch.set_label("🚓 Dispatch Units");
     btn_route.set_label("🗺 Show Route");
 
+    map_view.set_hexpand();
+    map_view.set_vexpand();
+
     btn_dispatch.signal_clicked()
         .connect(sigc::mem_fun(*this, &DispatchWindow::on_dispatch_clicked));
     btn_route.signal_clicked()
@@ -149,150 +448,54 @@ DispatchWindow::DispatchWindow() {
 
     lbl_status.set_text("System ready.");
     main_box.pack_start(lbl_status, Gtk::PACK_SHRINK);
-
-    // ----------- Load Stations -----------------
-    // Updated with exact coordinates you provided
-    stations = {
-        // Hospitals
-        {"Shri Mahant Indiresh Hospital", {"Shri Mahant Indiresh Hospital", 30.3047, 78.0207, "hospital"}},
-        {"Panacea Hospital Dehradun",      {"Panacea Hospital Dehradun",     30.3175, 78.0260, "hospital"}},
-        {"Max Super Speciality Hospital",  {"Max Super Speciality Hospital", 30.3829, 78.0891, "hospital"}},
-        {"Synergy Hospital",               {"Synergy Hospital",              30.3375, 78.0136, "hospital"}},
-
-        // Police
-        {"Clement Town Police Station",   {"Clement Town Police Station",  30.3156, 78.0361, "police"}},
-        {"ISBT Police Chowki",            {"ISBT Police Chowki",           30.2884, 77.9972, "police"}},
-        {"Ghanta Ghar Police Chowki",     {"Ghanta Ghar Police Chowki",    30.3240, 78.0416, "police"}},
-        {"Rajpur Police Station",         {"Rajpur Police Station",        30.3631, 78.0683, "police"}},
-
-        // Fire
-        {"Dehradun Fire Station",         {"Dehradun Fire Station",        30.3165, 78.0322, "fire"}},
-        {"Rajpur Road Fire Station",      {"Rajpur Road Fire Station",     30.3371, 78.0528, "fire"}}
-    };
-
-    // ----------- Load Locations -----------------
-    location_coords = {
-        {"Graphic Era University", {30.3196, 78.0413}},
-        {"Clement Town",           {30.315, 78.035}},
-        {"ISBT",                   {30.317, 78.028}},
-        {"Clock Tower",            {30.325, 78.040}},
-        {"Rajpur Road",            {30.353, 78.075}},
-        {"Subhash Nagar",          {30.317, 78.030}}
-    };
-
-    // Populate location combobox so user selects an exact name (so it can be pasted/encoded)
-    for (auto &p : location_coords) {
-        cb_location.append(p.first);
-    }
+    main_box.pack_start(map_view, Gtk::PACK_EXPAND_WIDGET);
+
+    // Every named place in nodes.csv; a typed "lat,lon" is snapped to the nearest road node
+    std::vector<std::string> names;
+    for(int i = 0; i < rt_node_count(rg); i++)
+        if(rt_name(rg, i)) names.push_back(rt_name(rg, i));
+    std::sort(names.begin(), names.end());
+    for(auto &n : names) cb_location.append(n);
     cb_location.set_active(0);
 
-    build_graph();
     show_all_children();
-}
 
-// ============================================================
-//                          GRAPH
-// ============================================================
-std::pair<double,double> DispatchWindow::get_coordinates(const std::string& name){
-    if(location_coords.count(name)) return location_coords[name];
-    if(stations.count(name)) return {stations.at(name).lat, stations.at(name).lon};
-    return {0,0};
+    route_ready.connect(sigc::mem_fun(*this, &DispatchWindow::on_route_ready));
+    routing_thread = std::thread(&DispatchWindow::routing_worker, this);
 }
 
-void DispatchWindow::build_graph() {
-    node_index.clear();
-    index_node.clear();
-
-    // Ensure deterministic insertion order: insert locations first, then stations
-    for(auto& p : location_coords){
-        node_index[p.first] = index_node.size();
-        index_node.push_back(p.first);
-    }
-    for(auto& s : stations){
-        node_index[s.first] = index_node.size();
-        index_node.push_back(s.first);
+DispatchWindow::~DispatchWindow() {
+    {
+        std::lock_guard<std::mutex> lock(job_mu);
+        routing_stop = true;
     }
-
-    int N = index_node.size();
-    graph.assign(N, {});
-
-    auto add_road = [&](const std::string& A, const std::string& B){
-        if(!node_index.count(A) || !node_index.count(B)) return;
-        auto [latA, lonA] = get_coordinates(A);
-        auto [latB, lonB] = get_coordinates(B);
-        double d = haversine(latA, lonA, latB, lonB);
-
-        int a = node_index[A];
-        int b = node_index[B];
-
-        graph[a].push_back({b, d});
-        graph[b].push_back({a, d});
-    };
-
-    // Connect locations among themselves (simple local graph)
-    add_road("Graphic Era University", "Clement Town");
-    add_road("Clement Town", "ISBT");
-    add_road("ISBT", "Clock Tower");
-    add_road("Clock Tower", "Graphic Era University");
-    add_road("Clock Tower", "Rajpur Road");
-    add_road("ISBT", "Subhash Nagar");
-    add_road("Subhash Nagar", "Graphic Era University");
-
-    // Connect stations to nearby location nodes (so Dijkstra can reach them realistically)
-    add_road("Shri Mahant Indiresh Hospital", "ISBT");
-    add_road("Shri Mahant Indiresh Hospital", "Subhash Nagar");
-    add_road("Panacea Hospital Dehradun", "ISBT");
-    add_road("Synergy Hospital", "Clock Tower");
-    add_road("Max Super Speciality Hospital", "Rajpur Road");
-
-    add_road("Clement Town Police Station", "Clement Town");
-    add_road("ISBT Police Chowki", "ISBT");
-    add_road("Ghanta Ghar Police Chowki", "Clock Tower");
-    add_road("Rajpur Police Station", "Rajpur Road");
-
-    add_road("Dehradun Fire Station", "Clement Town");
-    add_road("Dehradun Fire Station", "Clock Tower");
-    add_road("Dehradun Fire Station", "Rajpur Road");
-    add_road("Rajpur Road Fire Station", "Rajpur Road");
+    query_gen++;            // abandon any in-flight search
+    job_cv.notify_one();
+    routing_thread.join();
+    progress_timer.disconnect();
 }
 
 // ============================================================
-//                       DIJKSTRA
+//                          GRAPH
 // ============================================================
-std::vector<double> DispatchWindow::dijkstra(int start){
-    int n = graph.size();
-    std::vector<double> dist(n, 1e18);
-    parent.assign(n, -1);
-
-    using P = std::pair<double,int>;
-    std::priority_queue<P, std::vector<P>, std::greater<P>> pq;
-
-    dist[start] = 0;
-    pq.push({0,start});
-
-    while(!pq.empty()){
-        auto [d,u] = pq.top(); pq.pop();
-        if(d != dist[u]) continue;
-
-        for(auto &e : graph[u]){
-            int v = e.first;
-            double w = e.second;
-            if(dist[v] > d + w){
-                dist[v] = d + w;
-                parent[v] = u;
-                pq.push({dist[v], v});
-            }
-        }
-    }
-    return dist;
+// Name for the status line and route listings; unnamed junctions fall back to coordinates
+std::string DispatchWindow::node_label(int node) const {
+    if(rt_name(rg, node)) return rt_name(rg, node);
+    double lat, lon;
+    std::ostringstream s;
+    if(rt_coords(rg, node, &lat, &lon)) s << std::fixed << std::setprecision(5) << lat << "," << lon;
+    else s << rt_ext_id(rg, node);
+    return s.str();
 }
 
-std::vector<int> DispatchWindow::build_path(int start, int goal) {
-    std::vector<int> path;
-    for(int v = goal; v != -1; v = parent[v])
-        path.push_back(v);
-    std::reverse(path.begin(), path.end());
-    return path;
+// Progress hook of rt_nearest_of_type, called on the routing thread. Returning
+// nonzero abandons the search once a newer request (query_gen != gen) arrives.
+struct SearchCtx { DispatchWindow *win; unsigned gen; };
+int DispatchWindow::search_progress(void *ctx, int settled, int total) {
+    auto *c = static_cast<SearchCtx*>(ctx);
+    (void)total;
+    c->win->search_settled = settled;
+    return c->win->query_gen != c->gen;
 }
 
 // ============================================================
@@ -300,92 +503,180 @@ std::vector<int> DispatchWindow::build_path(int start, int goal) {
 // ============================================================
 void DispatchWindow::on_dispatch_clicked() {
     std::string loc = cb_location.get_active_text();
+    std::string snapped;
 
-    if(!node_index.count(loc)){
+    double snap_km;
+    int start = rt_resolve(rg, loc.c_str(), &snap_km);
+    if(start == -1){
         lbl_status.set_text("Unknown location.");
         return;
     }
+    if(snap_km >= 0){
+        std::ostringstream note;
+        note << " (GPS " << loc << " snapped " << std::fixed << std::setprecision(0) << snap_km * 1000.0 << " m)";
+        snapped = note.str();
+    }
+    loc = node_label(start);
 
-    int start = node_index[loc];
-    auto dist = dijkstra(start);
-
-    double bestH = 1e18, bestF = 1e18, bestP = 1e18;
-    nearest_hospital.clear(); nearest_fire.clear(); nearest_police.clear();
+    RouteJob j{++query_gen, start, loc, snapped};
+    {
+        std::lock_guard<std::mutex> lock(job_mu);
+        job = j;
+        job_pending = true;
+    }
+    job_cv.notify_one();
 
-    for(auto& sp : stations){
-        const auto &s = sp.second;
-        int id = node_index[s.name];
+    routing_from = loc;
+    lbl_status.set_text("Routing from " + loc + "...");
+    if(!progress_timer.connected())
+        progress_timer = Glib::signal_timeout().connect(sigc::mem_fun(*this, &DispatchWindow::on_progress_tick), 100);
+}
 
-        if(s.type == "hospital" && dist[id] < bestH){
-            bestH = dist[id];
-            nearest_hospital = s.name;
-        }
-        if(s.type == "fire" && dist[id] < bestF){
-            bestF = dist[id];
-            nearest_fire = s.name;
+// ============================================================
+//                  ROUTING THREAD
+// ============================================================
+void DispatchWindow::routing_worker() {
+    while(true){
+        RouteJob j;
+        {
+            std::unique_lock<std::mutex> lock(job_mu);
+            job_cv.wait(lock, [this]{ return job_pending || routing_stop; });
+            if(routing_stop) return;
+            j = job;
+            job_pending = false;
         }
-        if(s.type == "police" && dist[id] < bestP){
-            bestP = dist[id];
-            nearest_police = s.name;
+        if(j.gen != query_gen) continue;
+        RouteResult r = run_route_job(j);
+        if(r.gen != query_gen) continue;      // superseded while searching
+        {
+            std::lock_guard<std::mutex> lock(result_mu);
+            result = r;
         }
+        route_ready.emit();
+    }
+}
+
+DispatchWindow::RouteResult DispatchWindow::run_route_job(const RouteJob& j) {
+    RouteResult r{j.gen, j.loc, j.snapped, {-1, -1, -1}, {0, 0, 0}, {}, true};
+
+    // One early-exit search per kind picks the station nearest the incident; repeats from the
+    // same place are route cache hits. Roads can be one-way, so the unit's route and ETA are
+    // then routed station -> incident; empty path when the station cannot reach it.
+    unsigned long long misses_before, misses_after;
+    rt_cache_stats(rg, nullptr, &misses_before);
+    SearchCtx ctx{this, j.gen};
+    search_settled = 0;
+    const char *kinds[3] = {"hospital", "police", "fire"};
+    std::vector<int> path(rt_node_count(rg) + 1);
+    for(int k = 0; k < 3; k++){
+        int len = 0;
+        r.station[k] = rt_nearest_of_type(rg, j.start, kinds[k], nullptr, nullptr, nullptr, &DispatchWindow::search_progress, &ctx);
+        if(query_gen != j.gen) return r;      // cancelled; caller drops it by gen
+        if(r.station[k] == -1) continue;
+        r.eta[k] = rt_route(rg, r.station[k], j.start, path.data(), &len);
+        r.path[k].assign(path.begin(), path.begin() + len);
+    }
+    rt_cache_stats(rg, nullptr, &misses_after);
+    r.cached = misses_after == misses_before;
+    return r;
+}
+
+// GUI thread: Glib::Dispatcher delivers the worker's result here
+void DispatchWindow::on_route_ready() {
+    RouteResult r;
+    {
+        std::lock_guard<std::mutex> lock(result_mu);
+        r = result;
     }
+    if(r.gen != query_gen) return;            // a newer click is still routing
 
-    last_location = loc;
+    progress_timer.disconnect();
+    last = r;
+    auto name = [&](int k){ return r.station[k] == -1 ? std::string("(none)") : node_label(r.station[k]); };
 
     std::ostringstream stat;
-    stat << "Dispatched from " << loc << ": ";
-    stat << "Hospital=" << (nearest_hospital.empty()?"(none)":nearest_hospital) << ", ";
-    stat << "Police=" << (nearest_police.empty()?"(none)":nearest_police) << ", ";
-    stat << "Fire=" << (nearest_fire.empty()?"(none)":nearest_fire) << ".";
+    stat << "Dispatched from " << r.loc << ": ";
+    stat << "Hospital=" << name(0) << ", ";
+    stat << "Police=" << name(1) << ", ";
+    stat << "Fire=" << name(2) << "." << r.snapped;
+    unsigned long long hits, misses;
+    rt_cache_stats(rg, &hits, &misses);
+    stat << (r.cached ? " [cached" : " [computed") << ", hit rate " << std::fixed << std::setprecision(0) << (hits + misses ? 100.0 * hits / (hits + misses) : 0.0) << "%]";
 
     lbl_status.set_text(stat.str());
+    show_route();
+}
+
+bool DispatchWindow::on_progress_tick() {
+    int n = std::max(rt_node_count(rg), 1);
+    std::ostringstream stat;
+    stat << "Routing from " << routing_from << "... " << std::min(100, 100 * search_settled.load() / n) << "% of network searched";
+    lbl_status.set_text(stat.str());
+    return true;
 }
 
 // ============================================================
-//                ROUTE BUTTON (GOOGLE MAPS)
+//                ROUTE BUTTON (OFFLINE MAP)
 // ============================================================
-void DispatchWindow::on_route_clicked() {
-    if(last_location.empty()){
-        lbl_status.set_text("Dispatch first!");
-        return;
-    }
-
+// Overlays the route for the selected emergency type on the map; the paths were
+// computed with the dispatch, so this never searches on the GUI thread.
+int DispatchWindow::selected_kind() {
     Glib::ustring g_em = cb_emergency.get_active_text();
     std::string emergency = g_em.raw();
 
-    std::string dest;
+    if(emergency == "Fire") return 2;
+    if(emergency == "Crime" || emergency == "Accident") return 1;
+    return 0;                                 // Medical Emergency
+}
 
-    if(emergency == "Fire") dest = nearest_fire;
-    else if(emergency == "Crime" || emergency == "Accident") dest = nearest_police;
-    else dest = nearest_hospital; // Medical Emergency
+void DispatchWindow::show_route() {
+    int k = selected_kind();
+    // station -> incident as routed; empty clears the overlay
+    map_view.set_route(last.path[k]);
+}
 
-    if(dest.empty()){
+void DispatchWindow::on_route_clicked() {
+    if(last.gen == 0){
+        lbl_status.set_text("Dispatch first!");
+        return;
+    }
+    show_route();
+    int k = selected_kind();
+    if(last.station[k] == -1){
         lbl_status.set_text("No suitable destination found.");
         return;
     }
+    if(last.eta[k] >= RT_UNREACHABLE){
+        lbl_status.set_text("No road from " + node_label(last.station[k]) + " to " + last.loc + ".");
+        return;
+    }
 
-    std::string origin_text = url_encode(last_location);
-    std::string dest_text = url_encode(dest);
-
-    std::string url = "https://www.google.com/maps/dir/?api=1&origin=" +
-                 origin_text + "&destination=" + dest_text;
-
-#ifdef _WIN32
-    std::string cmd = "start \"\" \"" + url + "\"";
-    system(cmd.c_str());
-#else
-    std::string cmd = "xdg-open \"" + url + "\"";
-    system(cmd.c_str());
-#endif
-
-    lbl_status.set_text("Opening route in browser...");
+    std::ostringstream stat;
+    stat << "Route " << node_label(last.station[k]) << " -> " << last.loc << ": "
+         << std::fixed << std::setprecision(1) << last.eta[k] / 60.0 << " min, " << last.path[k].size() << " nodes";
+    lbl_status.set_text(stat.str());
 }
 
 // ============================================================
 //                          MAIN
 // ============================================================
+// Usage: cd [nodes.csv edges.csv]
 int main(int argc, char *argv[]) {
-    auto app = Gtk::Application::create(argc, argv, "org.gtkmm.dispatch");
-    DispatchWindow window;
-    return app->run(window);
+    const char *nodes_csv = argc > 1 ? argv[1] : "nodes.csv";
+    const char *edges_csv = argc > 2 ? argv[2] : "edges.csv";
+    RtGraph *rg = rt_load(nodes_csv, edges_csv);
+    if(!rg){
+        std::cerr << "Failed to load " << nodes_csv << " / " << edges_csv << std::endl;
+        return 1;
+    }
+
+    int gtk_argc = 1;                 // the csv paths are ours, not GTK options
+    auto app = Gtk::Application::create(gtk_argc, argv, "org.gtkmm.dispatch");
+    int rc;
+    {
+        DispatchWindow window(rg);
+        rc = app->run(window);
+    }
+    rt_free(rg);
+    return rc;
 }
@@ -1,368 +1,1319 @@
 
 
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE   /* syscall() for perf_event_open */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
 
-#define LINEBUF 4096
-#define INITIAL_NODES 1024
-#define INITIAL_EDGES 16384
-#define INF 1e18
-
-
-typedef struct { long long key; int val; char used; } LLMapEntry;
-typedef struct { LLMapEntry *table; int cap; int size; } LLMap;
-static unsigned long long hash_u64(unsigned long long x){
-    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
-    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
-    x = x ^ (x >> 31);
-    return x;
-}
-LLMap* llmap_create(int cap){
-    LLMap *m = malloc(sizeof(LLMap));
-    m->cap = 1; while (m->cap < cap) m->cap <<= 1;
-    m->table = calloc(m->cap, sizeof(LLMapEntry)); m->size = 0; return m;
-}
-void llmap_free(LLMap *m){ if(!m) return; free(m->table); free(m); }
-int llmap_find(LLMap *m, long long key){
-    unsigned long long h = hash_u64((unsigned long long)key);
-    int idx = (int)(h & (m->cap - 1));
-    while (m->table[idx].used){
-        if (m->table[idx].key == key) return m->table[idx].val;
-        idx = (idx + 1) & (m->cap - 1);
-    }
-    return -1;
-}
-void llmap_put(LLMap *m, long long key, int val){
-    if (m->size * 2 >= m->cap){
-        int newcap = m->cap * 2;
-        LLMapEntry *old = m->table; int oldcap = m->cap;
-        m->table = calloc(newcap, sizeof(LLMapEntry)); m->cap = newcap; m->size = 0;
-        for (int i=0;i<oldcap;i++) if (old[i].used){
-            unsigned long long h = hash_u64((unsigned long long)old[i].key);
-            int idx = (int)(h & (m->cap - 1));
-            while (m->table[idx].used) idx = (idx + 1) & (m->cap - 1);
-            m->table[idx].used = 1; m->table[idx].key = old[i].key; m->table[idx].val = old[i].val; m->size++;
+#include "routing_engine.h"   /* the --bench-* internals, isochrones, shards and the engine's own search options */
+#include "routing.h"          /* route, nearest and daemon queries */
+
+
+int parse_any_keyword_strict(const char *s, char *out_type){ char low[256]; str_to_lower(s, low);
+    if (strcmp(low, "hospital")==0 || strcmp(low, "any hospital")==0 || strcmp(low, "from hospital")==0) { strcpy(out_type,"hospital"); return 1; }
+    if (strcmp(low, "fire")==0 || strcmp(low, "firestation")==0 || strcmp(low,"fire station")==0 || strcmp(low,"any fire")==0 || strcmp(low,"any fire station")==0 || strcmp(low,"from fire")==0) { strcpy(out_type,"fire"); return 1; }
+    if (strcmp(low, "police")==0 || strcmp(low,"police station")==0 || strcmp(low,"any police")==0 || strcmp(low,"from police")==0) { strcpy(out_type,"police"); return 1; }
+    if (strncmp(low, "any ", 4) == 0){
+        if (strstr(low, "hospital")){ strcpy(out_type,"hospital"); return 1; }
+        if (strstr(low, "fire")){ strcpy(out_type,"fire"); return 1; }
+        if (strstr(low, "police")){ strcpy(out_type,"police"); return 1; }
+    }
+    if (strncmp(low, "from any ", 9) == 0){
+        if (strstr(low, "hospital")){ strcpy(out_type,"hospital"); return 1; }
+        if (strstr(low, "fire")){ strcpy(out_type,"fire"); return 1; }
+        if (strstr(low, "police")){ strcpy(out_type,"police"); return 1; }
+    }
+    return 0;
+}
+
+
+
+static const int crp_default_cells[3] = { 128, 1024, 8192 };
+
+void bench_crp(Graph *g, int threads, int queries){
+    double t0 = now_sec();
+    Crp *c = crp_build(g, 3, crp_default_cells);
+    double t1 = now_sec();
+    crp_customize(c, g, threads);
+    double t2 = now_sec();
+    long long clq = 0; int bnd = 0;
+    for (int l=0;l<c->levels;l++){ clq += c->clq_off[l][c->ncells[l]]; bnd += c->bnd_off[l][c->ncells[l]]; }
+    printf("CRP: %d nodes, cells/level %d/%d/%d, %d boundary entries, %lld clique entries\n", g->V, c->ncells[0], c->ncells[1], c->ncells[2], bnd, clq);
+    printf("partition %.3f s, customization %.3f s (%d threads)\n", t1-t0, t2-t1, threads);
+    SearchWork *w = search_work_create(g->V), *uw = search_work_create(g->V);
+    double *dist = malloc(sizeof(double)*g->V); int *parent = malloc(sizeof(int)*g->V), *path = malloc(sizeof(int)*g->V);
+    unsigned seed = 12345; int bad = 0, npath = 0; double tq = 0, td = 0, tp = 0;
+    for (int round=0; round<2; round++){
+        if (round == 1){
+            /* flood closes a district: triple travel times around a random point and re-customize */
+            int p = rng_next(&seed) % g->V;
+            graph_scale_region(g, g->lat[p], g->lon[p], 1.5, 3.0);
+            double t3 = now_sec(); crp_customize(c, g, threads);
+            printf("re-customization after metric change %.3f s\n", now_sec()-t3);
+        }
+        for (int q=0;q<queries;q++){
+            int s = rng_next(&seed) % g->V, t = rng_next(&seed) % g->V;
+            double a = now_sec(); double dc = crp_query(c, g, s, t, w, NULL, NULL, NULL); double b = now_sec();
+            dijkstra(g, s, dist, parent); double e = now_sec();
+            tq += b-a; td += e-b;
+            if (fabs(dc - dist[t]) > 1e-6 && !(dc >= INF && dist[t] >= INF)) bad++;
+            if (q % 10 == 0 && dc < INF){
+                /* unpacked path must be a real road sequence of the same length */
+                int plen = 0; double sum = 0, f = now_sec(); crp_query(c, g, s, t, w, uw, path, &plen); tp += now_sec() - f; npath++;
+                for (int i=1;i<plen;i++){ double best = INF; for (int e=g->head[path[i-1]]; e!=-1; e=g->edges[e].next) if (g->edges[e].to == path[i] && g->edges[e].weight < best) best = g->edges[e].weight; sum += best; }
+                if (plen < 1 || path[0] != s || path[plen-1] != t || fabs(sum - dc) > 1e-6) bad++;
+            }
         }
-        free(old);
     }
-    unsigned long long h = hash_u64((unsigned long long)key);
-    int idx = (int)(h & (m->cap - 1));
-    while (m->table[idx].used){
-        if (m->table[idx].key == key){ m->table[idx].val = val; return; }
-        idx = (idx + 1) & (m->cap - 1);
+    printf("%d queries: overlay %.1f us/query (%.1f with path), dijkstra %.1f us/query, %d mismatches\n", 2*queries, tq*1e6/(2*queries), npath ? tp*1e6/npath : 0.0, td*1e6/(2*queries), bad);
+    free(dist); free(parent); free(path); search_work_free(w); search_work_free(uw); crp_free(c);
+}
+
+
+
+void bench_snap(Graph *g, int queries){
+    double t0 = now_sec(); GeoIndex *gi = geo_build(g); double t1 = now_sec();
+    double mnla = 90, mxla = -90, mnlo = 180, mxlo = -180;
+    for (int i=0;i<gi->n;i++){ int v = gi->idx[i]; if (g->lat[v]<mnla) mnla=g->lat[v]; if (g->lat[v]>mxla) mxla=g->lat[v]; if (g->lon[v]<mnlo) mnlo=g->lon[v]; if (g->lon[v]>mxlo) mxlo=g->lon[v]; }
+    double *qa = malloc(sizeof(double)*queries), *qo = malloc(sizeof(double)*queries); int *res = malloc(sizeof(int)*queries);
+    unsigned seed = 777;
+    for (int i=0;i<queries;i++){ qa[i] = mnla + (mxla-mnla)*(rng_next(&seed)%100000)/1e5; qo[i] = mnlo + (mxlo-mnlo)*(rng_next(&seed)%100000)/1e5; }
+    double t2 = now_sec();
+    for (int i=0;i<queries;i++) res[i] = geo_nearest(gi, qa[i], qo[i], NULL);
+    double t3 = now_sec();
+    int out[8]; for (int i=0;i<queries;i++) geo_knearest(gi, qa[i], qo[i], 8, out, NULL);
+    double t4 = now_sec();
+    int bad = 0, scans = queries < 2000 ? queries : 2000;
+    for (int i=0;i<scans;i++){
+        double best = INF; int bi = -1;
+        for (int j=0;j<gi->n;j++){ int v = gi->idx[j]; double d = haversine(qa[i], qo[i], g->lat[v], g->lon[v]); if (d < best){ best = d; bi = v; } }
+        if (bi != res[i] && fabs(haversine(qa[i], qo[i], g->lat[res[i]], g->lon[res[i]]) - best) > 1e-9) bad++;
+    }
+    double t5 = now_sec();
+    for (int i=0;i<scans && gi->n >= 8;i++){
+        /* the k-nearest list must match the 8 smallest brute-force distances, in order */
+        double top[8]; int m = 0, kn[8]; double km[8];
+        for (int j=0;j<gi->n;j++){
+            int v = gi->idx[j]; double d = haversine(qa[i], qo[i], g->lat[v], g->lon[v]);
+            if (m < 8) top[m++] = d; else if (d < top[7]) top[7] = d; else continue;
+            for (int a=m-1; a>0 && top[a] < top[a-1]; a--){ double t = top[a]; top[a] = top[a-1]; top[a-1] = t; }
+        }
+        geo_knearest(gi, qa[i], qo[i], 8, kn, km);
+        for (int a=0;a<8;a++) if (fabs(km[a] - top[a]) > 1e-6){ bad++; break; }
+    }
+    printf("spatial index: %d nodes, build %.2f ms\n", gi->n, (t1-t0)*1e3);
+    printf("nearest %.2f us/query, 8-nearest %.2f us/query, brute-force haversine scan %.2f us/query, %d mismatches\n",
+           (t3-t2)*1e6/queries, (t4-t3)*1e6/queries, (t5-t4)*1e6/scans, bad);
+    free(qa); free(qo); free(res); geo_free(gi);
+}
+
+
+
+int run_isochrones(Graph *g, const char *out, const char *minutes, int threads){
+    double thresh[ISO_MAX_THRESH]; int nt = 0; const char *p = minutes;
+    while (*p && nt < ISO_MAX_THRESH){ char *end; double m = strtod(p, &end); if (end == p) break; thresh[nt++] = m * 60.0; p = *end == ',' ? end+1 : end; }
+    for (int i=1;i<nt;i++) for (int j=i; j>0 && thresh[j] < thresh[j-1]; j--){ double t = thresh[j]; thresh[j] = thresh[j-1]; thresh[j-1] = t; }
+    if (nt == 0){ printf("Invalid --minutes list '%s'\n", minutes); return 1; }
+    double t0 = now_sec();
+    Coverage *cv = coverage_compute(g, thresh, nt, threads);
+    double t1 = now_sec();
+    FILE *f = fopen(out, "wb"); if (!f){ perror("open isochrone output"); coverage_free(cv); return 1; }
+    size_t len = strlen(out);
+    if (len > 4 && strcmp(out + len - 4, ".bin") == 0) coverage_write_bin(cv, g, f); else coverage_write_csv(cv, g, f);
+    fclose(f);
+    printf("Isochrones for %d stations over %d nodes in %.3f s (%d threads), written to %s\n", cv->nst, g->V, t1-t0, threads, out);
+    for (int t=0;t<nt;t++){
+        int gaps[KIND_COUNT] = {0};
+        for (int v=0; v<g->V; v++) for (int k=0;k<KIND_COUNT;k++) if (!coverage_count(cv, t, v, k)) gaps[k]++;
+        printf("  %4.0f min: nodes without hospital %d, police %d, fire %d\n", thresh[t]/60.0, gaps[0], gaps[1], gaps[2]);
+    }
+    coverage_free(cv); return 0;
+}
+
+
+
+typedef struct { Graph *g; RouteCache *rc; const int *qs, *qt; int from, to; double checksum; } CacheBenchJob;
+static void* cache_bench_worker(void *arg){
+    CacheBenchJob *job = arg; SearchWork *w = search_work_create(job->g->V); int *path = malloc(sizeof(int)*job->g->V), len;
+    for (int i=job->from;i<job->to;i++) job->checksum += route_query(job->g, job->rc, w, job->qs[i], job->qt[i], path, &len);
+    free(path); search_work_free(w); return NULL;
+}
+static double cache_bench_run(Graph *g, RouteCache *rc, const int *qs, const int *qt, int from, int to, int threads, double *checksum){
+    CacheBenchJob *jobs = calloc(threads, sizeof(CacheBenchJob)); pthread_t *tid = malloc(sizeof(pthread_t)*threads);
+    double t0 = now_sec();
+    for (int i=0;i<threads;i++){ jobs[i] = (CacheBenchJob){ g, rc, qs, qt, from + (to-from)*i/threads, from + (to-from)*(i+1)/threads, 0 }; pthread_create(&tid[i], NULL, cache_bench_worker, &jobs[i]); }
+    for (int i=0;i<threads;i++){ pthread_join(tid[i], NULL); *checksum += jobs[i].checksum; }
+    double el = now_sec() - t0; free(jobs); free(tid); return el;
+}
+/* dispatch-like workload: most queries go from a station to one of a few hotspots */
+void bench_cache(Graph *g, int threads, int queries, size_t cap_bytes){
+    int nst = 0, *st = malloc(sizeof(int)*(g->V+1)), hot[20];
+    for (int i=0;i<g->V;i++) if (station_kind(g, i) >= 0) st[nst++] = i;
+    unsigned seed = 4242;
+    if (nst == 0) for (; nst<10 && nst<g->V; nst++) st[nst] = rng_next(&seed) % g->V;
+    for (int i=0;i<20;i++) hot[i] = rng_next(&seed) % g->V;
+    int *qs = malloc(sizeof(int)*queries), *qt = malloc(sizeof(int)*queries);
+    for (int i=0;i<queries;i++){
+        if (rng_next(&seed) % 10){ qs[i] = st[rng_next(&seed) % (nst < 30 ? nst : 30)]; qt[i] = hot[rng_next(&seed) % 20]; }
+        else { qs[i] = rng_next(&seed) % g->V; qt[i] = rng_next(&seed) % g->V; }
+    }
+    double c0 = 0, c1 = 0;
+    RouteCache *rc = route_cache_create(cap_bytes);
+    double base = cache_bench_run(g, NULL, qs, qt, 0, queries/2, threads, &c0);
+    double a = cache_bench_run(g, rc, qs, qt, 0, queries/2, threads, &c1);
+    graph_scale_region(g, g->lat[hot[0]], g->lon[hot[0]], 1.0, 2.0); /* congestion snapshot: every cached route is now stale */
+    base += cache_bench_run(g, NULL, qs, qt, queries/2, queries, threads, &c0);
+    double b = cache_bench_run(g, rc, qs, qt, queries/2, queries, threads, &c1);
+    printf("%d queries, %d threads: uncached %.1f us/query, cached %.1f us/query (metric changed halfway), results %s\n",
+           queries, threads, base*1e6/queries, (a+b)*1e6/queries, fabs(c0-c1) < 1e-6 ? "identical" : "DIFFER");
+    route_cache_print_stats(rc, stdout);
+    route_cache_free(rc); free(qs); free(qt); free(st);
+}
+
+
+
+/* alternatives must start with the exact shortest route and respect both bounds */
+void bench_alt(Graph *g, int queries, int k){
+    SearchWork *fw = search_work_create(g->V), *bw = search_work_create(g->V);
+    AltRoute *alt = malloc(sizeof(AltRoute)*k);
+    double *dist = malloc(sizeof(double)*g->V); int *parent = malloc(sizeof(int)*g->V);
+    unsigned seed = 31337; int bad = 0, routes = 0, solved = 0; double ta = 0, td = 0;
+    graph_build_reverse(g);
+    for (int q=0;q<queries;q++){
+        int s = rng_next(&seed) % g->V, t = rng_next(&seed) % g->V;
+        double a = now_sec(); int n = alt_routes_query(g, fw, bw, s, t, k, 1.3, 0.5, alt); double b = now_sec();
+        dijkstra(g, s, dist, parent); double e = now_sec();
+        ta += b-a; td += e-b;
+        if ((n > 0) != (dist[t] < INF)){ bad++; continue; }
+        if (n == 0) continue;
+        solved++; routes += n;
+        if (fabs(alt[0].time - dist[t]) > 1e-6) bad++;
+        for (int r=0;r<n;r++){
+            double sum = 0;
+            for (int i=1;i<alt[r].len;i++){ double best = INF; for (int x=g->head[alt[r].path[i-1]]; x!=-1; x=g->edges[x].next) if (g->edges[x].to == alt[r].path[i] && g->edges[x].weight < best) best = g->edges[x].weight; sum += best; }
+            if (alt[r].path[0] != s || alt[r].path[alt[r].len-1] != t || fabs(sum - alt[r].time) > 1e-6 || alt[r].time > 1.3*dist[t] + 1e-6) bad++;
+            free(alt[r].path);
+        }
+    }
+    printf("%d queries, k=%d: %.1f routes per solved query, alternatives %.1f us/query, one dijkstra %.1f us/query, %d violations\n",
+           queries, k, solved ? (double)routes/solved : 0.0, ta*1e6/queries, td*1e6/queries, bad);
+    free(alt); free(dist); free(parent); search_work_free(fw); search_work_free(bw);
+}
+
+/* m x n matrix against m full dijkstras from the sources; entries must match exactly */
+void bench_matrix(Graph *g, int m, int n, int threads){
+    int *src = malloc(sizeof(int)*m), *dst = malloc(sizeof(int)*n);
+    double *mat = malloc(sizeof(double)*m*(size_t)n), *dist = malloc(sizeof(double)*g->V); int *parent = malloc(sizeof(int)*g->V);
+    unsigned seed = 4242; int bad = 0;
+    for (int i=0;i<m;i++) src[i] = rng_next(&seed) % g->V;
+    for (int j=0;j<n;j++) dst[j] = rng_next(&seed) % g->V;
+    graph_build_reverse(g);
+    double a = now_sec(); matrix_query(g, src, m, dst, n, mat, threads); double b = now_sec();
+    for (int i=0;i<m;i++){
+        dijkstra(g, src[i], dist, parent);
+        for (int j=0;j<n;j++) if (!(fabs(mat[(size_t)i*n + j] - dist[dst[j]]) < 1e-6 || (mat[(size_t)i*n + j] >= INF && dist[dst[j]] >= INF))) bad++;
     }
-    m->table[idx].used = 1; m->table[idx].key = key; m->table[idx].val = val; m->size++;
+    double e = now_sec();
+    printf("%dx%d matrix, %d threads: %.1f ms, %d dijkstras %.1f ms (%.1fx), %d mismatches\n", m, n, threads, (b-a)*1e3, m, (e-b)*1e3, (e-b)/(b-a), bad);
+    free(src); free(dst); free(mat); free(dist); free(parent);
 }
 
+/* lower-bound kernel (scalar vs dispatched) over every node, then best-of-m unit selection with
+   and without straight-line pruning; both selections must agree */
+void bench_bound(Graph *g, int queries, int m){
+    GeoBound *gb = geobound_build(g);
+    double *out0 = malloc(sizeof(double)*(g->V+1)), *out1 = malloc(sizeof(double)*(g->V+1)), t[3] = { gb->x[0], gb->y[0], gb->z[0] }, diff = 0;
+    int reps = 1 + (int)(20000000LL / (g->V+1));
+    double a = now_sec(); for (int r=0;r<reps;r++){ t[0] = gb->x[r % g->V]; geo_lower_bound_km_scalar(gb->x, gb->y, gb->z, g->V, t, out0); }
+    double b = now_sec(); for (int r=0;r<reps;r++){ t[0] = gb->x[r % g->V]; geo_lower_bound_km(gb->x, gb->y, gb->z, g->V, t, out1); }
+    double e = now_sec();
+    for (int i=0;i<g->V;i++) if (fabs(out0[i]-out1[i]) > diff) diff = fabs(out0[i]-out1[i]);
+    printf("bound kernel: scalar %.2f ns/point, dispatched %.2f ns/point (%.1fx), max diff %.2g km, %.4f km/s fastest road\n",
+           (b-a)*1e9/((double)reps*g->V), (e-b)*1e9/((double)reps*g->V), (b-a)/(e-b), diff, gb->kmps);
 
-typedef struct { int to; double weight; int next; } Edge;
+    SearchWork *w = search_work_create(g->V); int *path = malloc(sizeof(int)*(g->V+1)), *src = malloc(sizeof(int)*m);
+    unsigned seed = 777; int bad = 0; long long r0 = 0, r1 = 0; double tp = 0, tf = 0;
+    for (int q=0;q<queries;q++){
+        int dst = rng_next(&seed) % g->V, n0, n1; double d0, d1;
+        for (int i=0;i<m;i++) src[i] = rng_next(&seed) % g->V;
+        a = now_sec(); int i0 = best_source_query(g, gb, NULL, w, path, src, m, dst, &d0, &n0);
+        b = now_sec(); int i1 = best_source_query(g, NULL, NULL, w, path, src, m, dst, &d1, &n1);
+        e = now_sec();
+        tp += b-a; tf += e-b; r0 += n0; r1 += n1;
+        if (i0 != i1 || d0 != d1) bad++;
+    }
+    printf("%d queries, %d candidates: pruned %.1f routed %.2f ms/query, unpruned %.1f routed %.2f ms/query, %d mismatches\n",
+           queries, m, (double)r0/queries, tp*1e3/queries, (double)r1/queries, tf*1e3/queries, bad);
+    free(out0); free(out1); free(path); free(src); search_work_free(w); geobound_free(gb);
+}
+/* one-to-all from the same sources with MinHeap and with Dial's buckets; labels must agree */
+void bench_dial(Graph *g, int queries){
+    double a = now_sec(); IntGraph *ig = intgraph_build(g); double b = now_sec();
+    if (!ig){ printf("travel times are not whole seconds: no integer variant\n"); return; }
+    double *dist = malloc(sizeof(double)*g->V); unsigned *ud = malloc(sizeof(unsigned)*g->V); int *parent = malloc(sizeof(int)*g->V);
+    unsigned seed = 515; int bad = 0; double th = 0, td = 0;
+    for (int q=0;q<queries;q++){
+        int s = rng_next(&seed) % g->V;
+        double c = now_sec(); dijkstra(g, s, dist, parent); double d = now_sec(); dial_dijkstra(ig, s, ud, parent); double e = now_sec();
+        th += d-c; td += e-d;
+        for (int i=0;i<g->V;i++) if (dist[i] >= INF ? ud[i] != UINF : ud[i] != (unsigned)dist[i]) { bad++; break; }
+    }
+    printf("%d one-to-all searches, max weight %u s: MinHeap %.2f ms/search, dial %.2f ms/search (%.1fx), integer copy %.1f ms, %d mismatches\n",
+           queries, ig->maxw, th*1e3/queries, td*1e3/queries, th/td, (b-a)*1e3, bad);
+    free(dist); free(ud); free(parent); intgraph_free(ig);
+}
+
+/* metric kernels: the time kernel one-to-all against dijkstra(), then each lexicographic order
+   in one pass against the two-pass reference on the same pairs; totals must match exactly */
+void bench_metrics(Graph *g, int queries){
+    double a = now_sec(); MetricGraph *mg = metricgraph_build(g); double b = now_sec();
+    MetricWork *w = metric_work_create(g->V);
+    double *dist = malloc(sizeof(double)*g->V); int *parent = malloc(sizeof(int)*g->V);
+    unsigned seed = 4049; double th = 0, tm = 0; int bad = 0;
+    for (int q=0;q<queries;q++){
+        int s = rng_next(&seed) % g->V, t = rng_next(&seed) % g->V; double mt;
+        double c = now_sec(); dijkstra(g, s, dist, parent); double d = now_sec(); metric_route(mg, w, ORDER_TIME, s, -1, NULL, NULL, NULL, NULL); double e = now_sec();
+        th += d-c; tm += e-d;
+        metric_route(mg, w, ORDER_TIME, s, t, &mt, NULL, NULL, NULL);
+        if (dist[t] >= INF ? mt < INF : fabs(mt - dist[t]) > 1e-6) bad++;
+    }
+    printf("%d one-to-all searches: MinHeap %.2f ms, time kernel %.2f ms (%.1fx), packed copy %.1f ms / %.1f bytes per road, %d mismatches\n",
+           queries, th*1e3/queries, tm*1e3/queries, th/tm, (b-a)*1e3, g->edge_count ? (double)metricgraph_bytes(mg) / g->edge_count : 0.0, bad);
+    for (int order = ORDER_TIME_LENGTH; order <= ORDER_LENGTH_TIME; order++){
+        double t1 = 0, t2 = 0; int diff = 0, better = 0; seed = 4049 + order;
+        for (int q=0;q<queries*10;q++){
+            int s = rng_next(&seed) % g->V, t = rng_next(&seed) % g->V; double x1, y1, x2, y2, px, py;
+            double c = now_sec(); metric_route(mg, w, order, s, t, &x1, &y1, NULL, NULL); double d = now_sec();
+            metric_route_two_pass(mg, w, order, s, t, &x2, &y2, NULL, NULL); double e = now_sec();
+            t1 += d-c; t2 += e-d;
+            if (x1 != x2 || y1 != y2) diff++;
+            metric_route(mg, w, order == ORDER_TIME_LENGTH ? ORDER_TIME : ORDER_LENGTH, s, t, &px, &py, NULL, NULL);
+            if (order == ORDER_TIME_LENGTH ? y1 < py : x1 < px) better++;
+        }
+        printf("%-11s %d routes: one pass %.3f ms, two passes %.3f ms (%.1fx), %d mismatches, tie-break improved %d\n",
+               route_order_name(order), queries*10, t1*1e3/(queries*10), t2*1e3/(queries*10), t2/t1, diff, better);
+    }
+    free(dist); free(parent); metric_work_free(w); metricgraph_free(mg);
+}
+
+/* one-to-all against dijkstra() with 1, 2, 4 .. threads (and the requested count), auto delta and
+   a few multiples of it; every distance must match exactly */
+void bench_delta(Graph *g, int queries, int max_threads){
+    double *ref = malloc(sizeof(double)*g->V), *dist = malloc(sizeof(double)*g->V); int *parent = malloc(sizeof(int)*g->V);
+    int *src = malloc(sizeof(int)*queries); unsigned seed = 606; double td = 0;
+    for (int q=0;q<queries;q++) src[q] = rng_next(&seed) % g->V;
+    for (int q=0;q<queries;q++){ double a = now_sec(); dijkstra(g, src[q], ref, parent); td += now_sec() - a; }
+    printf("dijkstra: %.2f ms/search\n", td*1e3/queries);
+    double base = ds_auto_delta(g), mult[3] = { 0.5, 1, 4 };
+    for (int k=0;k<3;k++){
+        double one = 0;
+        for (int t=1; ; t = t*2 > max_threads && t < max_threads ? max_threads : t*2){
+            DeltaStep *ds = ds_create(g, base * mult[k], t); double tt = 0; int bad = 0;
+            for (int q=0;q<queries;q++){
+                double a = now_sec(); ds_run(ds, src[q], dist); tt += now_sec() - a;
+                dijkstra(g, src[q], ref, parent);
+                for (int i=0;i<g->V;i++) if (dist[i] != ref[i]){ bad++; break; }
+            }
+            if (t == 1) one = tt;
+            printf("delta %.2f%s, %d threads: %.2f ms/search, speedup %.2fx over 1 thread, %.2fx over dijkstra, %d mismatches\n",
+                   ds_delta(ds), mult[k] == 1 ? " (auto)" : "", t, tt*1e3/queries, one/tt, td/tt, bad);
+            ds_free(ds);
+            if (t >= max_threads) break;
+        }
+    }
+    free(ref); free(dist); free(parent); free(src);
+}
+
+
+void bench_hl(Graph *g, int queries, int threads){
+    double a = now_sec(); HubLabels *hl = hl_build(g, threads); double tb = now_sec() - a;
+    long long entries; size_t bytes; hl_stats(hl, &entries, &bytes);
+    printf("hub labels: built in %.2f s on %d threads, %.1f labels/node, %.1f bytes/node (%.2f MB)\n",
+           tb, threads, (double)entries / g->V, (double)bytes / g->V, bytes / 1048576.0);
+    const char *tmp = "/tmp/bench_hub_labels.bin";
+    a = now_sec(); hl_save(hl, tmp); HubLabels *mm = hl_open(tmp, g); double to = now_sec() - a;
+    printf("save + map: %.1f ms\n", to*1e3);
+    int *s = malloc(sizeof(int)*queries), *t = malloc(sizeof(int)*queries); unsigned seed = 4545; volatile double sink = 0;
+    for (int q=0;q<queries;q++){ s[q] = rng_next(&seed) % g->V; t[q] = rng_next(&seed) % g->V; }
+    a = now_sec(); for (int q=0;q<queries;q++) sink += hl_distance(mm, s[q], t[q]); double tq = now_sec() - a;
+    printf("distance query: %.2f us (mapped file)\n", tq*1e6/queries);
+    /* against full searches; weights are whole seconds here, so equal means equal */
+    double *ref = malloc(sizeof(double)*g->V); int *parent = malloc(sizeof(int)*g->V), *path = malloc(sizeof(int)*(g->V+1));
+    int bad = 0, badpath = 0, checks = 20; double td = 0, tp = 0; int paths = 0;
+    for (int q=0;q<checks;q++){
+        a = now_sec(); dijkstra(g, s[q], ref, parent); td += now_sec() - a;
+        for (int v=0;v<g->V;v++){ double d = hl_distance(mm, s[q], v); if (fabs((d >= INF ? INF : d) - ref[v]) > 1e-6 && !(d >= INF && ref[v] >= INF)) bad++; }
+        a = now_sec(); int len = hl_path(mm, g, s[q], t[q], path, g->V + 1); tp += now_sec() - a; paths++;
+        double sum = 0;
+        for (int i=1;i<len;i++){ double best = INF; for (int e=g->head[path[i-1]]; e!=-1; e=g->edges[e].next) if (g->edges[e].to == path[i] && g->edges[e].weight < best) best = g->edges[e].weight; sum += best; }
+        if (len > 0 ? fabs(sum - ref[t[q]]) > 1e-6 : ref[t[q]] < INF) badpath++;
+    }
+    printf("dijkstra one-to-all: %.2f ms; path retrieval: %.1f us; %d distance and %d path mismatches over %d sources\n",
+           td*1e3/checks, tp*1e6/paths, bad, badpath, checks);
+    (void)sink; unlink(tmp);
+    hl_free(mm); hl_free(hl); free(s); free(t); free(ref); free(parent); free(path);
+}
+
+
+/* ALT against plain point-to-point dijkstra (no landmarks: zero potential, same search) */
+void bench_landmarks(Graph *g, int queries, int threads){
+    int *s = malloc(sizeof(int)*queries), *t = malloc(sizeof(int)*queries); unsigned seed = 8080;
+    for (int q=0;q<queries;q++){ s[q] = rng_next(&seed) % g->V; t[q] = rng_next(&seed) % g->V; }
+    double *ref = malloc(sizeof(double)*queries);
+    AltWork *w = alt_work_create(g->V);
+    static const int counts[] = { 0, 4, 8, 16 }; static const char *sel[] = { "avoid", "farthest" };
+    double base_ms = 0, base_settled = 0;
+    for (int c=0;c<4;c++) for (int m=0;m<(counts[c] ? 2 : 1);m++) for (int bits=16; bits<=32; bits+=16){
+        if (!counts[c] && bits == 16) continue;
+        double a0 = now_sec(); Alt *alt = alt_build(g, counts[c], alt_select_mode(sel[m]), bits, threads); double tb = now_sec() - a0;
+        double tq = 0; long long settled = 0; int bad = 0;
+        for (int q=0;q<queries;q++){
+            double a = now_sec(); double d = alt_query(alt, g, w, s[q], t[q], NULL, NULL); tq += now_sec() - a;
+            settled += alt_work_settled(w);
+            if (!counts[c]) ref[q] = d; else if (d != ref[q]) bad++;
+        }
+        if (!counts[c]){ base_ms = tq*1e3/queries; base_settled = (double)settled/queries; printf("dijkstra (no landmarks): %.3f ms/query, %.0f settled\n", base_ms, base_settled); }
+        else printf("%2d landmarks %-8s %d-bit: build %.2f s, %.1f bytes/node, %.3f ms/query (%.1fx), %.0f settled (%.1fx fewer), %d mismatches\n",
+                    alt_landmarks(alt), sel[m], bits, tb, (double)alt_bytes(alt)/g->V, tq*1e3/queries, base_ms/(tq*1e3/queries), (double)settled/queries, base_settled/((double)settled/queries), bad);
+        alt_free(alt);
+    }
+    alt_work_free(w); free(s); free(t); free(ref);
+}
+
+
+/* user-space cache misses of this thread, counted while enabled; -1 when perf events are unavailable */
+static int perf_open_misses(void){
+    struct perf_event_attr pe; memset(&pe, 0, sizeof(pe));
+    pe.type = PERF_TYPE_HARDWARE; pe.size = sizeof(pe); pe.config = PERF_COUNT_HW_CACHE_MISSES;
+    pe.disabled = 1; pe.exclude_kernel = 1; pe.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
+}
+/* scrambles the numbering (arbitrary csv order), then times the same point-to-point queries,
+   named by external id, under each ordering; distances must not change */
+void bench_reorder(Graph *g, int queries){
+    int n = g->V, *order = malloc(sizeof(int)*n), *path = malloc(sizeof(int)*(n+1)), len;
+    long long *qs = malloc(sizeof(long long)*queries), *qt = malloc(sizeof(long long)*queries);
+    unsigned seed = 99; double base = -1;
+    for (int i=0;i<n;i++) order[i] = i;
+    for (int i=n-1;i>0;i--){ int j = rng_next(&seed) % (i+1), x = order[i]; order[i] = order[j]; order[j] = x; }
+    graph_permute(g, order);
+    for (int q=0;q<queries;q++){ qs[q] = g->ext_id[rng_next(&seed) % n]; qt[q] = g->ext_id[rng_next(&seed) % n]; }
+    int modes[4] = { REORDER_NONE, REORDER_BFS, REORDER_RCM, REORDER_HILBERT }, fd = perf_open_misses();
+    for (int k=0;k<4;k++){
+        double a = now_sec(); graph_reorder(g, modes[k]); double b = now_sec();
+        SearchWork *w = search_work_create(n); double sum = 0; long long misses = -1;
+        if (fd >= 0){ ioctl(fd, PERF_EVENT_IOC_RESET, 0); ioctl(fd, PERF_EVENT_IOC_ENABLE, 0); }
+        double c = now_sec();
+        for (int q=0;q<queries;q++){ double d = route_query(g, NULL, w, llmap_find(g->idmap, qs[q]), llmap_find(g->idmap, qt[q]), path, &len); if (d < INF) sum += d; }
+        double e = now_sec();
+        if (fd >= 0){ ioctl(fd, PERF_EVENT_IOC_DISABLE, 0); if (read(fd, &misses, sizeof(misses)) != sizeof(misses)) misses = -1; }
+        if (base < 0) base = sum;
+        printf("%-8s reorder %7.1f ms, %d queries %.2f ms/query", k ? reorder_name(modes[k]) : "csv", (b-a)*1e3, queries, (e-c)*1e3/queries);
+        if (misses >= 0) printf(", %.0f cache misses/query", (double)misses/queries); else printf(", cache misses n/a");
+        printf(", distances %s\n", fabs(sum - base) < 1e-6 * (1 + base) ? "identical" : "DIFFER");
+        search_work_free(w);
+    }
+    if (fd >= 0) close(fd);
+    free(order); free(path); free(qs); free(qt);
+}
+
+
+/* ---- routing daemon: line protocol over a unix domain socket ----
+   requests, one per line; a location is an external id, "lat,lon" or a name with '_' for spaces:
+     ROUTE <from> <to>            -> OK <seconds> <hops> <ext_id>...
+     NEAREST <from> <type>        -> OK <ext_id> <seconds>          (type: hospital, police, fire)
+     BATCH <from> <to> [<to>...]  -> OK <seconds>...                (one search, -1 when unreachable, at most 256 targets)
+     STATS | PING | QUIT
+   queries go through routing.h (rt_resolve, rt_route, rt_nearest_of_type, rt_route_many), so
+   they share its route cache and each runs on the graph version current when it started.
+   errors come back as "ERR <reason>". answers on a connection keep request order, so a client
+   may pipeline any number of requests. a poll() loop hands readable connections to the worker
+   pool; a worker drains every complete line it has, then gives the connection back. */
+#define SERVE_MAX_CONN 1024
+#define SERVE_MAX_LINE 65536
+#define SERVE_MAX_BATCH 256
+
+typedef struct { int fd; int busy; char *in; int in_len; } ServeConn;
 typedef struct {
-    int V;
-    int edge_count;
-    int edge_cap;
-    Edge *edges;
-    int *head;
-    long long *ext_id;
-    double *lat, *lon;
-    char **name, **type;
-    LLMap *idmap;
-} Graph;
-
-static int global_node_cap = INITIAL_NODES;
-Graph* graph_create(int node_cap){
-    Graph *g = malloc(sizeof(Graph));
-    g->V = 0; g->edge_count = 0; g->edge_cap = INITIAL_EDGES;
-    g->edges = malloc(sizeof(Edge) * g->edge_cap);
-    g->head = malloc(sizeof(int) * node_cap);
-    g->ext_id = malloc(sizeof(long long) * node_cap);
-    g->lat = malloc(sizeof(double) * node_cap); g->lon = malloc(sizeof(double) * node_cap);
-    g->name = malloc(sizeof(char*) * node_cap); g->type = malloc(sizeof(char*) * node_cap);
-    for (int i=0;i<node_cap;i++){ g->head[i] = -1; g->ext_id[i]=0; g->lat[i]=g->lon[i]=0.0; g->name[i]=NULL; g->type[i]=NULL; }
-    g->idmap = llmap_create(node_cap*2 + 16);
-    global_node_cap = node_cap; return g;
-}
-void graph_ensure_nodecap(Graph *g, int need){
-    if (need <= global_node_cap) return;
-    int cap = global_node_cap; while (need > cap) cap *= 2;
-    g->head = realloc(g->head, sizeof(int) * cap);
-    g->ext_id = realloc(g->ext_id, sizeof(long long) * cap);
-    g->lat = realloc(g->lat, sizeof(double) * cap); g->lon = realloc(g->lon, sizeof(double) * cap);
-    g->name = realloc(g->name, sizeof(char*) * cap); g->type = realloc(g->type, sizeof(char*) * cap);
-    for (int i=global_node_cap;i<cap;i++){ g->head[i] = -1; g->ext_id[i]=0; g->lat[i]=g->lon[i]=0.0; g->name[i]=NULL; g->type[i]=NULL; }
-    global_node_cap = cap;
-}
-int graph_add_node(Graph *g, long long ext, double lat, double lon, const char *name, const char *type){
-    int idx = g->V++; graph_ensure_nodecap(g, g->V);
-    g->ext_id[idx] = ext; g->lat[idx] = lat; g->lon[idx] = lon;
-    g->name[idx] = (name && strlen(name)) ? strdup(name) : NULL;
-    g->type[idx] = (type && strlen(type)) ? strdup(type) : NULL;
-    g->head[idx] = -1; llmap_put(g->idmap, ext, idx); return idx;
-}
-void graph_add_edge(Graph *g, int u, int v, double w){
-    if (g->edge_count >= g->edge_cap){ g->edge_cap *= 2; g->edges = realloc(g->edges, sizeof(Edge) * g->edge_cap); }
-    int ei = g->edge_count++; g->edges[ei].to = v; g->edges[ei].weight = w; g->edges[ei].next = g->head[u]; g->head[u] = ei;
-}
-int graph_get_or_create(Graph *g, long long ext){
-    int idx = llmap_find(g->idmap, ext); if (idx != -1) return idx;
-    return graph_add_node(g, ext, 0.0, 0.0, NULL, NULL);
-}
-void graph_free(Graph *g){
-    if (!g) return;
-    for (int i=0;i<g->V;i++){ if (g->name[i]) free(g->name[i]); if (g->type[i]) free(g->type[i]); }
-    free(g->head); free(g->ext_id); free(g->lat); free(g->lon); free(g->name); free(g->type);
-    free(g->edges); llmap_free(g->idmap); free(g);
-}
-
-
-static void trim(char *s){ char *p=s; while(*p && (*p==' '||*p=='\t')) p++; if (p!=s) memmove(s,p,strlen(p)+1); int len=strlen(s); while(len>0 && (s[len-1]=='\r'||s[len-1]=='\n'||s[len-1]==' '||s[len-1]=='\t')) s[--len]=0; }
-static void str_to_lower(const char *src, char *dst){ while (*src){ *dst = (char)tolower((unsigned char)*src); src++; dst++; } *dst = 0; }
-
-
-int node_matches_type_or_name(Graph *g, int idx, const char *requested){
-    if (!requested) return 0;
-    char rl[256]; str_to_lower(requested, rl);
-    if (g->type[idx]){
-        char t[256]; str_to_lower(g->type[idx], t);
-        if (strstr(t, rl)) return 1;
-    }
-    if (g->name[idx]){
-        char n[1024]; str_to_lower(g->name[idx], n);
-        if (strstr(n, rl)) return 1;
+    RtGraph *rg; int edges;
+    ServeConn conn[SERVE_MAX_CONN];
+    int queue[SERVE_MAX_CONN], qhead, qlen;
+    pthread_mutex_t mu; pthread_cond_t cv;
+    int wake[2];
+    atomic_int stop;
+    atomic_ullong served;
+} Server;
+static atomic_int serve_signal_stop;
+static void serve_on_signal(int sig){ (void)sig; atomic_store(&serve_signal_stop, 1); }
+
+static int serve_resolve(Server *sv, char *tok){
+    for (char *p = tok; *p; p++) if (*p == '_') *p = ' ';
+    return rt_resolve(sv->rg, tok, NULL);
+}
+
+/* appends formatted text to a growable output buffer */
+typedef struct { char *buf; int len, cap; } OutBuf;
+static void out_printf(OutBuf *o, const char *fmt, ...){
+    va_list ap;
+    while (1){
+        va_start(ap, fmt); int n = vsnprintf(o->buf + o->len, o->cap - o->len, fmt, ap); va_end(ap);
+        if (n < o->cap - o->len){ o->len += n; return; }
+        o->cap = o->cap*2 + n; o->buf = realloc(o->buf, o->cap);
+    }
+}
+
+/* returns 0 when the client asked to quit */
+static int serve_line(Server *sv, char *line, int *path, OutBuf *o){
+    RtGraph *rg = sv->rg; char *save = NULL;
+    char *cmd = strtok_r(line, " \t", &save);
+    if (!cmd){ out_printf(o, "ERR empty request\n"); return 1; }
+    for (char *p = cmd; *p; p++) *p = (char)toupper((unsigned char)*p);
+    if (strcmp(cmd, "PING") == 0){ out_printf(o, "OK PONG\n"); return 1; }
+    if (strcmp(cmd, "QUIT") == 0){ out_printf(o, "OK BYE\n"); return 0; }
+    if (strcmp(cmd, "STATS") == 0){
+        unsigned long long h, m; rt_cache_stats(rg, &h, &m);
+        out_printf(o, "OK nodes=%d edges=%d version=%llu served=%llu cache_hits=%llu cache_misses=%llu\n", rt_node_count(rg), sv->edges, rt_version(rg), (unsigned long long)atomic_load(&sv->served), h, m);
+        return 1;
     }
+    if (strcmp(cmd, "ROUTE") && strcmp(cmd, "NEAREST") && strcmp(cmd, "BATCH")){ out_printf(o, "ERR unknown command %s\n", cmd); return 1; }
+    char *a = strtok_r(NULL, " \t", &save);
+    int src = a ? serve_resolve(sv, a) : -1;
+    if (src < 0){ out_printf(o, "ERR unknown source\n"); return 1; }
+    if (strcmp(cmd, "ROUTE") == 0){
+        char *b = strtok_r(NULL, " \t", &save); int dst = b ? serve_resolve(sv, b) : -1, len = 0;
+        if (dst < 0){ out_printf(o, "ERR unknown destination\n"); return 1; }
+        double d = rt_route(rg, src, dst, path, &len);
+        if (d >= RT_UNREACHABLE){ out_printf(o, "ERR no path\n"); return 1; }
+        out_printf(o, "OK %.1f %d", d, len);
+        for (int i=0;i<len;i++) out_printf(o, " %lld", rt_ext_id(rg, path[i]));
+        out_printf(o, "\n");
+    } else if (strcmp(cmd, "NEAREST") == 0){
+        char *type = strtok_r(NULL, " \t", &save);
+        if (!type){ out_printf(o, "ERR missing type\n"); return 1; }
+        double d; int found = rt_nearest_of_type(rg, src, type, &d, NULL, NULL, NULL, NULL);
+        if (found < 0) out_printf(o, "ERR no reachable %s\n", type);
+        else out_printf(o, "OK %lld %.1f\n", rt_ext_id(rg, found), d);
+    } else if (strcmp(cmd, "BATCH") == 0){
+        int tg[SERVE_MAX_BATCH], known[SERVE_MAX_BATCH], nt = 0, nk = 0; double d[SERVE_MAX_BATCH]; char *b;
+        while ((b = strtok_r(NULL, " \t", &save))){
+            if (nt == SERVE_MAX_BATCH){ out_printf(o, "ERR too many targets (at most %d)\n", SERVE_MAX_BATCH); return 1; }
+            if ((tg[nt++] = serve_resolve(sv, b)) >= 0) known[nk++] = tg[nt-1];
+        }
+        rt_route_many(rg, src, known, nk, d);
+        out_printf(o, "OK");
+        for (int i=0, k=0;i<nt;i++){ double t = tg[i] >= 0 ? d[k++] : RT_UNREACHABLE; out_printf(o, t >= RT_UNREACHABLE ? " -1" : " %.1f", t); }
+        out_printf(o, "\n");
+    }
+    return 1;
+}
+
+static int write_all(int fd, const char *buf, int len){
+    while (len > 0){ ssize_t n = write(fd, buf, len); if (n < 0){ if (errno == EINTR) continue; return -1; } buf += n; len -= n; }
     return 0;
 }
 
-int name_match_ci(const char *node_name, const char *query){ if (!node_name || !query) return 0; char a[1024], b[1024]; str_to_lower(node_name,a); str_to_lower(query,b); return strstr(a,b) != NULL; }
-int type_is_allowed(const char *type){ if (!type) return 0; char t[256]; str_to_lower(type,t); if (strstr(t,"hospital")!=NULL) return 1; if (strstr(t,"fire")!=NULL) return 1; if (strstr(t,"police")!=NULL) return 1; return 0; }
-int type_matches_requested(const char *type, const char *requested){ if (!type || !requested) return 0; char t[256], r[256]; str_to_lower(type,t); str_to_lower(requested,r); return strstr(t,r) != NULL; }
-
-
-int load_nodes(Graph *g, const char *fname){
-    FILE *f = fopen(fname,"r"); if (!f){ perror("open nodes.csv"); return -1; }
-    char line[LINEBUF];
-    if (!fgets(line, LINEBUF, f)){ fclose(f); return 0; } // header
-    while (fgets(line, LINEBUF, f)){
-        trim(line); if (strlen(line)==0) continue;
-        char *tok = strtok(line, ","); if (!tok) continue;
-        long long ext = atoll(tok); if (ext==0 && tok[0] != '0') continue;
-        tok = strtok(NULL, ","); double lat = tok ? atof(tok) : 0.0;
-        tok = strtok(NULL, ","); double lon = tok ? atof(tok) : 0.0;
-        tok = strtok(NULL, ","); char namebuf[1024] = ""; if (tok) { strncpy(namebuf, tok, 1023); namebuf[1023]=0; trim(namebuf); }
-        tok = strtok(NULL, ","); char typebuf[256] = ""; if (tok) { strncpy(typebuf, tok, 255); typebuf[255]=0; trim(typebuf); }
-        int idx = llmap_find(g->idmap, ext);
-        if (idx == -1) graph_add_node(g, ext, lat, lon, namebuf, typebuf);
-        else {
-            g->lat[idx]=lat; g->lon[idx]=lon;
-            if (g->name[idx]) free(g->name[idx]); if (strlen(namebuf)) g->name[idx]=strdup(namebuf); else g->name[idx]=NULL;
-            if (g->type[idx]) free(g->type[idx]); if (strlen(typebuf)) g->type[idx]=strdup(typebuf); else g->type[idx]=NULL;
+static void* serve_worker(void *arg){
+    Server *sv = arg;
+    int *path = malloc(sizeof(int)*(rt_node_count(sv->rg)+1));
+    OutBuf o = { malloc(4096), 0, 4096 };
+    while (1){
+        pthread_mutex_lock(&sv->mu);
+        while (sv->qlen == 0 && !atomic_load(&sv->stop)) pthread_cond_wait(&sv->cv, &sv->mu);
+        if (sv->qlen == 0){ pthread_mutex_unlock(&sv->mu); break; }
+        int ci = sv->queue[sv->qhead]; sv->qhead = (sv->qhead+1) % SERVE_MAX_CONN; sv->qlen--;
+        pthread_mutex_unlock(&sv->mu);
+
+        ServeConn *c = &sv->conn[ci]; int alive = 1;
+        ssize_t n = read(c->fd, c->in + c->in_len, SERVE_MAX_LINE - c->in_len);
+        if (n <= 0 && !(n < 0 && errno == EINTR)) alive = 0;
+        else if (n > 0) c->in_len += (int)n;
+        int start = 0; o.len = 0;
+        for (int i=0; i<c->in_len && alive; i++){
+            if (c->in[i] != '\n') continue;
+            c->in[i] = 0; if (i > start && c->in[i-1] == '\r') c->in[i-1] = 0;
+            alive = serve_line(sv, c->in + start, path, &o);
+            atomic_fetch_add(&sv->served, 1);
+            start = i+1;
         }
+        if (alive && start == 0 && c->in_len == SERVE_MAX_LINE){ out_printf(&o, "ERR line too long\n"); alive = 0; }
+        memmove(c->in, c->in + start, c->in_len - start); c->in_len -= start;
+        if (o.len && write_all(c->fd, o.buf, o.len) < 0) alive = 0;
+
+        pthread_mutex_lock(&sv->mu);
+        if (!alive){ close(c->fd); c->fd = -1; c->in_len = 0; }
+        c->busy = 0;
+        pthread_mutex_unlock(&sv->mu);
+        char b = 1; if (write(sv->wake[1], &b, 1) < 0){ /* poll loop wakes on its timeout anyway */ }
     }
-    fclose(f); return g->V;
-}
-int load_edges(Graph *g, const char *fname){
-    FILE *f = fopen(fname,"r"); if (!f){ perror("open edges.csv"); return -1; }
-    char line[LINEBUF];
-    if (!fgets(line, LINEBUF, f)){ fclose(f); return 0; } // header
-    int count=0;
-    while (fgets(line, LINEBUF, f)){
-        trim(line); if (strlen(line)==0) continue;
-        char *tok = strtok(line, ","); if (!tok) continue; // edge_id
-        tok = strtok(NULL, ","); if (!tok) continue; long long from = atoll(tok);
-        tok = strtok(NULL, ","); if (!tok) continue; long long to = atoll(tok);
-        tok = strtok(NULL, ","); tok = strtok(NULL, ","); double travel_time = tok ? atof(tok) : 0.0;
-        tok = strtok(NULL, ","); int one_way = tok ? atoi(tok) : 0;
-        int u = graph_get_or_create(g, from);
-        int v = graph_get_or_create(g, to);
-        if (one_way) graph_add_edge(g, u, v, travel_time);
-        else { graph_add_edge(g, u, v, travel_time); graph_add_edge(g, v, u, travel_time); }
-        count++;
-    }
-    fclose(f); return count;
-}
-
-
-typedef struct { int node; double dist; } HNode;
-typedef struct { HNode *a; int size; int cap; } MinHeap;
-MinHeap* heap_create(int cap){ MinHeap *h = malloc(sizeof(MinHeap)); h->cap = cap>16?cap:16; h->a = malloc(sizeof(HNode)*(h->cap+1)); h->size=0; return h;}
-void heap_free(MinHeap *h){ if(!h) return; free(h->a); free(h); } void heap_swap(HNode *x, HNode *y){ HNode t=*x; *x=*y; *y=t; }
-void heap_push(MinHeap *h, int node, double dist){ if (h->size+1>h->cap){ h->cap*=2; h->a=realloc(h->a,sizeof(HNode)*(h->cap+1));} int i=++h->size; h->a[i].node=node; h->a[i].dist=dist; while(i>1){ int p=i>>1; if (h->a[p].dist<=h->a[i].dist) break; heap_swap(&h->a[p],&h->a[i]); i=p; } }
-int heap_empty(MinHeap *h){ return h->size==0; } HNode heap_pop(MinHeap *h){ HNode ret = h->a[1]; h->a[1]=h->a[h->size--]; int i=1; while(1){ int l=i<<1, r=l+1, s=i; if (l<=h->size && h->a[l].dist < h->a[s].dist) s=l; if (r<=h->size && h->a[r].dist < h->a[s].dist) s=r; if (s==i) break; heap_swap(&h->a[i], &h->a[s]); i=s; } return ret; }
-
-void dijkstra(Graph *g, int src, double *dist, int *parent){
-    int n = g->V; for (int i=0;i<n;i++){ dist[i]=INF; parent[i]=-1; } dist[src]=0.0;
-    MinHeap *pq = heap_create(n>16?n:16); heap_push(pq, src, 0.0); char *vis = calloc(n,1);
-    while (!heap_empty(pq)){
-        HNode hn = heap_pop(pq); int u = hn.node; double d = hn.dist;
-        if (d > dist[u]) continue; if (vis[u]) continue; vis[u]=1;
-        for (int e = g->head[u]; e!=-1; e = g->edges[e].next){
-            int v = g->edges[e].to; double w = g->edges[e].weight;
-            double nd = dist[u] + w;
-            if (nd < dist[v]){ dist[v] = nd; parent[v]=u; heap_push(pq, v, nd); }
+    free(o.buf); free(path); return NULL;
+}
+
+/* listening socket at sock_path (a stale one is replaced); -1 on failure */
+static int serve_listen(const char *sock_path){
+    struct sockaddr_un addr; memset(&addr, 0, sizeof(addr)); addr.sun_family = AF_UNIX;
+    if (strlen(sock_path) >= sizeof(addr.sun_path)){ printf("Socket path too long\n"); return -1; }
+    strcpy(addr.sun_path, sock_path);
+    int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (lfd < 0){ perror("socket"); return -1; }
+    unlink(sock_path);
+    if (bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(lfd, 128) < 0){ perror("bind/listen"); close(lfd); return -1; }
+    return lfd;
+}
+
+int run_server(RtGraph *rg, const char *sock_path, int workers){
+    int lfd = serve_listen(sock_path);
+    if (lfd < 0) return 1;
+
+    Server *sv = calloc(1, sizeof(Server));
+    sv->rg = rg;
+    for (int i=0;i<rt_node_count(rg);i++) sv->edges += rt_neighbors(rg, i, NULL, NULL, 0);
+    pthread_mutex_init(&sv->mu, NULL); pthread_cond_init(&sv->cv, NULL);
+    if (pipe(sv->wake) < 0){ perror("pipe"); close(lfd); return 1; }
+    fcntl(sv->wake[0], F_SETFL, O_NONBLOCK);
+    for (int i=0;i<SERVE_MAX_CONN;i++){ sv->conn[i].fd = -1; sv->conn[i].in = NULL; }
+
+    struct sigaction sa; memset(&sa, 0, sizeof(sa)); sa.sa_handler = serve_on_signal;
+    sigaction(SIGINT, &sa, NULL); sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (workers < 1) workers = 1;
+    pthread_t *tid = malloc(sizeof(pthread_t)*workers);
+    for (int i=0;i<workers;i++) pthread_create(&tid[i], NULL, serve_worker, sv);
+    printf("Serving %d nodes on %s with %d workers\n", rt_node_count(rg), sock_path, workers); fflush(stdout);
+
+    struct pollfd *pfd = malloc(sizeof(struct pollfd)*(SERVE_MAX_CONN+2)); int *pidx = malloc(sizeof(int)*(SERVE_MAX_CONN+2));
+    while (!atomic_load(&serve_signal_stop)){
+        int np = 0;
+        pfd[np].fd = lfd; pfd[np].events = POLLIN; pidx[np++] = -1;
+        pfd[np].fd = sv->wake[0]; pfd[np].events = POLLIN; pidx[np++] = -1;
+        pthread_mutex_lock(&sv->mu);
+        for (int i=0;i<SERVE_MAX_CONN;i++) if (sv->conn[i].fd >= 0 && !sv->conn[i].busy){ pfd[np].fd = sv->conn[i].fd; pfd[np].events = POLLIN; pidx[np++] = i; }
+        pthread_mutex_unlock(&sv->mu);
+        int r = poll(pfd, np, 500);
+        if (r <= 0) continue;
+        if (pfd[1].revents & POLLIN){ char b[256]; while (read(sv->wake[0], b, sizeof(b)) > 0); }
+        if (pfd[0].revents & POLLIN){
+            int cfd = accept(lfd, NULL, NULL);
+            if (cfd >= 0){
+                pthread_mutex_lock(&sv->mu);
+                int slot = -1; for (int i=0;i<SERVE_MAX_CONN;i++) if (sv->conn[i].fd < 0){ slot = i; break; }
+                if (slot < 0) close(cfd);
+                else { ServeConn *c = &sv->conn[slot]; c->fd = cfd; c->busy = 0; c->in_len = 0; if (!c->in) c->in = malloc(SERVE_MAX_LINE + 1); }
+                pthread_mutex_unlock(&sv->mu);
+            }
         }
+        pthread_mutex_lock(&sv->mu);
+        for (int i=2;i<np;i++) if (pfd[i].revents & (POLLIN|POLLHUP|POLLERR)){
+            sv->conn[pidx[i]].busy = 1;
+            sv->queue[(sv->qhead + sv->qlen) % SERVE_MAX_CONN] = pidx[i]; sv->qlen++;
+            pthread_cond_signal(&sv->cv);
+        }
+        pthread_mutex_unlock(&sv->mu);
     }
-    free(vis); heap_free(pq);
+
+    pthread_mutex_lock(&sv->mu); atomic_store(&sv->stop, 1); pthread_cond_broadcast(&sv->cv); pthread_mutex_unlock(&sv->mu);
+    for (int i=0;i<workers;i++) pthread_join(tid[i], NULL);
+    for (int i=0;i<SERVE_MAX_CONN;i++){ if (sv->conn[i].fd >= 0) close(sv->conn[i].fd); free(sv->conn[i].in); }
+    printf("Shutting down after %llu requests\n", (unsigned long long)atomic_load(&sv->served));
+    unsigned long long h, m; rt_cache_stats(rg, &h, &m);
+    printf("route cache: %llu hits, %llu misses, hit rate %.1f%%\n", h, m, h+m ? 100.0*h/(h+m) : 0.0);
+    close(lfd); unlink(sock_path); close(sv->wake[0]); close(sv->wake[1]);
+    pthread_mutex_destroy(&sv->mu); pthread_cond_destroy(&sv->cv);
+    free(pfd); free(pidx); free(tid); free(sv);
+    return 0;
 }
 
 
-void print_path(Graph *g, int *parent, int dest){
-    if (dest < 0 || dest >= g->V) { printf("Invalid dest\n"); return; }
-    int *stack = malloc(sizeof(int) * g->V); int top = 0, cur = dest;
-    while (cur != -1){ stack[top++] = cur; cur = parent[cur]; }
-    for (int i = top-1; i>=0; i--){
-        int idx = stack[i];
-        if (g->name[idx]) printf("%s", g->name[idx]); else printf("%lld", g->ext_id[idx]);
-        if (i) printf(" -> ");
+/* ---- region shards: a worker process per region, the coordinator on the boundary overlay ----
+   --shard-split K DIR cuts the graph into K regions (shard_write); --shard-serve DIR SOCK starts one
+   worker per region, each loading only its own region's files, and answers ROUTE on SOCK like --serve.
+   the coordinator holds the overlay: each region's boundary nodes, the fastest times between them
+   inside the region (a clique per region, sent by its worker at startup) and the roads between
+   regions. s -> t asks the end regions for s -> their boundary and their boundary -> t, searches the
+   overlay in between, and keeps the in-region route when s and t share a region and it is faster.
+   a worker talks over a socketpair: a ShardMsg header, then len payload bytes, one request at a time. */
+enum { SHARD_RESOLVE, SHARD_ENDS, SHARD_PATH, SHARD_QUIT };
+typedef struct { int op, a, b, len; } ShardMsg;   /* in replies op is 0, or -1 for an error */
+typedef struct { int nodes, edges, nb; size_t reserved; } ShardHello;
+typedef struct { int node; double km; } ShardHit;  /* km -1 when the location was not a GPS fix */
+
+static int read_all(int fd, void *buf, size_t len){
+    char *p = buf;
+    while (len > 0){ ssize_t n = read(fd, p, len); if (n < 0 && errno == EINTR) continue; if (n <= 0) return -1; p += n; len -= (size_t)n; }
+    return 0;
+}
+static int shard_send(int fd, int op, int a, int b, const void *payload, int len){
+    ShardMsg m = { op, a, b, len };
+    return write_all(fd, (const char*)&m, sizeof(m)) < 0 || (len && write_all(fd, payload, len) < 0) ? -1 : 0;
+}
+/* reads one message; the payload goes to *buf, grown as needed */
+static int shard_recv(int fd, ShardMsg *m, void **buf, size_t *cap){
+    if (read_all(fd, m, sizeof(*m)) < 0 || m->len < 0) return -1;
+    if ((size_t)m->len > *cap){ *cap = (size_t)m->len; *buf = realloc(*buf, *cap); }
+    return read_all(fd, *buf, (size_t)m->len);
+}
+
+/* fastest times from src (to it when backward) to every boundary node, into row; stops once they
+   and t are settled. returns src -> t (INF without t) */
+static double shard_search(Graph *g, SearchWork *w, int src, int backward, const int *bnd, const int *slot, int nb, int t, double *row){
+    int left = nb + (t >= 0 && slot[t] < 0);
+    search_work_reset(w); sw_relax(w, src, 0.0, -1, -1);
+    while (w->hsize && left){
+        int u = sw_heap_pop(w); double du = w->dist[u];
+        if (slot[u] >= 0 || u == t) left--;
+        if (!backward){ for (int e=g->head[u]; e!=-1; e=g->edges[e].next) sw_relax(w, g->edges[e].to, du + g->edges[e].weight, u, -1); }
+        else for (int p=g->rev_off[u]; p<g->rev_off[u+1]; p++) sw_relax(w, g->rev_from[p], du + g->edges[g->rev_edge[p]].weight, u, -1);
     }
-    printf("\n"); free(stack);
+    for (int j=0;j<nb;j++) row[j] = w->pos[bnd[j]] == -2 ? w->dist[bnd[j]] : INF;
+    return t >= 0 && w->pos[t] == -2 ? w->dist[t] : INF;
 }
 
+/* a worker process (--shard-worker DIR R FD, started by shard_open): serves region r on fd until QUIT or EOF */
+static int shard_worker(const char *dir, int r, int fd){
+    char fn[4096], ef[4096];
+    snprintf(fn, sizeof(fn), "%s/shard-%d.nodes.csv", dir, r); snprintf(ef, sizeof(ef), "%s/shard-%d.edges.csv", dir, r);
+    Graph *g = graph_create(4096);
+    if (load_nodes(g, fn) < 0 || load_edges(g, ef) < 0){ graph_free(g); return 1; }
+    graph_reorder(g, REORDER_HILBERT); graph_build_reverse(g);
+    GeoIndex *geo = geo_build(g);
+    int n = g->V, nb = 0, *bnd = malloc(sizeof(int)*(n>0?n:1)), *slot = malloc(sizeof(int)*(n>0?n:1));
+    for (int i=0;i<n;i++) slot[i] = -1;
+    snprintf(fn, sizeof(fn), "%s/overlay.csv", dir); FILE *f = fopen(fn, "r");
+    if (!f){ perror(fn); graph_free(g); return 1; }
+    char line[1024]; long long a, b; int ra, rb;
+    while (fgets(line, sizeof(line), f)) if (sscanf(line, "%lld,%lld,%d,%d", &a, &b, &ra, &rb) == 4){
+        int u = ra == r ? llmap_find(g->idmap, a) : rb == r ? llmap_find(g->idmap, b) : -1;
+        if (u >= 0 && slot[u] < 0){ slot[u] = nb; bnd[nb++] = u; }
+    }
+    fclose(f);
 
-int find_node_by_name(Graph *g, const char *query){
-    char qlow[1024]; str_to_lower(query, qlow);
-    for (int i=0;i<g->V;i++){
-        if (g->name[i]){
-            char lnm[1024]; str_to_lower(g->name[i], lnm);
-            if (strstr(lnm, qlow)) return i;
-        }
+    /* the clique: boundary -> boundary inside the region, sent with the hello */
+    SearchWork *w = search_work_create(n); int *path = malloc(sizeof(int)*(n+1));
+    size_t hlen = sizeof(ShardHello) + (size_t)nb*(sizeof(long long) + sizeof(int)) + (size_t)nb*nb*sizeof(double);
+    char *hb = malloc(hlen); ShardHello *h = (ShardHello*)hb;
+    long long *ext = (long long*)(h + 1); double *clq = (double*)(ext + nb); int *loc = (int*)(clq + (size_t)nb*nb);
+    for (int i=0;i<nb;i++){ ext[i] = g->ext_id[bnd[i]]; loc[i] = bnd[i]; shard_search(g, w, bnd[i], 0, bnd, slot, nb, -1, clq + (size_t)i*nb); }
+    MemReport mr = {0}; graph_memory(g, &mr); geo_memory(g, geo, NULL, &mr);
+    mem_add(&mr, "query arrays", search_work_bytes(n), search_work_bytes(n));
+    h->nodes = n; h->edges = g->edge_count; h->nb = nb; h->reserved = mem_total(&mr, NULL);
+    int rc = shard_send(fd, 0, r, 0, hb, (int)hlen);
+    free(hb);
+
+    double *row = malloc(sizeof(double)*(2*nb+1)); long long *ids = malloc(sizeof(long long)*(n+1));
+    void *in = NULL; size_t incap = 0; ShardMsg m;
+    while (rc == 0 && shard_recv(fd, &m, &in, &incap) == 0 && m.op != SHARD_QUIT){
+        int okv = m.a >= -1 && m.a < n && m.b >= -1 && m.b < n;
+        if (m.op == SHARD_RESOLVE && m.len > 0){
+            char *key = in; key[m.len-1] = 0;
+            ShardHit hit = { -1, -1.0 }; double lat, lon; char *end; long long id = strtoll(key, &end, 10);
+            if (parse_latlon(key, &lat, &lon)) hit.node = geo_nearest(geo, lat, lon, &hit.km);
+            else if (*end == 0 && end != key) hit.node = llmap_find(g->idmap, id);
+            else { for (char *p = key; *p; p++) if (*p == '_') *p = ' '; hit.node = find_node_by_name(g, key); }
+            rc = shard_send(fd, 0, 0, 0, &hit, sizeof(hit));
+        } else if (m.op == SHARD_ENDS && okv){
+            double st = INF; int k = 0;
+            if (m.a >= 0){ st = shard_search(g, w, m.a, 0, bnd, slot, nb, m.b, row); k = nb; }
+            if (m.b >= 0){ shard_search(g, w, m.b, 1, bnd, slot, nb, -1, row + k); k += nb; }
+            if (m.a >= 0 && m.b >= 0) row[k++] = st;
+            rc = shard_send(fd, 0, 0, 0, row, k*(int)sizeof(double));
+        } else if (m.op == SHARD_PATH && okv && m.a >= 0 && m.b >= 0){
+            int len = 0; route_query(g, NULL, w, m.a, m.b, path, &len);
+            for (int i=0;i<len;i++) ids[i] = g->ext_id[path[i]];
+            rc = shard_send(fd, 0, 0, 0, ids, len*(int)sizeof(long long));
+        } else rc = shard_send(fd, -1, 0, 0, NULL, 0);
+    }
+    free(in); free(row); free(ids); free(path); free(bnd); free(slot);
+    search_work_free(w); geo_free(geo); graph_free(g); close(fd);
+    return 0;
+}
+
+typedef struct {
+    int k, B;                       /* regions, overlay nodes (all boundary nodes) */
+    int *fd; pid_t *pid; ShardHello *hello;
+    int *b0;                        /* region r's boundary nodes are overlay nodes b0[r] .. b0[r+1) */
+    int *region, *local;            /* per overlay node: its region and node handle in that worker */
+    long long *ext;
+    double **clq;                   /* clq[r][i*nb + j]: boundary i -> j inside region r */
+    int *cut_off, *cut_to, ncut;    /* roads between regions, CSR over overlay nodes */
+    double *cut_w;
+    SearchWork *w;
+    void *buf[2]; size_t cap[2];    /* reply payloads: the source and target region's rows */
+    long long *path; int path_len, path_cap;
+    unsigned long long served;
+} ShardSet;
+
+void shard_close(ShardSet *ss){
+    if (!ss) return;
+    for (int r=0;r<ss->k;r++){
+        if (ss->fd[r] >= 0){ shard_send(ss->fd[r], SHARD_QUIT, 0, 0, NULL, 0); close(ss->fd[r]); }
+        if (ss->pid[r] > 0) waitpid(ss->pid[r], NULL, 0);
+        if (ss->clq) free(ss->clq[r]);
     }
-    return -1;
+    free(ss->fd); free(ss->pid); free(ss->hello); free(ss->b0); free(ss->region); free(ss->local); free(ss->ext); free(ss->clq);
+    free(ss->cut_off); free(ss->cut_to); free(ss->cut_w); search_work_free(ss->w);
+    free(ss->buf[0]); free(ss->buf[1]); free(ss->path); free(ss);
 }
 
+/* starts a worker per region in dir (this binary, re-executed) and builds the overlay from their
+   cliques and overlay.csv; NULL when the files are missing or a worker fails to come up */
+ShardSet* shard_open(const char *dir){
+    char fn[4096]; int k = 0;
+    while (snprintf(fn, sizeof(fn), "%s/shard-%d.nodes.csv", dir, k), access(fn, R_OK) == 0) k++;
+    if (k == 0){ fprintf(stderr, "no shard files in %s (see --shard-split)\n", dir); return NULL; }
+    ShardSet *ss = calloc(1, sizeof(ShardSet)); ss->k = k;
+    ss->fd = malloc(sizeof(int)*k); ss->pid = calloc(k, sizeof(pid_t)); ss->hello = calloc(k, sizeof(ShardHello));
+    ss->b0 = calloc(k+1, sizeof(int)); ss->clq = calloc(k, sizeof(double*));
+    signal(SIGPIPE, SIG_IGN);
+    for (int r=0;r<k;r++){
+        int sp[2]; ss->fd[r] = -1;
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sp) < 0){ perror("socketpair"); shard_close(ss); return NULL; }
+        fcntl(sp[0], F_SETFD, FD_CLOEXEC);
+        pid_t pid = fork();
+        if (pid == 0){
+            char rs[16], fs[16]; snprintf(rs, sizeof(rs), "%d", r); snprintf(fs, sizeof(fs), "%d", sp[1]);
+            execl("/proc/self/exe", "graph", "--shard-worker", dir, rs, fs, (char*)NULL);
+            perror("exec shard worker"); _exit(127);
+        }
+        close(sp[1]);
+        if (pid < 0){ perror("fork"); close(sp[0]); shard_close(ss); return NULL; }
+        ss->fd[r] = sp[0]; ss->pid[r] = pid;
+    }
+    /* workers load in parallel; hellos are collected in region order */
+    long long **bext = calloc(k, sizeof(long long*)); int **bloc = calloc(k, sizeof(int*)); int ok = 1;
+    for (int r=0; r<k && ok; r++){
+        ShardMsg m;
+        if (shard_recv(ss->fd[r], &m, &ss->buf[0], &ss->cap[0]) < 0 || m.op != 0 || (size_t)m.len < sizeof(ShardHello)){ fprintf(stderr, "shard %d did not start\n", r); ok = 0; break; }
+        ShardHello *h = ss->buf[0]; int nb = h->nb; ss->hello[r] = *h;
+        if ((size_t)m.len != sizeof(ShardHello) + (size_t)nb*(sizeof(long long) + sizeof(int)) + (size_t)nb*nb*sizeof(double)){ fprintf(stderr, "shard %d sent a bad hello\n", r); ok = 0; break; }
+        long long *ext = (long long*)(h + 1); double *clq = (double*)(ext + nb); int *loc = (int*)(clq + (size_t)nb*nb);
+        bext[r] = malloc(sizeof(long long)*(nb+1)); memcpy(bext[r], ext, sizeof(long long)*nb);
+        bloc[r] = malloc(sizeof(int)*(nb+1)); memcpy(bloc[r], loc, sizeof(int)*nb);
+        ss->clq[r] = malloc(sizeof(double)*((size_t)nb*nb+1)); memcpy(ss->clq[r], clq, sizeof(double)*nb*nb);
+        ss->b0[r+1] = ss->b0[r] + nb;
+    }
+    int B = ok ? ss->b0[k] : 0; ss->B = B;
+    ss->region = malloc(sizeof(int)*(B+1)); ss->local = malloc(sizeof(int)*(B+1)); ss->ext = malloc(sizeof(long long)*(B+1));
+    LLMap *idx = llmap_create(2*B + 16);
+    for (int r=0; r<k && ok; r++) for (int i=0;i<ss->b0[r+1]-ss->b0[r];i++){
+        int v = ss->b0[r] + i; ss->region[v] = r; ss->local[v] = bloc[r][i]; ss->ext[v] = bext[r][i]; llmap_put(idx, bext[r][i], v);
+    }
+    for (int r=0;r<k;r++){ free(bext[r]); free(bloc[r]); }
+    free(bext); free(bloc);
 
-int find_nearest_of_type_from(Graph *g, int start_idx, const char *requested_type){
-    if (!g || start_idx < 0 || start_idx >= g->V) return -1;
-    double *dist = malloc(sizeof(double) * g->V);
-    int *parent = malloc(sizeof(int) * g->V);
-    if (!dist || !parent) { free(dist); free(parent); return -1; }
-    dijkstra(g, start_idx, dist, parent);
-    double best = INF; int best_idx = -1;
-    for (int i=0;i<g->V;i++){
-        if (node_matches_type_or_name(g, i, requested_type)){
-            if (dist[i] < best){ best = dist[i]; best_idx = i; }
+    /* roads between regions, two passes over overlay.csv: count per tail, then fill */
+    ss->cut_off = calloc(B+2, sizeof(int));
+    snprintf(fn, sizeof(fn), "%s/overlay.csv", dir); FILE *f = ok ? fopen(fn, "r") : NULL;
+    if (ok && !f){ perror(fn); ok = 0; }
+    char line[1024]; long long a, b; int ra, rb; double len, wt;
+    for (int pass=0; pass<2 && ok; pass++){
+        rewind(f);
+        while (fgets(line, sizeof(line), f)) if (sscanf(line, "%lld,%lld,%d,%d,%lf,%lf", &a, &b, &ra, &rb, &len, &wt) == 6){
+            int u = llmap_find(idx, a), v = llmap_find(idx, b);
+            if (u < 0 || v < 0) continue;
+            if (pass == 0){ ss->cut_off[u+2]++; continue; }
+            int p = ss->cut_off[u+1]++; ss->cut_to[p] = v; ss->cut_w[p] = wt;
+        }
+        if (pass == 0){
+            for (int i=0;i<B;i++) ss->cut_off[i+2] += ss->cut_off[i+1];
+            ss->ncut = ss->cut_off[B+1]; ss->cut_to = malloc(sizeof(int)*(ss->ncut+1)); ss->cut_w = malloc(sizeof(double)*(ss->ncut+1));
         }
     }
-    free(dist); free(parent);
-    return best_idx;
+    if (f) fclose(f);
+    llmap_free(idx);
+    if (!ok){ shard_close(ss); return NULL; }
+    ss->w = search_work_create(B);
+    ss->path_cap = 1024; ss->path = malloc(sizeof(long long)*ss->path_cap);
+    return ss;
 }
 
+/* the region and worker node handle of a location (see serve_resolve): an id or name match in any
+   region wins over a snapped GPS fix, and the nearest snap over farther ones. -1 when none matches */
+int shard_resolve(ShardSet *ss, const char *key, int *node){
+    int n = (int)strlen(key) + 1, best = -1; double best_km = INF;
+    for (int r=0;r<ss->k;r++) if (shard_send(ss->fd[r], SHARD_RESOLVE, 0, 0, key, n) < 0) return -1;
+    for (int r=0;r<ss->k;r++){
+        ShardMsg m;
+        if (shard_recv(ss->fd[r], &m, &ss->buf[0], &ss->cap[0]) < 0) return -1;
+        ShardHit *hit = ss->buf[0];
+        if (m.op != 0 || m.len != sizeof(ShardHit) || hit->node < 0) continue;
+        if (hit->km < best_km){ best_km = hit->km; best = r; *node = hit->node; }
+    }
+    return best;
+}
 
-int parse_any_keyword_strict(const char *s, char *out_type){ char low[256]; str_to_lower(s, low);
-    if (strcmp(low, "hospital")==0 || strcmp(low, "any hospital")==0 || strcmp(low, "from hospital")==0) { strcpy(out_type,"hospital"); return 1; }
-    if (strcmp(low, "fire")==0 || strcmp(low, "firestation")==0 || strcmp(low,"fire station")==0 || strcmp(low,"any fire")==0 || strcmp(low,"any fire station")==0 || strcmp(low,"from fire")==0) { strcpy(out_type,"fire"); return 1; }
-    if (strcmp(low, "police")==0 || strcmp(low,"police station")==0 || strcmp(low,"any police")==0 || strcmp(low,"from police")==0) { strcpy(out_type,"police"); return 1; }
-    if (strncmp(low, "any ", 4) == 0){
-        if (strstr(low, "hospital")){ strcpy(out_type,"hospital"); return 1; }
-        if (strstr(low, "fire")){ strcpy(out_type,"fire"); return 1; }
-        if (strstr(low, "police")){ strcpy(out_type,"police"); return 1; }
+static int shard_path_append(ShardSet *ss, int r, int a, int b){
+    ShardMsg m;
+    if (shard_send(ss->fd[r], SHARD_PATH, a, b, NULL, 0) < 0 || shard_recv(ss->fd[r], &m, &ss->buf[0], &ss->cap[0]) < 0 || m.op != 0) return -1;
+    const long long *ids = ss->buf[0]; int n = m.len / (int)sizeof(long long);
+    if (ss->path_len + n > ss->path_cap){ ss->path_cap = 2*(ss->path_len + n); ss->path = realloc(ss->path, sizeof(long long)*ss->path_cap); }
+    for (int i=0;i<n;i++) if (ss->path_len == 0 || i > 0 || ss->path[ss->path_len-1] != ids[i]) ss->path[ss->path_len++] = ids[i];
+    return 0;
+}
+
+/* fastest s -> t, s a node of region rs and t of rt (worker handles); INF without a path, -1 when a
+   worker is gone. with want_path the route's external ids are left in ss->path[0 .. path_len) */
+double shard_route(ShardSet *ss, int rs, int s, int rt, int t, int want_path){
+    int ns = ss->b0[rs+1] - ss->b0[rs], nt = ss->b0[rt+1] - ss->b0[rt]; ShardMsg m;
+    /* both end regions search at once; same region: one request, rows s -> boundary, boundary -> t, then s -> t */
+    if (shard_send(ss->fd[rs], SHARD_ENDS, s, rs == rt ? t : -1, NULL, 0) < 0) return -1;
+    if (rs != rt && shard_send(ss->fd[rt], SHARD_ENDS, -1, t, NULL, 0) < 0) return -1;
+    if (shard_recv(ss->fd[rs], &m, &ss->buf[0], &ss->cap[0]) < 0 || m.op != 0 || m.len != (rs == rt ? 2*ns+1 : ns)*(int)sizeof(double)) return -1;
+    if (rs != rt && (shard_recv(ss->fd[rt], &m, &ss->buf[1], &ss->cap[1]) < 0 || m.op != 0 || m.len != nt*(int)sizeof(double))) return -1;
+    const double *fwd = ss->buf[0], *bwd = rs == rt ? fwd + ns : ss->buf[1];
+    double best = rs == rt ? fwd[2*ns] : INF; int bestb = -1;
+
+    SearchWork *w = ss->w; search_work_reset(w);
+    for (int i=0;i<ns;i++) if (fwd[i] < INF) sw_relax(w, ss->b0[rs] + i, fwd[i], -1, -1);
+    while (w->hsize){
+        int u = sw_heap_pop(w); double du = w->dist[u];
+        if (du >= best) break;
+        int r = ss->region[u], i = u - ss->b0[r], nb = ss->b0[r+1] - ss->b0[r];
+        if (r == rt && du + bwd[i] < best){ best = du + bwd[i]; bestb = u; }
+        const double *row = ss->clq[r] + (size_t)i*nb;
+        for (int j=0;j<nb;j++) if (row[j] < INF) sw_relax(w, ss->b0[r] + j, du + row[j], u, -1);
+        for (int p=ss->cut_off[u]; p<ss->cut_off[u+1]; p++) sw_relax(w, ss->cut_to[p], du + ss->cut_w[p], u, -1);
     }
-    if (strncmp(low, "from any ", 9) == 0){
-        if (strstr(low, "hospital")){ strcpy(out_type,"hospital"); return 1; }
-        if (strstr(low, "fire")){ strcpy(out_type,"fire"); return 1; }
-        if (strstr(low, "police")){ strcpy(out_type,"police"); return 1; }
+    ss->path_len = 0;
+    if (!want_path || best >= INF) return best;
+    /* unpack: the in-region legs come from their workers, roads between regions are taken as they are */
+    if (bestb < 0) return shard_path_append(ss, rs, s, t) < 0 ? -1 : best;
+    int hops = 0; for (int x = bestb; x != -1; x = w->par[x]) hops++;
+    int *seq = malloc(sizeof(int)*hops);
+    for (int x = bestb, i = hops-1; x != -1; x = w->par[x], i--) seq[i] = x;
+    int rc = shard_path_append(ss, rs, s, ss->local[seq[0]]);
+    for (int i=1; i<hops && rc == 0; i++){
+        int a = seq[i-1], b = seq[i];
+        if (ss->region[a] == ss->region[b]) rc = shard_path_append(ss, ss->region[a], ss->local[a], ss->local[b]);
+        else { if (ss->path_len == ss->path_cap){ ss->path_cap *= 2; ss->path = realloc(ss->path, sizeof(long long)*ss->path_cap); } ss->path[ss->path_len++] = ss->ext[b]; }
+    }
+    if (rc == 0) rc = shard_path_append(ss, rt, ss->local[seq[hops-1]], t);
+    free(seq);
+    return rc < 0 ? -1 : best;
+}
+
+static void shard_stats(ShardSet *ss, FILE *f){
+    size_t total = 0, most = 0;
+    for (int r=0;r<ss->k;r++){
+        ShardHello *h = &ss->hello[r]; total += h->reserved; if (h->reserved > most) most = h->reserved;
+        fprintf(f, "  shard %d: %d nodes, %d roads, %d boundary nodes, %.1f KB\n", r, h->nodes, h->edges, h->nb, h->reserved / 1024.0);
+    }
+    size_t ov = 0; for (int r=0;r<ss->k;r++){ int nb = ss->b0[r+1] - ss->b0[r]; ov += mem_block(sizeof(double)*((size_t)nb*nb+1)); }
+    ov += mem_block(sizeof(int)*(ss->B+2)) + 2*mem_block(sizeof(int)*(ss->B+1)) + mem_block(sizeof(long long)*(ss->B+1)) + mem_block(sizeof(int)*(ss->ncut+1)) + mem_block(sizeof(double)*(ss->ncut+1)) + search_work_bytes(ss->B);
+    fprintf(f, "  overlay: %d boundary nodes, %d roads between regions, %.1f KB\n", ss->B, ss->ncut, ov / 1024.0);
+    fprintf(f, "  largest worker %.1f KB, all workers %.1f KB\n", most / 1024.0, total / 1024.0);
+}
+
+/* ROUTE <from> <to> | STATS | PING | QUIT, answered like serve_line; 0 when the client asked to quit */
+static int shard_line(ShardSet *ss, char *line, OutBuf *o){
+    char *save = NULL, *cmd = strtok_r(line, " \t", &save);
+    if (!cmd){ out_printf(o, "ERR empty request\n"); return 1; }
+    for (char *p = cmd; *p; p++) *p = (char)toupper((unsigned char)*p);
+    if (strcmp(cmd, "PING") == 0){ out_printf(o, "OK PONG\n"); return 1; }
+    if (strcmp(cmd, "QUIT") == 0){ out_printf(o, "OK BYE\n"); return 0; }
+    if (strcmp(cmd, "STATS") == 0){
+        long long nodes = 0; for (int r=0;r<ss->k;r++) nodes += ss->hello[r].nodes;
+        out_printf(o, "OK shards=%d nodes=%lld boundary=%d cut_roads=%d served=%llu\n", ss->k, nodes, ss->B, ss->ncut, ss->served);
+        return 1;
+    }
+    if (strcmp(cmd, "ROUTE")){ out_printf(o, "ERR unknown command %s\n", cmd); return 1; }
+    char *a = strtok_r(NULL, " \t", &save), *b = strtok_r(NULL, " \t", &save); int s = -1, t = -1;
+    int rs = a ? shard_resolve(ss, a, &s) : -1;
+    if (rs < 0){ out_printf(o, "ERR unknown source\n"); return 1; }
+    int rt = b ? shard_resolve(ss, b, &t) : -1;
+    if (rt < 0){ out_printf(o, "ERR unknown destination\n"); return 1; }
+    double d = shard_route(ss, rs, s, rt, t, 1);
+    if (d < 0){ out_printf(o, "ERR shard unavailable\n"); return 1; }
+    if (d >= INF){ out_printf(o, "ERR no path\n"); return 1; }
+    out_printf(o, "OK %.1f %d", d, ss->path_len);
+    for (int i=0;i<ss->path_len;i++) out_printf(o, " %lld", ss->path[i]);
+    out_printf(o, "\n");
+    return 1;
+}
+
+/* one thread: requests to a region are serialized on its socket anyway, the parallelism is across workers */
+int run_shard_server(const char *dir, const char *sock_path){
+    double t0 = now_sec();
+    ShardSet *ss = shard_open(dir);
+    if (!ss) return 1;
+    int lfd = serve_listen(sock_path);
+    if (lfd < 0){ shard_close(ss); return 1; }
+    struct sigaction sa; memset(&sa, 0, sizeof(sa)); sa.sa_handler = serve_on_signal;
+    sigaction(SIGINT, &sa, NULL); sigaction(SIGTERM, &sa, NULL);
+    printf("Serving %d shards from %s on %s, started in %.2f s\n", ss->k, dir, sock_path, now_sec() - t0);
+    shard_stats(ss, stdout); fflush(stdout);
+
+    ServeConn *conn = calloc(SERVE_MAX_CONN, sizeof(ServeConn)); for (int i=0;i<SERVE_MAX_CONN;i++) conn[i].fd = -1;
+    struct pollfd *pfd = malloc(sizeof(struct pollfd)*(SERVE_MAX_CONN+1)); int *pidx = malloc(sizeof(int)*(SERVE_MAX_CONN+1));
+    OutBuf o = { malloc(4096), 0, 4096 };
+    while (!atomic_load(&serve_signal_stop)){
+        int np = 0;
+        pfd[np].fd = lfd; pfd[np].events = POLLIN; pidx[np++] = -1;
+        for (int i=0;i<SERVE_MAX_CONN;i++) if (conn[i].fd >= 0){ pfd[np].fd = conn[i].fd; pfd[np].events = POLLIN; pidx[np++] = i; }
+        if (poll(pfd, np, 500) <= 0) continue;
+        if (pfd[0].revents & POLLIN){
+            int cfd = accept(lfd, NULL, NULL), slot = -1;
+            for (int i=0; i<SERVE_MAX_CONN && cfd >= 0; i++) if (conn[i].fd < 0){ slot = i; break; }
+            if (slot >= 0){ conn[slot].fd = cfd; conn[slot].in_len = 0; if (!conn[slot].in) conn[slot].in = malloc(SERVE_MAX_LINE + 1); }
+            else if (cfd >= 0) close(cfd);
+        }
+        for (int k=1;k<np;k++){
+            if (!(pfd[k].revents & (POLLIN|POLLHUP|POLLERR))) continue;
+            ServeConn *c = &conn[pidx[k]]; int alive = 1, start = 0; o.len = 0;
+            ssize_t n = read(c->fd, c->in + c->in_len, SERVE_MAX_LINE - c->in_len);
+            if (n <= 0 && !(n < 0 && errno == EINTR)) alive = 0; else if (n > 0) c->in_len += (int)n;
+            for (int i=0; i<c->in_len && alive; i++){
+                if (c->in[i] != '\n') continue;
+                c->in[i] = 0; if (i > start && c->in[i-1] == '\r') c->in[i-1] = 0;
+                alive = shard_line(ss, c->in + start, &o); ss->served++;
+                start = i+1;
+            }
+            if (alive && start == 0 && c->in_len == SERVE_MAX_LINE){ out_printf(&o, "ERR line too long\n"); alive = 0; }
+            memmove(c->in, c->in + start, c->in_len - start); c->in_len -= start;
+            if (o.len && write_all(c->fd, o.buf, o.len) < 0) alive = 0;
+            if (!alive){ close(c->fd); c->fd = -1; c->in_len = 0; }
+        }
     }
+    printf("Shutting down after %llu requests\n", ss->served);
+    for (int i=0;i<SERVE_MAX_CONN;i++){ if (conn[i].fd >= 0) close(conn[i].fd); free(conn[i].in); }
+    close(lfd); unlink(sock_path);
+    free(o.buf); free(pfd); free(pidx); free(conn); shard_close(ss);
     return 0;
 }
 
+static int dbl_cmp(const void *a, const void *b){ double x = *(const double*)a, y = *(const double*)b; return (x>y) - (x<y); }
 
-int main(int argc, char **argv){
-   if (argc < 3){ 
-    printf("Usage: %s nodes.csv edges.csv\n", argv[0]); 
-    return 1; 
+/* splits into k regions under /tmp, starts the workers and checks routes through the coordinator
+   against one search on the whole graph (held here only to check): times, and paths as real roads */
+void bench_shards(Graph *g, int k, int queries){
+    char dir[] = "/tmp/shards-XXXXXX";
+    if (!mkdtemp(dir)){ perror("mkdtemp"); return; }
+    int n = g->V, *region = malloc(sizeof(int)*(n>0?n:1));
+    double a = now_sec(); shard_partition(g, k, region);
+    int rc = shard_write(g, region, k, dir); double b = now_sec();
+    ShardSet *ss = rc == 0 ? shard_open(dir) : NULL; double c = now_sec();
+    if (ss){
+        MemReport mr = {0}; graph_memory(g, &mr); mem_add(&mr, "query arrays", search_work_bytes(n), search_work_bytes(n));
+        printf("%d nodes in %d shards: split %.2f s, workers up with cliques %.2f s; whole graph %.1f KB in one process\n", n, k, b-a, c-b, mem_total(&mr, NULL) / 1024.0);
+        shard_stats(ss, stdout);
+        SearchWork *w = search_work_create(n); int *path = malloc(sizeof(int)*(n+1));
+        double *lat = malloc(sizeof(double)*(queries>0?queries:1)), tfull = 0; unsigned seed = 77; int bad = 0, badpath = 0, cross = 0;
+        char key[32];
+        for (int q=0;q<queries;q++){
+            int s = rng_next(&seed) % n, t = rng_next(&seed) % n, ls = -1, lt = -1; lat[q] = 0;
+            snprintf(key, sizeof(key), "%lld", g->ext_id[s]); int rs = shard_resolve(ss, key, &ls);
+            snprintf(key, sizeof(key), "%lld", g->ext_id[t]); int rt = shard_resolve(ss, key, &lt);
+            if (rs != region[s] || rt != region[t]){ bad++; continue; }
+            cross += rs != rt;
+            double t0 = now_sec(); double d = shard_route(ss, rs, ls, rt, lt, 1); double t1 = now_sec();
+            int len = 0; double ref = route_query(g, NULL, w, s, t, path, &len); double t2 = now_sec();
+            lat[q] = t1 - t0; tfull += t2 - t1;
+            if (d < 0 || (ref >= INF) != (d >= INF) || (ref < INF && fabs(d - ref) > 1e-6*(1 + ref))){ bad++; continue; }
+            if (ref >= INF) continue;
+            /* the coordinator's path must run s .. t over roads that add up to its time */
+            double sum = 0; int okp = ss->path_len > 0 && ss->path[0] == g->ext_id[s] && ss->path[ss->path_len-1] == g->ext_id[t];
+            for (int i=1; i<ss->path_len && okp; i++){
+                int u = llmap_find(g->idmap, ss->path[i-1]), v = llmap_find(g->idmap, ss->path[i]); double best = INF;
+                for (int e = u >= 0 ? g->head[u] : -1; e!=-1; e=g->edges[e].next) if (g->edges[e].to == v && g->edges[e].weight < best) best = g->edges[e].weight;
+                if (best >= INF) okp = 0; else sum += best;
+            }
+            if (!okp || fabs(sum - ref) > 1e-6*(1 + ref)) badpath++;
+        }
+        qsort(lat, queries, sizeof(double), dbl_cmp);
+        double mean = 0; for (int q=0;q<queries;q++) mean += lat[q]; mean /= queries > 0 ? queries : 1;
+        printf("%d queries (%d across regions): sharded %.1f us/query (p99 %.1f us) with paths, one process %.1f us/query, %d mismatches, %d bad paths\n",
+               queries, cross, mean*1e6, queries > 0 ? lat[(int)(0.99*(queries-1))]*1e6 : 0.0, tfull*1e6/(queries>0?queries:1), bad, badpath);
+        free(lat); free(path); search_work_free(w); shard_close(ss);
+    }
+    char fn[4096];
+    for (int r=0;r<k;r++){ snprintf(fn, sizeof(fn), "%s/shard-%d.nodes.csv", dir, r); unlink(fn); snprintf(fn, sizeof(fn), "%s/shard-%d.edges.csv", dir, r); unlink(fn); }
+    snprintf(fn, sizeof(fn), "%s/overlay.csv", dir); unlink(fn); rmdir(dir);
+    free(region);
 }
 
-Graph *g = graph_create(4096);
 
-int n_nodes = load_nodes(g, argv[1]); 
-if (n_nodes < 0) return 1;
+/* nearest facility from start by travel time: a label merge per candidate when labels are loaded */
+static int nearest_of_type(Graph *g, HubLabels *hl, int start, const char *type){
+    if (!hl) return find_nearest_of_type_from(g, start, type);
+    int *cand = malloc(sizeof(int)*(g->V>0?g->V:1)), m = 0;
+    for (int i=0;i<g->V;i++) if (node_matches_type_or_name(g, i, type)) cand[m++] = i;
+    int k = hl_best_target(hl, start, cand, m, NULL), best = k == -1 ? -1 : cand[k];
+    free(cand);
+    return best;
+}
 
-int n_edges = load_edges(g, argv[2]); 
-if (n_edges < 0) return 1;
+/* what an interactive query holds: the graph, the spatial index and one search's arrays
+   (dist/parent here, the heap and visited flags inside dijkstra) */
+static void memory_report(Graph *g, GeoIndex *geo, MemReport *r){
+    graph_memory(g, r); geo_memory(g, geo, NULL, r);
+    size_t n = g->V > 16 ? g->V : 16;
+    mem_add(r, "query arrays", (size_t)g->V * (sizeof(double) + sizeof(int)),
+            mem_block(sizeof(double)*g->V) + mem_block(sizeof(int)*g->V) + mem_block(16*(n+1)) + mem_block(g->V));
+}
 
+/* ---- point-to-point query ----
+   prompts, lookups and output go through routing.h. the nearest-facility pick and the route come
+   from routing.h too unless a QuerySearch plugs in other searches (the engine options below);
+   those take and return the same node handles. */
+typedef struct {
+    void *ctx;
+    double (*route)(void *ctx, int src, int dst, int *path, int *len);   /* RT_UNREACHABLE without a path */
+    int (*nearest)(void *ctx, int start, const char *type);             /* -1 when none is reachable */
+} QuerySearch;
+static const RtOrder rt_order_of[ORDER_COUNT] = { RT_FASTEST, RT_SHORTEST, RT_FASTEST_THEN_SHORTEST, RT_SHORTEST_THEN_FASTEST };
 
-    char srcq[512], dstq[512];
-    printf("Enter source place name :\n> ");
-    getchar(); 
-    if (!fgets(srcq, sizeof(srcq), stdin)){ printf("Input error\n"); graph_free(g); return 1; }
-    trim(srcq); if (strlen(srcq)==0){ printf("Empty input\n"); graph_free(g); return 1; }
+static const char* rt_label(const RtGraph *rg, int v, const char *none){ const char *nm = rt_name(rg, v); return nm ? nm : none; }
+static void print_rt_route(const RtGraph *rg, const int *path, int len){
+    for (int i=0;i<len;i++){
+        if (rt_name(rg, path[i])) printf("%s", rt_name(rg, path[i])); else printf("%lld", rt_ext_id(rg, path[i]));
+        if (i+1 < len) printf(" -> ");
+    }
+    printf("\n");
+}
+
+static int query_nearest(RtGraph *rg, const QuerySearch *qs, int start, const char *type){
+    return qs ? qs->nearest(qs->ctx, start, type) : rt_nearest_of_type(rg, start, type, NULL, NULL, NULL, NULL, NULL);
+}
 
+static int run_query(RtGraph *rg, int order, int alternatives, const QuerySearch *qs){
+    char srcq[512], dstq[512];
+    printf("Enter source place name or lat,lon :\n> ");
+    getchar();
+    if (!fgets(srcq, sizeof(srcq), stdin)){ printf("Input error\n"); return 1; }
+    str_trim(srcq); if (strlen(srcq)==0){ printf("Empty input\n"); return 1; }
     printf("Enter destination place name (or 'hospital'/'fire'/'police'):\n> ");
-    if (!fgets(dstq, sizeof(dstq), stdin)){ printf("Input error\n"); graph_free(g); return 1; }
-    trim(dstq); if (strlen(dstq)==0){ printf("Empty input\n"); graph_free(g); return 1; }
+    if (!fgets(dstq, sizeof(dstq), stdin)){ printf("Input error\n"); return 1; }
+    str_trim(dstq); if (strlen(dstq)==0){ printf("Empty input\n"); return 1; }
 
-    // determine if source is generic
-    char src_req_type[64]; int src_is_any = parse_any_keyword_strict(srcq, src_req_type);
+    char src_type[64], dst_type[64];
+    int src_any = parse_any_keyword_strict(srcq, src_type), dst_any = parse_any_keyword_strict(dstq, dst_type);
+    int n = rt_node_count(rg), src = -1, dst = -1; double lat, lon, km;
+    if (!src_any){
+        if (parse_latlon(srcq, &lat, &lon)){
+            if ((src = rt_nearest_node(rg, lat, lon, &km)) == -1){ printf("No road node near %s\n", srcq); return 1; }
+            printf("Snapped %s to %s (%.0f m)\n", srcq, rt_label(rg, src, "(unnamed)"), km*1000.0);
+        } else if ((src = rt_find_name(rg, srcq)) == -1){ printf("Source '%s' not found\n", srcq); return 1; }
+    }
+    if (dst_any && src == -1){
+        /* both generic: the first facility of the destination type, the source nearest to it below */
+        for (int i=0;i<n && dst == -1;i++) if (rt_node_matches(rg, i, dst_type)) dst = i;
+        if (dst == -1){ printf("No facility of type '%s' found\n", dst_type); return 1; }
+    } else if (dst_any){
+        if ((dst = query_nearest(rg, qs, src, dst_type)) == -1){ printf("No facility of type '%s' found\n", dst_type); return 1; }
+        printf("Selected nearest %s as destination: %s\n", dst_type, rt_label(rg, dst, "(unnamed)"));
+    } else {
+        dst = parse_latlon(dstq, &lat, &lon) ? rt_nearest_node(rg, lat, lon, &km) : rt_find_name(rg, dstq);
+        if (dst == -1){ printf("Destination '%s' not found\n", dstq); return 1; }
+        if (!rt_node_matches(rg, dst, "hospital") && !rt_node_matches(rg, dst, "fire") && !rt_node_matches(rg, dst, "police")){
+            printf("Destination '%s' is not a hospital/fire/police type (its type: '%s')\n", rt_label(rg, dst, "N/A"), rt_type(rg, dst) ? rt_type(rg, dst) : "N/A");
+            return 1;
+        }
+    }
+    if (src == -1){
+        if ((src = query_nearest(rg, qs, dst, src_type)) == -1){ printf("No facility of type '%s' found\n", src_type); return 1; }
+        printf("Selected nearest %s as source: %s\n", src_type, rt_label(rg, src, "(unnamed)"));
+    }
 
-    int src_idx = -1;
-    if (src_is_any){
-        
+    int *path = malloc(sizeof(int) * (n > 0 ? n : 1)), len = 0; double t, m = -1;
+    if (qs) t = qs->route(qs->ctx, src, dst, path, &len);
+    else if (order < 0) t = rt_route(rg, src, dst, path, &len);
+    else if (rt_route_by(rg, src, dst, rt_order_of[order], &t, &m, path, &len) != 1) t = RT_UNREACHABLE;
+    if (t >= RT_UNREACHABLE){
+        printf("No path found from '%s' to '%s'\n", rt_label(rg, src, "src"), rt_label(rg, dst, "dst"));
     } else {
-        
-        int f = find_node_by_name(g, srcq);
-        if (f == -1){ printf("Source '%s' not found\n", srcq); graph_free(g); return 1; }
-        src_idx = f;
-    }
-
-   
-    char dst_req_type[64]; int dst_is_any = parse_any_keyword_strict(dstq, dst_req_type);
-
-    int dst_idx = -1;
-    if (dst_is_any){
-       
-        if (src_idx == -1){
-           
-            for (int i=0;i<g->V;i++){ if (node_matches_type_or_name(g,i,dst_req_type)){ dst_idx = i; break; } }
-            if (dst_idx==-1){ printf("No facility of type '%s' found\n", dst_req_type); graph_free(g); return 1; }
-            
-            if (src_is_any){
-                int src_chosen = find_nearest_of_type_from(g, dst_idx, src_req_type);
-                if (src_chosen == -1){ printf("No facility of type '%s' found\n", src_req_type); graph_free(g); return 1; }
-                src_idx = src_chosen;
-                printf("Selected nearest %s as source: %s\n", src_req_type, g->name[src_idx] ? g->name[src_idx] : "(unnamed)");
-            }
-        } else {
-           
-            int chosen = find_nearest_of_type_from(g, src_idx, dst_req_type);
-            if (chosen == -1){ printf("No facility of type '%s' found\n", dst_req_type); graph_free(g); return 1; }
-            dst_idx = chosen;
-            printf("Selected nearest %s as destination: %s\n", dst_req_type, g->name[dst_idx] ? g->name[dst_idx] : "(unnamed)");
+        printf("\n%s travel time = %.1f seconds (%.2f minutes)\n", order == ORDER_LENGTH || order == ORDER_LENGTH_TIME ? "Route" : "Shortest", t, t/60.0);
+        if (m >= 0) printf("Route length = %.2f km (best by %s)\n", m / 1000.0, route_order_name(order));
+        printf("Route: "); print_rt_route(rg, path, len); printf("\n");
+        if (alternatives > 1){
+            /* backups if the primary is blocked: within 50% of the fastest, at most half shared */
+            RtRoutes alt; int k = rt_alternatives(rg, src, dst, alternatives, 1.5, 0.5, &alt);
+            if (k <= 1) printf("No alternative route within 50%% of the fastest\n");
+            for (int r=1;r<k;r++){ printf("Alternative %d: %.1f seconds (+%.0f%%): ", r, alt.times[r], 100.0*(alt.times[r]/t - 1.0)); print_rt_route(rg, alt.nodes + alt.offsets[r], alt.offsets[r+1] - alt.offsets[r]); }
+            rt_routes_free(&alt);
         }
+    }
+    free(path); return 0;
+}
+
+/* ---- the engine's own searches behind run_query: --crp, --landmarks, --queue dial, --labels ----
+   a Graph loaded from the same files; nodes cross over by external id */
+typedef struct { RtGraph *rg; Graph *g; HubLabels *hl; Crp *crp; Alt *alt; IntGraph *ig; int queue; } EngineSearch;
+static int engine_node(EngineSearch *e, int v){ return v < 0 ? -1 : llmap_find(e->g->idmap, rt_ext_id(e->rg, v)); }
+
+static double engine_route(void *ctx, int src, int dst, int *path, int *len){
+    EngineSearch *e = ctx; Graph *g = e->g; int s = engine_node(e, src), t = engine_node(e, dst), plen = 0;
+    int *gp = malloc(sizeof(int) * (g->V + 1)); double d = INF;
+    if (s < 0 || t < 0){}
+    else if (e->crp){
+        SearchWork *w = search_work_create(g->V), *uw = search_work_create(g->V);
+        d = crp_query(e->crp, g, s, t, w, uw, gp, &plen);
+        search_work_free(w); search_work_free(uw);
+    } else if (e->alt){
+        AltWork *w = alt_work_create(g->V); d = alt_query(e->alt, g, w, s, t, gp, &plen); alt_work_free(w);
     } else {
-        
-        int f = find_node_by_name(g, dstq);
-        if (f == -1){ printf("Destination '%s' not found\n", dstq); graph_free(g); return 1; }
-        dst_idx = f;
-        
-        if (!type_is_allowed(g->type[dst_idx]) && !node_matches_type_or_name(g, dst_idx, "hospital") && !node_matches_type_or_name(g, dst_idx, "fire") && !node_matches_type_or_name(g, dst_idx, "police")){
-            printf("Destination '%s' is not a hospital/fire/police type (its type: '%s')\n", g->name[dst_idx]?g->name[dst_idx]:"N/A", g->type[dst_idx]?g->type[dst_idx]:"N/A");
-            graph_free(g); return 1;
+        double *dist = malloc(sizeof(double) * g->V); int *parent = malloc(sizeof(int) * g->V);
+        shortest_all(g, e->ig, e->queue, s, dist, parent);
+        if ((d = dist[t]) < INF/2){
+            for (int x = t; x != -1; x = parent[x]) gp[plen++] = x;
+            for (int i=0, j=plen-1; i<j; i++, j--){ int x = gp[i]; gp[i] = gp[j]; gp[j] = x; }
         }
+        free(dist); free(parent);
     }
+    *len = 0;
+    if (d < INF/2) for (int i=0;i<plen;i++) path[(*len)++] = rt_find_ext(e->rg, g->ext_id[gp[i]]);
+    free(gp);
+    return d < INF/2 ? d : RT_UNREACHABLE;
+}
+static int engine_nearest(void *ctx, int start, const char *type){
+    EngineSearch *e = ctx; int s = engine_node(e, start);
+    int f = s < 0 ? -1 : nearest_of_type(e->g, e->hl, s, type);
+    return f < 0 ? -1 : rt_find_ext(e->rg, e->g->ext_id[f]);
+}
 
-    
-    if (src_idx == -1 && src_is_any){
-        int chosen = find_nearest_of_type_from(g, dst_idx, src_req_type);
-        if (chosen == -1){ printf("No facility of type '%s' found\n", src_req_type); graph_free(g); return 1; }
-        src_idx = chosen;
-        printf("Selected nearest %s as source: %s\n", src_req_type, g->name[src_idx] ? g->name[src_idx] : "(unnamed)");
+static int run_engine_query(RtGraph *rg, const char *nodes_file, const char *edges_file, int reorder, int use_crp, int landmarks, int landmark_select, int landmark_bits, int queue, const char *labels_path, int alternatives, int threads){
+    Graph *g = graph_create(4096);
+    if (load_nodes(g, nodes_file) < 0 || load_edges(g, edges_file) < 0){ graph_free(g); return 1; }
+    graph_reorder(g, reorder);
+    MemReport mr = {0}; graph_memory(g, &mr);
+    if (mem_over_budget(&mr, nodes_file, stderr)){ graph_free(g); return 1; }
+    EngineSearch e = { rg, g, NULL, NULL, NULL, NULL, queue };
+    /* nearest-facility picks come from the label file, built on first use */
+    if (labels_path && !(e.hl = hl_open(labels_path, g))){
+        double t0 = now_sec(); e.hl = hl_build(g, threads);
+        long long entries; size_t bytes; hl_stats(e.hl, &entries, &bytes);
+        printf("Built hub labels in %.2f s: %.1f bytes per node, saved to %s\n", now_sec() - t0, g->V ? (double)bytes / g->V : 0.0, labels_path);
+        if (hl_save(e.hl, labels_path) != 0){ hl_free(e.hl); e.hl = NULL; }
     }
+    if (use_crp){ e.crp = crp_build(g, 3, crp_default_cells); crp_customize(e.crp, g, threads); }
+    else if (landmarks > 0) e.alt = alt_build(g, landmarks, landmark_select, landmark_bits, threads);
+    else if (queue == QUEUE_DIAL && !(e.ig = intgraph_build(g))) printf("(travel times are not whole seconds; using the binary heap)\n");
+    QuerySearch qs = { &e, engine_route, engine_nearest };
+    int rc = run_query(rg, -1, alternatives, &qs);
+    hl_free(e.hl); if (e.crp) crp_free(e.crp); if (e.alt) alt_free(e.alt); intgraph_free(e.ig); graph_free(g);
+    return rc;
+}
 
-    
-    if (src_idx < 0 || dst_idx < 0){ printf("Could not resolve src/dst\n"); graph_free(g); return 1; }
+int main(int argc, char **argv){
+   const char *nodes_file = NULL, *edges_file = NULL;
+   const char *iso_out = NULL, *iso_minutes = "8,12,20", *serve_path = NULL, *labels_path = NULL, *shard_dir = NULL, *shard_sock = NULL;
+   int grid_r = 0, grid_c = 0, use_crp = 0, do_bench_crp = 0, do_bench_snap = 0, do_bench_cache = 0, do_bench_alt = 0, do_bench_matrix = 0, do_bench_bound = 0, do_bench_reorder = 0, reorder = REORDER_HILBERT, do_bench_dial = 0, do_bench_metrics = 0, order = -1, do_bench_delta = 0, do_bench_hl = 0, do_bench_landmarks = 0, landmarks = 0, landmark_select = ALT_AVOID, landmark_bits = 16, show_memory = 0, queue = QUEUE_HEAP, alternatives = 0, shard_split = 0, bench_shards_k = 0, threads = default_threads();
+   for (int i=1;i<argc;i++){
+    if (strcmp(argv[i], "--crp")==0) use_crp = 1;
+    else if (strcmp(argv[i], "--bench-crp")==0) do_bench_crp = 1;
+    else if (strcmp(argv[i], "--bench-snap")==0) do_bench_snap = 1;
+    else if (strcmp(argv[i], "--bench-cache")==0) do_bench_cache = 1;
+    else if (strcmp(argv[i], "--bench-alt")==0) do_bench_alt = 1;
+    else if (strcmp(argv[i], "--bench-matrix")==0) do_bench_matrix = 1;
+    else if (strcmp(argv[i], "--bench-bound")==0) do_bench_bound = 1;
+    else if (strcmp(argv[i], "--bench-reorder")==0) do_bench_reorder = 1;
+    else if (strcmp(argv[i], "--reorder")==0 && i+1<argc){ reorder = reorder_mode(argv[++i]); if (reorder < 0){ printf("--reorder takes none, hilbert, bfs or rcm\n"); return 1; } }
+    else if (strcmp(argv[i], "--bench-dial")==0) do_bench_dial = 1;
+    else if (strcmp(argv[i], "--bench-metrics")==0) do_bench_metrics = 1;
+    else if (strcmp(argv[i], "--order")==0 && i+1<argc){ order = route_order(argv[++i]); if (order < 0){ printf("--order takes time, length, time,length or length,time\n"); return 1; } }
+    else if (strcmp(argv[i], "--queue")==0 && i+1<argc){ queue = queue_mode(argv[++i]); if (queue < 0){ printf("--queue takes heap or dial\n"); return 1; } }
+    else if (strcmp(argv[i], "--bench-delta")==0) do_bench_delta = 1;
+    else if (strcmp(argv[i], "--bench-hl")==0) do_bench_hl = 1;
+    else if (strcmp(argv[i], "--bench-landmarks")==0) do_bench_landmarks = 1;
+    else if (strcmp(argv[i], "--landmarks")==0 && i+1<argc) landmarks = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--landmark-select")==0 && i+1<argc){ landmark_select = alt_select_mode(argv[++i]); if (landmark_select < 0){ printf("--landmark-select takes avoid or farthest\n"); return 1; } }
+    else if (strcmp(argv[i], "--landmark-bits")==0 && i+1<argc){ landmark_bits = atoi(argv[++i]); if (landmark_bits != 16 && landmark_bits != 32){ printf("--landmark-bits takes 16 or 32\n"); return 1; } }
+    else if (strcmp(argv[i], "--labels")==0 && i+1<argc) labels_path = argv[++i];
+    else if (strcmp(argv[i], "--alternatives")==0 && i+1<argc) alternatives = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--isochrone")==0 && i+1<argc) iso_out = argv[++i];
+    else if (strcmp(argv[i], "--minutes")==0 && i+1<argc) iso_minutes = argv[++i];
+    else if (strcmp(argv[i], "--serve")==0 && i+1<argc) serve_path = argv[++i];
+    else if (strcmp(argv[i], "--shard-split")==0 && i+2<argc){ shard_split = atoi(argv[++i]); shard_dir = argv[++i]; if (shard_split < 1){ printf("--shard-split takes a shard count of at least 1\n"); return 1; } }
+    else if (strcmp(argv[i], "--shard-serve")==0 && i+2<argc){ shard_dir = argv[i+1]; shard_sock = argv[i+2]; i += 2; }
+    else if (strcmp(argv[i], "--shard-worker")==0 && i+3<argc) return shard_worker(argv[i+1], atoi(argv[i+2]), atoi(argv[i+3]));
+    else if (strcmp(argv[i], "--bench-shards")==0 && i+1<argc){ bench_shards_k = atoi(argv[++i]); if (bench_shards_k < 1){ printf("--bench-shards takes a shard count of at least 1\n"); return 1; } }
+    else if (strcmp(argv[i], "--memory")==0) show_memory = 1;
+    else if (strcmp(argv[i], "--memory-budget")==0 && i+1<argc) mem_set_budget((size_t)(atof(argv[++i]) * 1048576.0));
+    else if (strcmp(argv[i], "--threads")==0 && i+1<argc) threads = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--grid")==0 && i+1<argc) sscanf(argv[++i], "%dx%d", &grid_r, &grid_c);
+    else if (!nodes_file) nodes_file = argv[i];
+    else if (!edges_file) edges_file = argv[i];
+   }
+   if (shard_sock) return run_shard_server(shard_dir, shard_sock);
+   if ((!nodes_file || !edges_file) && (grid_r <= 0 || grid_c <= 0)){ 
+    printf("Usage: %s nodes.csv edges.csv [--crp] [--alternatives K] [--reorder hilbert|bfs|rcm|none] [--queue heap|dial] [--threads N] [--memory-budget MB] [--labels FILE] [--order time|length|time,length|length,time]\n", argv[0]); 
+    printf("       %s nodes.csv edges.csv --landmarks K [--landmark-select avoid|farthest] [--landmark-bits 16|32]\n", argv[0]); 
+    printf("       %s nodes.csv edges.csv --memory\n", argv[0]); 
+    printf("       %s nodes.csv edges.csv --isochrone out.csv|out.bin [--minutes 8,12,20]\n", argv[0]); 
+    printf("       %s nodes.csv edges.csv --serve /path/to.sock [--threads N]\n", argv[0]); 
+    printf("       %s nodes.csv edges.csv --shard-split K DIR      then      %s --shard-serve DIR /path/to.sock\n", argv[0], argv[0]); 
+    printf("       %s --grid ROWSxCOLS --bench-crp|--bench-snap|--bench-cache|--bench-alt|--bench-matrix|--bench-bound|--bench-reorder|--bench-dial|--bench-metrics|--bench-delta|--bench-hl|--bench-landmarks|--bench-shards K [--threads N]\n", argv[0]); 
+    return 1; 
+}
+/* queries and the daemon run on routing.h; the engine's own search options (--crp, --landmarks,
+   --queue dial, --labels), the benchmarks and the offline tools build a Graph of their own */
+int engine_query = use_crp || landmarks > 0 || queue == QUEUE_DIAL || labels_path;
+int tool = do_bench_crp || do_bench_snap || do_bench_cache || do_bench_alt || do_bench_matrix || do_bench_bound || do_bench_reorder || do_bench_dial || do_bench_metrics || do_bench_delta || do_bench_hl || do_bench_landmarks || bench_shards_k || shard_split || iso_out || show_memory;
+if (order >= 0 && engine_query){ printf("--order ranks routes with the default search; it does not combine with --crp, --landmarks, --queue dial or --labels\n"); return 1; }
+if (serve_path || !tool){
+    if (!nodes_file || !edges_file){ printf("Queries and --serve need nodes.csv and edges.csv\n"); return 1; }
+    RtGraph *rg = rt_load(nodes_file, edges_file);
+    if (!rg) return 1;
+    int rc = serve_path ? run_server(rg, serve_path, threads)
+           : engine_query ? run_engine_query(rg, nodes_file, edges_file, reorder, use_crp, landmarks, landmark_select, landmark_bits, queue, labels_path, alternatives, threads)
+           : run_query(rg, order, alternatives, NULL);
+    rt_free(rg); return rc;
+}
 
-    
-    double *dist = malloc(sizeof(double) * g->V);
-    int *parent = malloc(sizeof(int) * g->V);
-    if (!dist || !parent){ perror("malloc"); graph_free(g); return 1; }
-    dijkstra(g, src_idx, dist, parent);
+Graph *g = graph_create(4096);
 
-    if (dist[dst_idx] >= INF/2){
-        printf("No path found from '%s' to '%s'\n", g->name[src_idx]?g->name[src_idx]:"src", g->name[dst_idx]?g->name[dst_idx]:"dst");
-    } else {
-        printf("\nShortest travel time = %.1f seconds (%.2f minutes)\n", dist[dst_idx], dist[dst_idx]/60.0);
-        printf("Route: "); print_path(g, parent, dst_idx); printf("\n");
-    }
+if (nodes_file && edges_file){
+int n_nodes = load_nodes(g, nodes_file); 
+if (n_nodes < 0) return 1;
 
-    free(dist); free(parent); graph_free(g); return 0;
+int n_edges = load_edges(g, edges_file); 
+if (n_edges < 0) return 1;
+}
+if (grid_r > 0 && grid_c > 0) graph_build_grid(g, grid_r, grid_c, 2025);
+if (do_bench_reorder){ bench_reorder(g, 200); graph_free(g); return 0; }
+graph_reorder(g, reorder);
+
+if (do_bench_crp){ bench_crp(g, threads, 200); graph_free(g); return 0; }
+if (do_bench_snap){ bench_snap(g, 100000); graph_free(g); return 0; }
+if (do_bench_cache){ bench_cache(g, threads, 4000, 8u << 20); graph_free(g); return 0; }
+if (do_bench_alt){ bench_alt(g, 200, 3); graph_free(g); return 0; }
+if (do_bench_delta){ bench_delta(g, 20, threads); graph_free(g); return 0; }
+if (do_bench_hl){ bench_hl(g, 1000000, threads); graph_free(g); return 0; }
+if (do_bench_landmarks){ bench_landmarks(g, 200, threads); graph_free(g); return 0; }
+if (do_bench_dial){ bench_dial(g, 100); graph_free(g); return 0; }
+if (do_bench_metrics){ bench_metrics(g, 100); graph_free(g); return 0; }
+if (do_bench_bound){ bench_bound(g, 100, 50); graph_free(g); return 0; }
+if (do_bench_matrix){ bench_matrix(g, 200, 20, threads); graph_free(g); return 0; }
+if (bench_shards_k){ bench_shards(g, bench_shards_k, 1000); graph_free(g); return 0; }
+if (shard_split){
+    int *region = malloc(sizeof(int)*(g->V>0?g->V:1)); shard_partition(g, shard_split, region);
+    int rc = shard_write(g, region, shard_split, shard_dir);
+    if (rc == 0) printf("Wrote %d shards of %d nodes to %s\n", shard_split, g->V, shard_dir);
+    free(region); graph_free(g); return rc ? 1 : 0;
 }
+if (iso_out){ int rc = run_isochrones(g, iso_out, iso_minutes, threads); graph_free(g); return rc; }
+
+/* the only tool left here is --memory */
+GeoIndex *geo = geo_build(g);
+MemReport mr = {0}; memory_report(g, geo, &mr);
+mem_print(&mr, stdout); printf("%.1f bytes reserved per node\n", g->V ? (double)mem_total(&mr, NULL) / g->V : 0.0);
+geo_free(geo); graph_free(g); return 0;
+}
+
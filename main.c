@@ -2,404 +2,1370 @@
    Emergency Dispatch - single file
    - Accepts your original dataset formats (nodes.csv and edges.csv)
    - Fuzzy location matching (substring, case-insensitive)
+   - GPS fixes ("lat,lon") snapped to the nearest road node
+   - Routing (travel time, cached) comes from the shared core in routing.c
+   - Pending calls survive a crash: calls.snap + calls.wal are replayed at startup
+   - Units move: GPS pings put them on the road, and calls are routed from where they are
    - Clean console output
    Compile:
-     gcc -std=c11 main.c -o dispatch_app
+     gcc -std=c11 main.c routing.c -o dispatch_app -pthread -lm
+   Run:
+     ./dispatch_app                interactive
+     ./dispatch_app --bench-wal    cost of logging insert_call() and of recovery
+     ./dispatch_app --bench-reopt  greedy vs re-optimized dispatch over a simulated shift
+     ./dispatch_app --bench-positions [THREADS]   GPS ping rate and nearest-unit query latency
+     ./dispatch_app --load-test [options]   replayed call stream, latency against the 1 s SLO
+         --rate N (calls/s, 50)  --burst B (mean calls per burst, 1 = Poisson)
+         --hotspots H --hotspot-share P (0.5)  --gps P (share given as lat,lon, 0.3)
+         --duration S (5)  --fleet N (copies of each unit, 40)  --scale X (simulated s per s, 1000)
+         --seed N  --no-log  --sweep (double the rate until the SLO breaks)
+         --max-dropped N (calls that may go undispatched before the run fails, 0)
+     ./dispatch_app --memory       bytes used / reserved per structure
+     ./dispatch_app --memory-budget MB   refuse to run past MB megabytes
 */
 
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "routing.h"
 
 #ifdef _WIN32
 #include <direct.h>
 #define getcwd _getcwd
 #endif
 
-#define MAX_NODES 2000
-#define INF 1e9
 #define HEAP_MAX 1000
+#define WAL_COMMIT_MS 2            /* group commit interval */
+#define WAL_SNAPSHOT_EVERY 8192    /* records between heap snapshots */
+#define REOPT_BUDGET_US 2000       /* wall-clock cap on one re-optimization */
+#define REOPT_MIN_GAIN 60.0        /* severity-weighted seconds a reassignment must save */
+#define REOPT_UNSERVED 3600.0      /* seconds charged for a call without a unit */
+#define UNITS_MAX 4096
+#define UNIT_TYPES_MAX 16
+#define GRID_CELL_KM 0.5           /* unit position grid cell */
+#define GRID_BUCKETS 1024          /* power of two; distant cells may share a bucket */
+#define NEAREST_UNITS 16           /* free units routed per call, nearest in a straight line first */
+#define SLO_US 1000000.0           /* call intake to unit on its way */
 
-/* ---------------- Graph structures ---------------- */
-typedef struct Edge {
-    int dest;
-    double weight;
-    struct Edge *next;
-} Edge;
-
-typedef struct Node {
-    int id;            /* internal index */
-    long ext_id;       /* external id (from your CSV) */
-    char name[128];
-    char type[64];
-    double lat, lon;
-    Edge *adj;
-} Node;
-
-typedef struct Graph {
-    int V;
-    Node nodes[MAX_NODES];
-} Graph;
-
-/* ---------------- mapping ext_id -> internal index ---------------- */
-typedef struct { long ext_id; int idx; } ExtMapEntry;
-typedef struct { ExtMapEntry *entries; int count; int capacity; } ExtMap;
-
-static void extmap_init(ExtMap *m) { m->entries = NULL; m->count = 0; m->capacity = 0; }
-static void extmap_free(ExtMap *m) { free(m->entries); m->entries = NULL; m->count = m->capacity = 0; }
-static void extmap_add(ExtMap *m, long ext_id, int idx) {
-    if (m->count == m->capacity) {
-        int newcap = (m->capacity == 0) ? 64 : m->capacity * 2;
-        m->entries = realloc(m->entries, sizeof(ExtMapEntry) * newcap);
-        m->capacity = newcap;
-    }
-    m->entries[m->count].ext_id = ext_id;
-    m->entries[m->count].idx = idx;
-    m->count++;
-}
-static int extmap_get(ExtMap *m, long ext_id) {
-    for (int i = 0; i < m->count; ++i) if (m->entries[i].ext_id == ext_id) return m->entries[i].idx;
+/* ---------------- Graph helpers ---------------- */
+static const char *node_label(const RtGraph *rg, int idx) {
+    const char *nm = rt_name(rg, idx);
+    return nm ? nm : "(junction)";
+}
+
+void print_path(const RtGraph *rg, const int *path, int len) {
+    for (int i = 0; i < len; ++i) printf(" -> %s", node_label(rg, path[i]));
+}
+
+/* call location: GPS fix snapped through the spatial index, otherwise an id or fuzzy name */
+int resolve_location(const RtGraph *rg, const char *loc) {
+    double snap_km;
+    int idx = rt_resolve(rg, loc, &snap_km);
+    if (idx != -1 && snap_km >= 0) printf("Snapped %s to %s (%.0f m)\n", loc, node_label(rg, idx), snap_km * 1000.0);
+    return idx;
+}
+
+/* ---------------- Priority queue (calls) ---------------- */
+struct Call { int id; char loc[200]; int sev; int time; };
+static struct Call heapQ[HEAP_MAX];
+static int heap_size = 0;
+static int compare_calls(const struct Call *a, const struct Call *b) {
+    if (a->sev != b->sev) return a->sev > b->sev;
+    return a->time < b->time;
+}
+static void swap_calls(struct Call *a, struct Call *b) { struct Call t = *a; *a = *b; *b = t; }
+
+static void sift_up(int i) {
+    while (i > 1 && compare_calls(&heapQ[i], &heapQ[i/2])) { swap_calls(&heapQ[i], &heapQ[i/2]); i /= 2; }
+}
+static void sift_down(int i) {
+    while (1) {
+        int largest = i, l = 2*i, r = 2*i+1;
+        if (l <= heap_size && compare_calls(&heapQ[l], &heapQ[largest])) largest = l;
+        if (r <= heap_size && compare_calls(&heapQ[r], &heapQ[largest])) largest = r;
+        if (largest == i) break;
+        swap_calls(&heapQ[i], &heapQ[largest]);
+        i = largest;
+    }
+}
+static int find_call(int id) {
+    for (int i = 1; i <= heap_size; ++i) if (heapQ[i].id == id) return i;
+    return 0;
+}
+static struct Call remove_at(int i) {
+    struct Call c = heapQ[i];
+    heapQ[i] = heapQ[heap_size--];
+    if (i <= heap_size) { sift_up(i); sift_down(i); }
+    return c;
+}
+
+/* the heap operations proper; replay applies the same ones, so a recovered heap has the same
+   layout the crashed one had */
+static int heap_insert(const struct Call *c) {
+    if (heap_size + 1 >= HEAP_MAX) return 0;
+    heapQ[++heap_size] = *c;
+    sift_up(heap_size);
+    return 1;
+}
+static int heap_set_severity(int id, int sev) {
+    int i = find_call(id);
+    if (!i) return 0;
+    heapQ[i].sev = sev; sift_up(i); sift_down(i);
+    return 1;
+}
+
+/* ---------------- Call log (WAL) ----------------
+   every change to the queue is appended as a record {len, crc32, seq, op, payload} to an
+   in-memory buffer; a flusher thread writes and fdatasyncs whatever has gathered every
+   WAL_COMMIT_MS (group commit), so logging costs a memcpy under a mutex on the caller's side.
+   the price is that the last few milliseconds can be lost in a crash; wal_sync() waits until
+   everything logged so far is on disk. every WAL_SNAPSHOT_EVERY records the heap is copied out
+   and the flusher writes it to calls.snap (tmp file + rename), after which the log restarts
+   empty. recovery: load the snapshot, replay log records newer than it, stop at the first torn
+   or corrupt record. */
+enum { WAL_INSERT = 1, WAL_EXTRACT, WAL_CANCEL, WAL_SEVERITY };
+typedef struct { uint32_t len, crc; uint64_t seq; int32_t op, id, sev; } WalHead;   /* len counts the payload after it */
+typedef struct { uint32_t crc; uint64_t seq; int32_t count; } SnapHead;
+
+/* --memory-budget at run time: main() counts everything reserved at startup into mem_base, and
+   what grows later (the call log buffer, incident ETA columns) asks mem_grow() first */
+static size_t mem_budget_bytes, mem_base;
+static atomic_size_t mem_grown;
+static int mem_grow(size_t bytes, const char *what) {
+    size_t now = atomic_fetch_add(&mem_grown, bytes) + bytes;
+    if (!mem_budget_bytes || mem_base + now <= mem_budget_bytes) return 1;
+    atomic_fetch_sub(&mem_grown, bytes);
+    fprintf(stderr, "%s: %zu more bytes would go past the memory budget of %zu (%zu reserved)\n", what, bytes, mem_budget_bytes, mem_base + now - bytes);
+    return 0;
+}
+static void mem_shrink(size_t bytes) { atomic_fetch_sub(&mem_grown, bytes); }
+
+static struct {
+    int fd; const char *log_path, *snap_path, *tmp_path;
+    pthread_mutex_t mu; pthread_cond_t wake, synced;
+    pthread_t flusher; int running, stop;
+    char *buf, *spare; size_t len, cap, spare_cap;
+    uint64_t seq, durable;            /* last record logged / last one on disk */
+    long since_snap;
+    struct Call *snap; int snap_count; uint64_t snap_seq; size_t snap_cut; int snap_ready;
+} wal = { .fd = -1 };
+
+static uint32_t crc32_tab[256];
+static uint32_t crc32_of(uint32_t crc, const void *p, size_t n) {
+    const unsigned char *b = p;
+    if (!crc32_tab[1]) for (uint32_t i = 0; i < 256; ++i) { uint32_t c = i; for (int k = 0; k < 8; ++k) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1; crc32_tab[i] = c; }
+    crc = ~crc;
+    while (n--) crc = crc32_tab[(crc ^ *b++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+static uint32_t wal_crc(const WalHead *h, const void *payload) {
+    uint32_t c = crc32_of(0, &h->seq, sizeof(*h) - offsetof(WalHead, seq));
+    return crc32_of(c, payload, h->len);
+}
+
+static int write_all(int fd, const void *p, size_t n) {
+    const char *c = p;
+    while (n) { ssize_t w = write(fd, c, n); if (w < 0) { if (errno == EINTR) continue; return -1; } c += w; n -= (size_t)w; }
+    return 0;
+}
+
+static void wal_write_snapshot(const struct Call *calls, int count, uint64_t seq) {
+    SnapHead h = { 0, seq, count };
+    h.crc = crc32_of(crc32_of(0, &h.seq, sizeof(h) - offsetof(SnapHead, seq)), calls, sizeof(struct Call) * count);
+    int fd = open(wal.tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) { perror(wal.tmp_path); return; }
+    int bad = write_all(fd, &h, sizeof(h)) || write_all(fd, calls, sizeof(struct Call) * count) || fsync(fd);
+    close(fd);
+    if (bad || rename(wal.tmp_path, wal.snap_path) != 0) { perror(wal.snap_path); return; }
+    int dir = open(".", O_RDONLY);
+    if (dir >= 0) { fsync(dir); close(dir); }
+    /* the snapshot covers every record so far; start the log over */
+    if (ftruncate(wal.fd, 0) == 0) lseek(wal.fd, 0, SEEK_SET);
+}
+
+static void *wal_flusher(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&wal.mu);
+    while (1) {
+        while (!wal.len && !wal.snap_ready && !wal.stop) pthread_cond_wait(&wal.wake, &wal.mu);
+        if (!wal.len && !wal.snap_ready && wal.stop) break;
+        /* let a group gather */
+        int stopping = wal.stop;
+        pthread_mutex_unlock(&wal.mu);
+        struct timespec gap = { 0, WAL_COMMIT_MS * 1000000L };
+        if (!stopping) nanosleep(&gap, NULL);
+        pthread_mutex_lock(&wal.mu);
+        char *out = wal.buf; size_t n = wal.len, cut = wal.snap_ready ? wal.snap_cut : 0;
+        uint64_t upto = wal.seq;
+        int snap = wal.snap_ready; struct Call *calls = wal.snap; int count = wal.snap_count; uint64_t snap_seq = wal.snap_seq;
+        wal.buf = wal.spare; wal.spare = out; size_t c = wal.cap; wal.cap = wal.spare_cap; wal.spare_cap = c;
+        wal.len = 0; wal.snap_ready = 0; wal.snap = NULL;
+        pthread_mutex_unlock(&wal.mu);
+
+        if (snap) {
+            /* records up to the snapshot go to the old log first, so a crash mid-snapshot loses nothing */
+            if (write_all(wal.fd, out, cut) == 0) fdatasync(wal.fd);
+            wal_write_snapshot(calls, count, snap_seq);
+            free(calls);
+            out += cut; n -= cut;
+        }
+        if (n && write_all(wal.fd, out, n) != 0) perror(wal.log_path);
+        fdatasync(wal.fd);
+
+        pthread_mutex_lock(&wal.mu);
+        wal.durable = upto;
+        pthread_cond_broadcast(&wal.synced);
+    }
+    pthread_mutex_unlock(&wal.mu);
+    return NULL;
+}
+
+/* 0, with the reason on stderr, when the buffer cannot grow (memory budget or allocator) */
+static int wal_log(int op, const struct Call *c, int id, int sev) {
+    if (!wal.running) return 1;
+    WalHead h = { c ? (uint32_t)sizeof(*c) : 0, 0, 0, op, id, sev };
+    pthread_mutex_lock(&wal.mu);
+    size_t need = wal.len + sizeof(h) + h.len;
+    if (need > wal.cap) {
+        size_t cap = wal.cap; char *grown = NULL;
+        while (need > cap) cap = cap ? cap * 2 : 1 << 16;
+        if (mem_grow(cap - wal.cap, "call log") && !(grown = realloc(wal.buf, cap))) mem_shrink(cap - wal.cap);
+        if (!grown) {
+            pthread_mutex_unlock(&wal.mu);
+            fprintf(stderr, "call log: no room to record call %d\n", id);
+            return 0;
+        }
+        wal.buf = grown; wal.cap = cap;
+    }
+    h.seq = ++wal.seq;
+    h.crc = wal_crc(&h, c);
+    memcpy(wal.buf + wal.len, &h, sizeof(h));
+    if (c) memcpy(wal.buf + wal.len + sizeof(h), c, sizeof(*c));
+    wal.len = need;
+    if (++wal.since_snap >= WAL_SNAPSHOT_EVERY && !wal.snap_ready) {
+        /* heap copy taken here, where the heap is consistent with the log */
+        wal.snap = malloc(sizeof(struct Call) * (heap_size + 1));
+        memcpy(wal.snap, heapQ + 1, sizeof(struct Call) * heap_size);
+        wal.snap_count = heap_size; wal.snap_seq = wal.seq; wal.snap_cut = wal.len; wal.snap_ready = 1;
+        wal.since_snap = 0;
+    }
+    if (need == sizeof(h) + h.len || wal.snap_ready) pthread_cond_signal(&wal.wake);
+    pthread_mutex_unlock(&wal.mu);
+    return 1;
+}
+
+/* blocks until every record logged so far is on disk */
+void wal_sync(void) {
+    if (!wal.running) return;
+    pthread_mutex_lock(&wal.mu);
+    uint64_t want = wal.seq;
+    pthread_cond_signal(&wal.wake);
+    while (wal.durable < want) pthread_cond_wait(&wal.synced, &wal.mu);
+    pthread_mutex_unlock(&wal.mu);
+}
+
+static void wal_apply(const WalHead *h, const struct Call *c) {
+    int i;
+    switch (h->op) {
+    case WAL_INSERT: heap_insert(c); break;
+    case WAL_EXTRACT: case WAL_CANCEL: if ((i = find_call(h->id))) remove_at(i); break;
+    case WAL_SEVERITY: heap_set_severity(h->id, h->sev); break;
+    }
+}
+
+/* rebuilds the queue from snapshot + log tail and starts logging; returns the calls recovered, or
+   -1 (with the reason on stderr) when the snapshot is damaged and the log no longer reaches back
+   to the first call: its pending calls would be lost without a word */
+int wal_open(const char *base) {
+    static char paths[3][256];
+    snprintf(paths[0], sizeof(paths[0]), "%s.wal", base);
+    snprintf(paths[1], sizeof(paths[1]), "%s.snap", base);
+    snprintf(paths[2], sizeof(paths[2]), "%s.snap.tmp", base);
+    wal.log_path = paths[0]; wal.snap_path = paths[1]; wal.tmp_path = paths[2];
+
+    FILE *f = fopen(wal.snap_path, "rb"); int snap_bad = 0;
+    if (f) {
+        SnapHead h; snap_bad = 1;
+        if (fread(&h, sizeof(h), 1, f) == 1 && h.count >= 0 && h.count < HEAP_MAX) {
+            struct Call *calls = malloc(sizeof(struct Call) * (h.count + 1));
+            if (fread(calls, sizeof(struct Call), h.count, f) == (size_t)h.count &&
+                crc32_of(crc32_of(0, &h.seq, sizeof(h) - offsetof(SnapHead, seq)), calls, sizeof(struct Call) * h.count) == h.crc) {
+                memcpy(heapQ + 1, calls, sizeof(struct Call) * h.count);
+                heap_size = h.count; wal.seq = h.seq; snap_bad = 0;
+            }
+            free(calls);
+        }
+        fclose(f);
+    }
+    wal.fd = open(wal.log_path, O_RDWR | O_CREAT, 0644);
+    if (wal.fd < 0) { perror(wal.log_path); return heap_size; }
+    off_t good = 0; WalHead h; struct Call c; uint64_t first = 0;
+    while (pread(wal.fd, &h, sizeof(h), good) == (ssize_t)sizeof(h)) {
+        if (h.len != 0 && h.len != sizeof(c)) break;
+        if (h.len && pread(wal.fd, &c, sizeof(c), good + (off_t)sizeof(h)) != (ssize_t)sizeof(c)) break;
+        if (wal_crc(&h, &c) != h.crc) break;
+        if (!first) first = h.seq;
+        if (h.seq > wal.seq) { wal_apply(&h, &c); wal.seq = h.seq; }
+        good += (off_t)(sizeof(h) + h.len);
+    }
+    if (snap_bad && first != 1) {
+        fprintf(stderr, "%s is damaged and %s starts at record %llu, so its pending calls are lost.\n"
+                "Refusing to start; move both files aside to start with an empty queue.\n",
+                wal.snap_path, wal.log_path, (unsigned long long)first);
+        close(wal.fd); wal.fd = -1; heap_size = 0;
+        return -1;
+    }
+    if (snap_bad) fprintf(stderr, "%s is damaged; recovered from the whole of %s instead.\n", wal.snap_path, wal.log_path);
+    /* drop a torn tail so new records follow the last good one */
+    if (ftruncate(wal.fd, good) != 0) perror(wal.log_path);
+    lseek(wal.fd, good, SEEK_SET);
+    wal.durable = wal.seq;
+    pthread_mutex_init(&wal.mu, NULL); pthread_cond_init(&wal.wake, NULL); pthread_cond_init(&wal.synced, NULL);
+    wal.running = pthread_create(&wal.flusher, NULL, wal_flusher, NULL) == 0;
+    return heap_size;
+}
+void wal_close(void) {
+    if (!wal.running) return;
+    pthread_mutex_lock(&wal.mu); wal.stop = 1; pthread_cond_signal(&wal.wake); pthread_mutex_unlock(&wal.mu);
+    pthread_join(wal.flusher, NULL);
+    wal.running = 0;
+    close(wal.fd); free(wal.buf); free(wal.spare); free(wal.snap); mem_shrink(wal.cap + wal.spare_cap);
+    pthread_mutex_destroy(&wal.mu); pthread_cond_destroy(&wal.wake); pthread_cond_destroy(&wal.synced);
+    memset(&wal, 0, sizeof(wal)); wal.fd = -1;
+}
+
+/* ---------------- Queue API (logged) ---------------- */
+/* 0 when the call was not taken: queue full, or it could not be logged (then it is not queued) */
+int insert_call(struct Call c) {
+    if (!heap_insert(&c)) return 0;
+    if (wal_log(WAL_INSERT, &c, c.id, c.sev)) return 1;
+    remove_at(find_call(c.id));
+    return 0;
+}
+struct Call extract_call(void) {
+    struct Call nullC = {0, "", 0, 0};
+    if (heap_size == 0) return nullC;
+    struct Call root = remove_at(1);
+    wal_log(WAL_EXTRACT, NULL, root.id, 0);
+    return root;
+}
+int cancel_call(int id) {
+    int i = find_call(id);
+    if (!i) return 0;
+    remove_at(i);
+    wal_log(WAL_CANCEL, NULL, id, 0);
+    return 1;
+}
+int change_severity(int id, int sev) {
+    if (!heap_set_severity(id, sev)) return 0;
+    wal_log(WAL_SEVERITY, NULL, id, sev);
+    return 1;
+}
+int is_queue_empty(void) { return heap_size == 0; }
+
+/* ---------------- Units ---------------- */
+/* registry of live units: slot by id through an open-addressing hash, types interned to small
+   integers, and one availability bitset per type (bit i set = unit i is of that type and free).
+   units are registered up front; after that crews may flip their status from any thread, and a
+   dispatcher claims a unit with an atomic test-and-clear so no unit is sent twice. */
+typedef struct { int id; int node_idx; int type; } Unit;
+Unit units[UNITS_MAX]; int unit_count = 0;
+
+static char unit_type_name[UNIT_TYPES_MAX][32]; static int unit_type_count = 0;
+#define UNIT_WORDS ((UNITS_MAX + 63) / 64)
+static atomic_ullong unit_avail[UNIT_TYPES_MAX][UNIT_WORDS];
+#define UNIT_HASH (2 * UNITS_MAX)          /* power of two, at most half full */
+static int unit_hash[UNIT_HASH];           /* slot + 1, 0 = empty */
+static atomic_ullong unit_dirty[UNIT_WORDS];   /* moved or came free since the re-optimizer last looked */
+static atomic_int unit_incident[UNITS_MAX];    /* incident + 1 the unit is assigned to, 0 = none */
+
+int unit_type_lookup(const char *type) {
+    for (int t = 0; t < unit_type_count; ++t) if (strcasecmp(unit_type_name[t], type) == 0) return t;
     return -1;
 }
+static int unit_type_intern(const char *type) {
+    int t = unit_type_lookup(type);
+    if (t != -1 || unit_type_count >= UNIT_TYPES_MAX) return t;
+    strncpy(unit_type_name[unit_type_count], type, sizeof(unit_type_name[0]) - 1);
+    return unit_type_count++;
+}
+static unsigned unit_hash_slot(int id) { return ((unsigned)id * 2654435761u) & (UNIT_HASH - 1); }
 
-/* ---------------- Graph helpers ---------------- */
-Graph *graph_create(void) {
-    Graph *g = (Graph*)malloc(sizeof(Graph));
-    if (!g) return NULL;
-    g->V = 0;
-    for (int i = 0; i < MAX_NODES; ++i) {
-        g->nodes[i].id = i;
-        g->nodes[i].ext_id = 0;
-        g->nodes[i].name[0] = '\0';
-        g->nodes[i].type[0] = '\0';
-        g->nodes[i].lat = g->nodes[i].lon = 0.0;
-        g->nodes[i].adj = NULL;
-    }
-    return g;
-}
-
-void add_edge(Graph *g, int src, int dest, double weight) {
-    if (!g) return;
-    if (src < 0 || src >= g->V || dest < 0 || dest >= g->V) return;
-    Edge *e = (Edge*)malloc(sizeof(Edge));
-    e->dest = dest; e->weight = weight; e->next = g->nodes[src].adj; g->nodes[src].adj = e;
-}
-
-int add_node(Graph *g, long ext_id, const char *name, const char *type, double lat, double lon) {
-    if (!g) return -1;
-    if (g->V >= MAX_NODES) return -1;
-    int id = g->V++;
-    g->nodes[id].id = id;
-    g->nodes[id].ext_id = ext_id;
-    strncpy(g->nodes[id].name, name, sizeof(g->nodes[id].name)-1);
-    g->nodes[id].name[sizeof(g->nodes[id].name)-1] = '\0';
-    strncpy(g->nodes[id].type, type, sizeof(g->nodes[id].type)-1);
-    g->nodes[id].type[sizeof(g->nodes[id].type)-1] = '\0';
-    g->nodes[id].lat = lat; g->nodes[id].lon = lon;
-    g->nodes[id].adj = NULL;
-    return id;
-}
-
-/* find internal index by exact name (case-insensitive) */
-int find_node_by_name(Graph *g, const char *name) {
-    if (!g || !name) return -1;
-    for (int i = 0; i < g->V; ++i) if (strcasecmp(g->nodes[i].name, name) == 0) return i;
+int find_unit(int id) {
+    for (unsigned h = unit_hash_slot(id); unit_hash[h]; h = (h + 1) & (UNIT_HASH - 1))
+        if (units[unit_hash[h] - 1].id == id) return unit_hash[h] - 1;
     return -1;
 }
 
-/* fuzzy substring match, case-insensitive */
-int find_node_fuzzy(Graph *g, const char *input) {
-    if (!g || !input) return -1;
-    char low_input[256];
-    snprintf(low_input, sizeof(low_input), "%s", input);
-    for (int i = 0; low_input[i]; ++i) low_input[i] = tolower((unsigned char)low_input[i]);
+void add_unit(int node_idx, const char *type, int id) {
+    if (unit_count >= UNITS_MAX || find_unit(id) != -1) return;
+    int t = unit_type_intern(type);
+    if (t == -1) return;
+    int i = unit_count++;
+    units[i].node_idx = node_idx;
+    units[i].type = t;
+    units[i].id = id;
+    unsigned h = unit_hash_slot(id);
+    while (unit_hash[h]) h = (h + 1) & (UNIT_HASH - 1);
+    unit_hash[h] = i + 1;
+    atomic_fetch_or(&unit_avail[t][i / 64], 1ULL << (i % 64));
+}
 
-    for (int i = 0; i < g->V; ++i) {
-        char low_name[256];
-        snprintf(low_name, sizeof(low_name), "%s", g->nodes[i].name);
-        for (int j = 0; low_name[j]; ++j) low_name[j] = tolower((unsigned char)low_name[j]);
-        if (strstr(low_name, low_input)) return i;
+/* crew status report; returns 0 for an unknown id, and for a unit still assigned to a call
+   reporting free: only reopt_complete (or losing the call to a swap) releases that one */
+int set_unit_available(int id, int available) {
+    int i = find_unit(id);
+    if (i == -1 || (available && unit_incident[i])) return 0;
+    unsigned long long bit = 1ULL << (i % 64);
+    if (available) { atomic_fetch_or(&unit_avail[units[i].type][i / 64], bit); atomic_fetch_or(&unit_dirty[i / 64], bit); }
+    else atomic_fetch_and(&unit_avail[units[i].type][i / 64], ~bit);
+    return 1;
+}
+/* 1 when the unit was free and is now ours, 0 when someone else got it first */
+int claim_unit(int i) {
+    unsigned long long bit = 1ULL << (i % 64);
+    return (atomic_fetch_and(&unit_avail[units[i].type][i / 64], ~bit) & bit) != 0;
+}
+int unit_available(int i) { return (atomic_load(&unit_avail[units[i].type][i / 64]) >> (i % 64)) & 1; }
+
+/* next free unit of type t at slot >= from, -1 when there is none; skips whole busy words */
+int next_available_unit(int t, int from) {
+    for (int w = from / 64; w * 64 < unit_count; ++w) {
+        unsigned long long bits = atomic_load(&unit_avail[t][w]);
+        if (w == from / 64) bits &= ~0ULL << (from % 64);
+        if (bits) return w * 64 + __builtin_ctzll(bits);
     }
     return -1;
 }
 
-void print_path(Graph *g, int parent[], int j) {
-    if (!g) return;
-    if (j == -1) return;
-    print_path(g, parent, parent[j]);
-    printf(" -> %s", g->nodes[j].name);
-}
-
-/* Dijkstra (O(V^2) simple implementation) */
-void dijkstra(Graph *g, int src, double dist[], int parent[]) {
-    if (!g) return;
-    int n = g->V;
-    int visited[MAX_NODES];
-    for (int i = 0; i < n; ++i) { dist[i] = INF; parent[i] = -1; visited[i] = 0; }
-    if (src < 0 || src >= n) return;
-    dist[src] = 0.0;
-    for (int count = 0; count < n - 1; ++count) {
-        double min = INF; int u = -1;
-        for (int v = 0; v < n; ++v) if (!visited[v] && dist[v] < min) { min = dist[v]; u = v; }
-        if (u == -1) break;
-        visited[u] = 1;
-        for (Edge *e = g->nodes[u].adj; e; e = e->next) {
-            int v = e->dest;
-            if (!visited[v] && dist[u] + e->weight < dist[v]) {
-                dist[v] = dist[u] + e->weight;
-                parent[v] = u;
+/* ---------------- Unit positions ----------------
+   where each unit is on the road, fed by GPS pings. a ping is snapped to the nearest road
+   (rt_snap_road) and published through the unit's sequence lock: the writer makes seq odd, writes,
+   makes it even again, and readers retry when seq was odd or moved, so nobody ever waits on a lock
+   and pings for different units never touch the same cache line. a unit's pings are expected from
+   one feed at a time; a second concurrent writer spins until the first is done.
+   for candidate search units also sit in a uniform grid of GRID_CELL_KM cells (flat-earth km
+   around the network), hashed into GRID_BUCKETS bitsets of unit slots. a unit changing cells gets
+   its bit in the new bucket before losing it in the old one, so it is never invisible; readers
+   skip a bit whose unit is now recorded in another bucket. before its first ping a unit stands
+   at its station. */
+typedef struct { double lat, lon; int a, b; double ta, tb; } UnitPos;   /* reaches node a in ta s (turning back) or b in tb s */
+typedef struct {
+    _Alignas(64) atomic_uint seq;   /* one slot per cache line */
+    _Atomic double lat, lon, ta, tb;
+    atomic_int a, b, bucket;        /* bucket -1: no position, not in the grid */
+} UnitSlot;
+static UnitSlot unit_pos[UNITS_MAX];
+static atomic_ullong unit_grid[GRID_BUCKETS][UNIT_WORDS];
+#define KM_PER_DEG 111.19
+static double grid_kx = KM_PER_DEG;          /* km per degree of longitude, set at the network's latitude */
+
+static long grid_x(double lon) { return (long)floor(lon * grid_kx / GRID_CELL_KM); }
+static long grid_y(double lat) { return (long)floor(lat * KM_PER_DEG / GRID_CELL_KM); }
+static int grid_bucket_at(long x, long y) { return (int)(((unsigned long)x * 73856093u ^ (unsigned long)y * 19349663u) & (GRID_BUCKETS - 1)); }
+static int grid_bucket(double lat, double lon) { return grid_bucket_at(grid_x(lon), grid_y(lat)); }
+static double flat_km(double lat1, double lon1, double lat2, double lon2) {
+    double dx = (lon2 - lon1) * grid_kx, dy = (lat2 - lat1) * KM_PER_DEG;
+    return sqrt(dx * dx + dy * dy);
+}
+
+/* has_pos == 0: the unit has no coordinates and stays out of the grid */
+static void unit_publish(int i, const UnitPos *p, int has_pos) {
+    UnitSlot *u = &unit_pos[i];
+    unsigned s = atomic_load_explicit(&u->seq, memory_order_relaxed);
+    for (;;) {
+        if (!(s & 1) && atomic_compare_exchange_weak_explicit(&u->seq, &s, s + 1, memory_order_acquire, memory_order_relaxed)) break;
+        s = atomic_load_explicit(&u->seq, memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&u->lat, p->lat, memory_order_relaxed); atomic_store_explicit(&u->lon, p->lon, memory_order_relaxed);
+    atomic_store_explicit(&u->a, p->a, memory_order_relaxed); atomic_store_explicit(&u->b, p->b, memory_order_relaxed);
+    atomic_store_explicit(&u->ta, p->ta, memory_order_relaxed); atomic_store_explicit(&u->tb, p->tb, memory_order_relaxed);
+    int to = has_pos ? grid_bucket(p->lat, p->lon) : -1, from = atomic_load_explicit(&u->bucket, memory_order_relaxed);
+    if (to != from) {
+        unsigned long long bit = 1ULL << (i % 64);
+        if (to != -1) atomic_fetch_or(&unit_grid[to][i / 64], bit);
+        atomic_store(&u->bucket, to);
+        if (from != -1) atomic_fetch_and(&unit_grid[from][i / 64], ~bit);
+    }
+    atomic_store_explicit(&u->seq, s + 2, memory_order_release);
+    atomic_fetch_or(&unit_dirty[i / 64], 1ULL << (i % 64));
+}
+static void unit_read(int i, UnitPos *p) {
+    UnitSlot *u = &unit_pos[i];
+    unsigned s1, s2;
+    do {
+        s1 = atomic_load_explicit(&u->seq, memory_order_acquire);
+        p->lat = atomic_load_explicit(&u->lat, memory_order_relaxed); p->lon = atomic_load_explicit(&u->lon, memory_order_relaxed);
+        p->a = atomic_load_explicit(&u->a, memory_order_relaxed); p->b = atomic_load_explicit(&u->b, memory_order_relaxed);
+        p->ta = atomic_load_explicit(&u->ta, memory_order_relaxed); p->tb = atomic_load_explicit(&u->tb, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        s2 = atomic_load_explicit(&u->seq, memory_order_relaxed);
+    } while ((s1 & 1) || s1 != s2);
+}
+/* changes with every ping for unit slot i */
+static unsigned unit_pos_seq(int i) { return atomic_load_explicit(&unit_pos[i].seq, memory_order_acquire); }
+
+static void unit_place_at_station(const RtGraph *rg, int i) {
+    UnitPos p = { 0, 0, units[i].node_idx, units[i].node_idx, 0, 0 };
+    int has_pos = rt_coords(rg, units[i].node_idx, &p.lat, &p.lon);
+    unit_publish(i, &p, has_pos);
+}
+
+/* GPS fix for unit id, from any thread; 0 for an unknown id or a fix with no road near it */
+int unit_ping(const RtGraph *rg, int id, double lat, double lon) {
+    int i = find_unit(id); RtRoadPos r;
+    if (i == -1 || !rt_snap_road(rg, lat, lon, &r)) return 0;
+    UnitPos p = { lat, lon, r.from, r.to, r.back_seconds >= RT_UNREACHABLE ? RT_UNREACHABLE : r.frac * r.back_seconds, (1 - r.frac) * r.seconds };
+    unit_publish(i, &p, 1);
+    return 1;
+}
+
+static void nearest_offer(int *out, double *d, int *n, int k, int i, double km) {
+    if (*n == k && km >= d[k - 1]) return;
+    for (int j = 0; j < *n; ++j) if (out[j] == i) return;     /* seen through a shared bucket */
+    int j = *n < k ? (*n)++ : k - 1;
+    while (j > 0 && d[j - 1] > km) { d[j] = d[j - 1]; out[j] = out[j - 1]; --j; }
+    d[j] = km; out[j] = i;
+}
+/* up to k (at most 64) free units of type t nearest to lat,lon in a straight line, closest first:
+   writes slots to out (and km when given) and returns the count. rings of cells are searched
+   outwards until every free unit of the type turned up or the k-th best is nearer than any cell
+   not yet searched; when 32 rings are not enough every free unit of the type is looked at, those
+   without a position last. */
+int nearest_available_units(double lat, double lon, int t, int k, int *out, double *km) {
+    double d[64]; int n = 0, words = (unit_count + 63) / 64;
+    if (k > 64) k = 64;
+    if (t < 0 || t >= unit_type_count || k <= 0) return 0;
+    long cx = grid_x(lon), cy = grid_y(lat);
+    int free_units = 0, done = 0;
+    for (int w = 0; w < words; ++w) free_units += __builtin_popcountll(atomic_load_explicit(&unit_avail[t][w], memory_order_relaxed));
+    for (int r = 0; r <= 32 && !done; ++r) {
+        for (long y = cy - r; y <= cy + r; ++y) {
+            long step = r == 0 || y == cy - r || y == cy + r ? 1 : 2 * r;
+            for (long x = cx - r; x <= cx + r; x += step) {
+                int b = grid_bucket_at(x, y);
+                for (int w = 0; w < words; ++w) {
+                    unsigned long long bits = atomic_load_explicit(&unit_grid[b][w], memory_order_relaxed) & atomic_load_explicit(&unit_avail[t][w], memory_order_relaxed);
+                    while (bits) {
+                        int i = w * 64 + __builtin_ctzll(bits); bits &= bits - 1;
+                        if (atomic_load_explicit(&unit_pos[i].bucket, memory_order_relaxed) != b) continue;
+                        UnitPos p; unit_read(i, &p);
+                        nearest_offer(out, d, &n, k, i, flat_km(lat, lon, p.lat, p.lon));
+                    }
+                }
             }
         }
+        done = n == free_units || (n == k && d[k - 1] <= r * GRID_CELL_KM);
     }
+    if (!done)
+        for (int i = next_available_unit(t, 0); i != -1; i = next_available_unit(t, i + 1)) {
+            UnitPos p; unit_read(i, &p);
+            nearest_offer(out, d, &n, k, i, atomic_load(&unit_pos[i].bucket) == -1 ? RT_UNREACHABLE : flat_km(lat, lon, p.lat, p.lon));
+        }
+    if (km) for (int j = 0; j < n; ++j) km[j] = d[j];
+    return n;
 }
 
-/* ---------------- helpers: trim & BOM ---------------- */
-static void trim(char *s) {
-    if (!s) return;
-    char *p = s;
-    while (*p && isspace((unsigned char)*p)) p++;
-    if (p != s) memmove(s, p, strlen(p) + 1);
-    size_t len = strlen(s);
-    while (len > 0 && isspace((unsigned char)s[len-1])) s[--len] = '\0';
+/* the node unit u should drive to first on its way to target, with the seconds to get there */
+int unit_route_start(RtGraph *rg, int u, int target, double *lead) {
+    UnitPos p; unit_read(u, &p);
+    int v = p.a; double t = p.ta;
+    if (p.b != p.a && (p.ta >= RT_UNREACHABLE || p.tb + rt_route(rg, p.b, target, NULL, NULL) < p.ta + rt_route(rg, p.a, target, NULL, NULL))) { v = p.b; t = p.tb; }
+    if (lead) *lead = t;
+    return v;
 }
-static void strip_bom(char *s) {
-    unsigned char *u = (unsigned char *)s;
-    if (u[0]==0xEF && u[1]==0xBB && u[2]==0xBF) memmove(s, s+3, strlen(s+3)+1);
+
+/* node handles are internal (the core renumbers nodes for locality), so stations are visited,
+   and unit ids handed out, in external id order to keep ids the same from run to run */
+static const RtGraph *sort_rg;
+static int cmp_ext_id(const void *a, const void *b) {
+    long long x = rt_ext_id(sort_rg, *(const int *)a), y = rt_ext_id(sort_rg, *(const int *)b);
+    return (x > y) - (x < y);
 }
-static int safe_parse_long(const char *tok, long *out) {
-    if (!tok || !*tok) return 0;
-    char *end = NULL; long v = strtol(tok, &end, 10); if (end == tok) return 0; *out = v; return 1;
+
+void init_units_from_graph(const RtGraph *rg) {
+    unit_count = 0; unit_type_count = 0;
+    memset(unit_hash, 0, sizeof(unit_hash));
+    for (int t = 0; t < UNIT_TYPES_MAX; ++t) for (int w = 0; w < UNIT_WORDS; ++w) atomic_init(&unit_avail[t][w], 0);
+    for (int b = 0; b < GRID_BUCKETS; ++b) for (int w = 0; w < UNIT_WORDS; ++w) atomic_init(&unit_grid[b][w], 0);
+    for (int i = 0; i < UNITS_MAX; ++i) { atomic_init(&unit_pos[i].seq, 0); atomic_init(&unit_pos[i].bucket, -1); }
+    int n = rt_node_count(rg), *by_ext = malloc(sizeof(int) * (n + 1));
+    /* grid cells are square at the network's mean latitude */
+    double lat_sum = 0, lat, lon; int placed = 0;
+    for (int k = 0; k < n; ++k) if (rt_coords(rg, k, &lat, &lon)) { lat_sum += lat; ++placed; }
+    grid_kx = KM_PER_DEG * cos((placed ? lat_sum / placed : 0) * 3.14159265358979323846 / 180);
+    for (int k = 0; k < n; ++k) by_ext[k] = k;
+    sort_rg = rg; qsort(by_ext, n, sizeof(int), cmp_ext_id);
+    for (int k = 0; k < n; ++k) {
+        int i = by_ext[k];
+        if (rt_node_matches(rg, i, "hospital")) add_unit(i, "ambulance", 1000 + k);
+        if (rt_node_matches(rg, i, "fire")) add_unit(i, "fire", 2000 + k);
+        if (rt_node_matches(rg, i, "police")) add_unit(i, "police", 3000 + k);
+    }
+    free(by_ext);
+    for (int i = 0; i < unit_count; ++i) unit_place_at_station(rg, i);
 }
-static int safe_parse_double(const char *tok, double *out) {
-    if (!tok || !*tok) return 0;
-    char *end = NULL; double v = strtod(tok, &end); if (end == tok) return 0; *out = v; return 1;
+
+/* ---------------- Re-optimizer (rolling horizon) ----------------
+   open incidents keep their unit until it arrives on scene. whenever a call comes in or a unit
+   changes status, reopt_run() starts from the current assignment (warm start) and improves it by
+   local moves: give an unserved call a free unit, move a call to a closer free unit, or swap units
+   between two calls (which lets a severity-5 call take a closer unit still en route to a
+   severity-1 call). cost is sum of severity * ETA over calls whose unit has not arrived; a move is
+   only made when it saves more than REOPT_MIN_GAIN, so assignments do not flap. the ETA matrix
+   (unit x incident) is one column per incident, filled by a single rt_matrix call over the
+   NEAREST_UNITS nearest free units and the units already on calls, and refilled when road times
+   change. a unit that pings or comes free is re-timed against every open call of its type with
+   one search of its own (a row). ETAs are from where the unit is now. refills share the run's
+   budget: columns still on an older road version and units still marked dirty wait for the next
+   run, and every run refills at least one so they drain. */
+typedef struct {
+    struct Call call; int target, type, unit, locked, moved;
+    unsigned unit_seq;          /* unit's position seq at assigned_at */
+    unsigned long long eta_ver; /* road version eta was filled under */
+    double assigned_at, *eta;   /* eta[slot]: road time from that unit's position, RT_UNREACHABLE if unsuitable or not a candidate */
+} Incident;
+static Incident incidents[HEAP_MAX]; static int incident_count = 0;
+
+static double now_us(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
 }
 
-/* ---------------- Load nodes.csv (your format) ----------------
-   expected: ext_id,lat,lon,name,type
-   tolerant: trims spaces, strips BOM, skips malformed lines silently
-*/
-int load_nodes_custom(Graph *g, const char *filename, ExtMap *emap) {
-    FILE *f = fopen(filename, "r");
-    if (!f) return -1;
-    char line[1024]; int count = 0;
-    while (fgets(line, sizeof(line), f)) {
-        trim(line); if (line[0] == '\0') continue;
-        strip_bom(line);
-        /* parse with sscanf fallback */
-        long extid=0; double lat=0.0, lon=0.0;
-        char namebuf[128]={0}, typebuf[64]={0};
-        if (sscanf(line, "%ld,%lf,%lf,%127[^,],%63[^\n]", &extid, &lat, &lon, namebuf, typebuf) == 5) {
-            trim(namebuf); trim(typebuf);
-            int idx = add_node(g, extid, namebuf, typebuf, lat, lon);
-            if (idx >= 0) { extmap_add(emap, extid, idx); count++; }
-        } else {
-            /* skip malformed */
+/* best of leaving by either end of the road: lead time to the end, then road time from it */
+static double eta_via(double lead_a, double from_a, double lead_b, double from_b) {
+    double a = lead_a >= RT_UNREACHABLE || from_a >= RT_UNREACHABLE ? RT_UNREACHABLE : lead_a + from_a;
+    double b = lead_b >= RT_UNREACHABLE || from_b >= RT_UNREACHABLE ? RT_UNREACHABLE : lead_b + from_b;
+    return a < b ? a : b;
+}
+static void reopt_fill_eta(RtGraph *rg, Incident *in) {
+    int *slot = malloc(sizeof(int) * (unit_count + 1)), *src = malloc(sizeof(int) * (2 * unit_count + 1)), n = 0;
+    double *col = malloc(sizeof(double) * (2 * unit_count + 1)), *lead = malloc(sizeof(double) * (2 * unit_count + 1)), lat, lon;
+    for (int u = 0; u < unit_count; ++u) in->eta[u] = RT_UNREACHABLE;
+    in->eta_ver = rt_version(rg);   /* read first: an update during the fill leaves the column stale, not marked fresh */
+    if (in->type != -1) {
+        if (rt_coords(rg, in->target, &lat, &lon)) n = nearest_available_units(lat, lon, in->type, NEAREST_UNITS, slot, NULL);
+        else for (int u = next_available_unit(in->type, 0); u != -1; u = next_available_unit(in->type, u + 1)) slot[n++] = u;
+        /* a unit flagged free while still on a call comes in below; listed twice it would overrun the buffers */
+        int m = 0;
+        for (int k = 0; k < n; ++k) if (!unit_incident[slot[k]]) slot[m++] = slot[k];
+        n = m;
+        /* units on other calls are candidates too, for swaps */
+        for (int j = 0; j < incident_count; ++j)
+            if (incidents[j].unit != -1 && incidents[j].type == in->type) slot[n++] = incidents[j].unit;
+    }
+    /* two sources per unit: the ends of the road it is on */
+    for (int k = 0; k < n; ++k) {
+        UnitPos p; unit_read(slot[k], &p);
+        src[2 * k] = p.a; lead[2 * k] = p.ta; src[2 * k + 1] = p.b; lead[2 * k + 1] = p.tb;
+    }
+    if (n && rt_matrix(rg, src, 2 * n, &in->target, 1, col) == 0)
+        for (int k = 0; k < n; ++k) in->eta[slot[k]] = eta_via(lead[2 * k], col[2 * k], lead[2 * k + 1], col[2 * k + 1]);
+    free(slot); free(src); free(col); free(lead);
+}
+/* row refill: unit u against every open, not yet arrived call of its type */
+static void reopt_fill_unit(RtGraph *rg, int u, double now) {
+    int *dst = malloc(sizeof(int) * (incident_count + 1)), *which = malloc(sizeof(int) * (incident_count + 1)), n = 0;
+    for (int k = 0; k < incident_count; ++k)
+        if (incidents[k].type == units[u].type && !incidents[k].locked) { dst[n] = incidents[k].target; which[n++] = k; }
+    double *row = malloc(sizeof(double) * (2 * n + 1));
+    UnitPos p; unit_read(u, &p);
+    int src[2] = { p.a, p.b };
+    if (n && rt_matrix(rg, src, 2, dst, n, row) == 0)
+        for (int j = 0; j < n; ++j) incidents[which[j]].eta[u] = eta_via(p.ta, row[j], p.tb, row[n + j]);
+    /* a unit that pinged since it was assigned is timed from where it is now */
+    int k = unit_incident[u] - 1;
+    if (k >= 0 && !incidents[k].locked && unit_pos_seq(u) != incidents[k].unit_seq) { incidents[k].assigned_at = now; incidents[k].unit_seq = unit_pos_seq(u); }
+    free(dst); free(which); free(row);
+}
+static double incident_cost(const Incident *in, int u) {
+    return u == -1 || in->eta[u] >= RT_UNREACHABLE ? REOPT_UNSERVED : in->eta[u];
+}
+
+/* opens an incident for a popped call (type -1 = no unit can serve it); returns its index */
+int reopt_add(RtGraph *rg, const struct Call *c, int target, int type, double now) {
+    if (incident_count >= HEAP_MAX) return -1;
+    Incident *in = &incidents[incident_count];
+    in->call = *c; in->target = target; in->type = type; in->unit = -1;
+    in->locked = 0; in->moved = 0; in->assigned_at = now;
+    size_t bytes = sizeof(double) * (unit_count + 1);
+    if (!mem_grow(bytes, "incident ETAs")) return -1;
+    if (!(in->eta = malloc(bytes))) { mem_shrink(bytes); fprintf(stderr, "incident ETAs: out of memory\n"); return -1; }
+    reopt_fill_eta(rg, in);
+    return incident_count++;
+}
+
+/* closes incident k and frees its unit; the last incident takes index k */
+void reopt_complete(int k) {
+    Incident *in = &incidents[k];
+    if (in->unit != -1) { unit_incident[in->unit] = 0; set_unit_available(units[in->unit].id, 1); }
+    free(in->eta); mem_shrink(sizeof(double) * (unit_count + 1));
+    *in = incidents[--incident_count];
+    if (k < incident_count && in->unit != -1) unit_incident[in->unit] = k + 1;
+}
+
+static int reopt_take(int k, int u, double now) {
+    Incident *in = &incidents[k];
+    if (u != -1 && !unit_incident[u] && !claim_unit(u)) return 0;   /* crew went off duty */
+    if (in->unit != -1 && unit_incident[in->unit] == k + 1) { unit_incident[in->unit] = 0; set_unit_available(units[in->unit].id, 1); }
+    in->unit = u; in->assigned_at = now; in->moved = 1;
+    if (u != -1) { unit_incident[u] = k + 1; in->unit_seq = unit_pos_seq(u); }
+    return 1;
+}
+
+/* improves the assignment until nothing saves REOPT_MIN_GAIN or budget_us runs out; with
+   moves == 0 only unserved calls get free units (plain greedy dispatch). the first sweep always
+   runs: it only compares ETAs already filled, and it is what gives a new call its unit. returns
+   changes made. */
+int reopt_run(RtGraph *rg, double now, double budget_us, int moves) {
+    double deadline = now_us() + budget_us;
+    unsigned long long ver = rt_version(rg); int refills = 0;
+    for (int k = 0; k < incident_count && (!refills || now_us() < deadline); ++k)
+        if (incidents[k].eta_ver != ver) { reopt_fill_eta(rg, &incidents[k]); ++refills; }
+    for (int w = 0; w * 64 < unit_count && (!refills || now_us() < deadline); ++w)
+        for (unsigned long long bits = atomic_load(&unit_dirty[w]); bits && (!refills || now_us() < deadline); bits &= bits - 1) {
+            /* cleared before the refill, so a ping during it marks the unit again */
+            atomic_fetch_and(&unit_dirty[w], ~(bits & -bits));
+            reopt_fill_unit(rg, w * 64 + __builtin_ctzll(bits), now); ++refills;
+        }
+    int order[HEAP_MAX], n = 0;
+    for (int k = 0; k < incident_count; ++k) {
+        Incident *in = &incidents[k];
+        in->moved = 0;
+        if (in->unit != -1 && now >= in->assigned_at + in->eta[in->unit]) in->locked = 1;
+        if (in->locked) continue;
+        /* most urgent first, older first within a severity */
+        int i = n++;
+        while (i > 0 && compare_calls(&in->call, &incidents[order[i-1]].call)) { order[i] = order[i-1]; --i; }
+        order[i] = k;
+    }
+    int changes = 0, improved = 1;
+    for (int sweep = 0; improved && (sweep == 0 || now_us() < deadline); ++sweep) {
+        improved = 0;
+        for (int o = 0; o < n && (sweep == 0 || now_us() < deadline); ++o) {
+            int k = order[o]; Incident *in = &incidents[k];
+            if (in->type == -1 || (!moves && in->unit != -1)) continue;
+            double w = in->call.sev, cur = incident_cost(in, in->unit), best = -REOPT_MIN_GAIN;
+            int pick = -1;
+            for (int u = 0; u < unit_count; ++u) {
+                if (u == in->unit || in->eta[u] >= RT_UNREACHABLE) continue;
+                int j = unit_incident[u] - 1;
+                double delta = w * (in->eta[u] - cur);
+                if (j == -1) { if (!unit_available(u)) continue; }
+                else {
+                    if (!moves || incidents[j].locked) continue;
+                    delta += incidents[j].call.sev * (incident_cost(&incidents[j], in->unit) - incidents[j].eta[u]);
+                }
+                if (delta < best) { best = delta; pick = u; }
+            }
+            if (pick == -1) continue;
+            int j = unit_incident[pick] - 1, old = in->unit;
+            if (j == -1) { if (!reopt_take(k, pick, now)) continue; }
+            else {
+                /* swap: j gets k's old unit (or none) */
+                in->unit = pick; unit_incident[pick] = k + 1; in->assigned_at = now; in->moved = 1; in->unit_seq = unit_pos_seq(pick);
+                incidents[j].unit = old; if (old != -1) { unit_incident[old] = j + 1; incidents[j].unit_seq = unit_pos_seq(old); }
+                incidents[j].assigned_at = now; incidents[j].moved = 1;
+            }
+            ++changes; improved = 1;
+        }
+    }
+    return changes;
+}
+
+/* ---------------- Dispatch (automatic) ----------------
+   runs the queued calls on a simulated clock: every call taken at the console is open at time 0,
+   and a unit stays on its call until it reaches the scene, when it is free again. while calls
+   are waiting the most urgent is opened next; once none are left the clock jumps to the next
+   arrival. every open call stays in the re-optimizer, so a later call can take a unit that is
+   still on its way to another one, and a call with every unit of its type busy waits for one. */
+static void print_dispatch(RtGraph *rg, int k, int *path) {
+    int u = incidents[k].unit, target = incidents[k].target, path_len = 0;
+    double eta = incidents[k].eta[u];
+    printf(" ETA: %.1f min (%.0f s by road)\n", eta / 60.0, eta);
+    double lead; int start = unit_route_start(rg, u, target, &lead);
+    if (lead > 0) printf(" On the road, %.0f s from %s\n", lead, node_label(rg, start));
+    rt_route(rg, start, target, path, &path_len);
+    printf(" Route:"); print_path(rg, path, path_len); printf("\n");
+    /* backups in case the crew finds the primary blocked: at most 50% slower, at most half shared */
+    RtRoutes alt;
+    int n_alt = rt_alternatives(rg, start, target, 3, 1.5, 0.5, &alt);
+    for (int r = 1; r < n_alt; ++r) {
+        printf(" Backup %d (ETA %.1f min):", r, alt.times[r] / 60.0);
+        print_path(rg, alt.nodes + alt.offsets[r], alt.offsets[r+1] - alt.offsets[r]);
+        printf("\n");
+    }
+    rt_routes_free(&alt);
+}
+/* re-optimizes at now and reports every call whose unit changed; prev[k] is k's unit before */
+static void dispatch_run(RtGraph *rg, double now, int *path) {
+    int prev[HEAP_MAX];
+    for (int k = 0; k < incident_count; ++k) prev[k] = incidents[k].unit;
+    reopt_run(rg, now, REOPT_BUDGET_US, 1);
+    for (int k = 0; k < incident_count; ++k) {
+        Incident *in = &incidents[k];
+        if (!in->moved) continue;
+        if (in->unit == -1) { printf("'%s' gave its unit up to a more urgent call.\n", in->call.loc); continue; }
+        if (prev[k] == -1) printf("\nDispatching %s unit %d to '%s'\n", unit_type_name[units[in->unit].type], units[in->unit].id, node_label(rg, in->target));
+        else printf("\nReassigned unit %d to '%s' (was unit %d)\n", units[in->unit].id, in->call.loc, units[prev[k]].id);
+        print_dispatch(rg, k, path);
+    }
+}
+void dispatch_all(RtGraph *rg) {
+    int *path = malloc(sizeof(int) * (rt_node_count(rg) + 1));
+    double now = 0;
+    while (!is_queue_empty() || incident_count) {
+        if (!is_queue_empty()) {
+            struct Call inc = extract_call();
+            int target = resolve_location(rg, inc.loc);
+            if (target == -1) {
+                printf("Location '%s' not found. Skipping.\n", inc.loc);
+                continue;
+            }
+            char required_type[32];
+            if (inc.sev >= 4) strcpy(required_type, "ambulance");
+            else if (inc.sev == 3) strcpy(required_type, "police");
+            else strcpy(required_type, "fire");
+
+            /* the re-optimizer picks the unit; earlier calls may give theirs up if this one is more urgent */
+            int k = reopt_add(rg, &inc, target, unit_type_lookup(required_type), now);
+            if (k == -1) { printf("No room for another open incident. Skipping '%s'.\n", inc.loc); continue; }
+            dispatch_run(rg, now, path);
+            if (incidents[k].unit == -1) printf("All %s units busy. '%s' waits for one.\n", required_type, inc.loc);
             continue;
         }
+        /* next arrival on scene; with no unit on the way, the calls left can never be served */
+        int next = -1;
+        for (int k = 0; k < incident_count; ++k) {
+            Incident *in = &incidents[k];
+            if (in->unit != -1 && (next == -1 || in->assigned_at + in->eta[in->unit] < incidents[next].assigned_at + incidents[next].eta[incidents[next].unit])) next = k;
+        }
+        if (next == -1) {
+            while (incident_count) {
+                printf("No %s unit can reach '%s'. Skipping.\n", incidents[0].type == -1 ? "suitable" : unit_type_name[incidents[0].type], incidents[0].call.loc);
+                reopt_complete(0);
+            }
+            break;
+        }
+        Incident *in = &incidents[next];
+        now = in->assigned_at + in->eta[in->unit];
+        printf("\n[+%.1f min] Unit %d on scene at '%s', available again.\n", now / 60.0, units[in->unit].id, in->call.loc);
+        double lat, lon;    /* free from the scene, not back at its station */
+        if (rt_coords(rg, in->target, &lat, &lon)) unit_ping(rg, units[in->unit].id, lat, lon);
+        reopt_complete(next);
+        if (incident_count) dispatch_run(rg, now, path);
     }
-    fclose(f);
-    /* silent load: no per-line prints */
-    return 0;
+    free(path);
+    printf("\nAll incidents processed.\n");
 }
 
-/* ---------------- Load edges.csv (your 6-column format) ----------------
-   expected: edge_id,src_ext_id,dst_ext_id,distance_meters,travel_time,flag
-   convert meters -> km as weight; create placeholder nodes if ext_id missing.
-*/
-int load_edges_custom(Graph *g, const char *filename, ExtMap *emap) {
-    FILE *f = fopen(filename, "r");
-    if (!f) return -1;
-    char line[512]; int count = 0;
-    while (fgets(line, sizeof(line), f)) {
-        trim(line); if (line[0] == '\0') continue;
-        strip_bom(line);
-        /* tokenize using strtok (portable) */
-        char *tok[6] = {0}; int tokc = 0;
-        char buf[512]; strncpy(buf, line, sizeof(buf)-1); buf[sizeof(buf)-1] = '\0';
-        char *t = strtok(buf, ",");
-        while (t && tokc < 6) { trim(t); tok[tokc++] = t; t = strtok(NULL, ","); }
-        if (tokc < 3) continue; /* not enough tokens */
-        long src_ext = 0, dst_ext = 0; if (!safe_parse_long(tok[1], &src_ext)) continue;
-        if (!safe_parse_long(tok[2], &dst_ext)) continue;
-        double dist_m = 0.0; if (tokc >= 4) safe_parse_double(tok[3], &dist_m);
-        double weight_km = (dist_m > 0.0) ? (dist_m / 1000.0) : 1.0;
-        int src_idx = extmap_get(emap, src_ext);
-        if (src_idx == -1) {
-            char namebuf[64]; snprintf(namebuf, sizeof(namebuf), "node_%ld", src_ext);
-            src_idx = add_node(g, src_ext, namebuf, "unknown", 0.0, 0.0);
-            extmap_add(emap, src_ext, src_idx);
+/* ---------------- Memory ---------------- */
+/* routing core footprint plus this program's own tables; returns the item count */
+int memory_items(const RtGraph *rg, RtMemItem *items) {
+    int n = rt_memory(rg, items, 32);
+    if (n > 32) n = 32;
+    size_t etas = (size_t)incident_count * unit_count * sizeof(double);
+    items[n++] = (RtMemItem){ "call heap", heap_size * sizeof(struct Call), sizeof(heapQ) };
+    items[n++] = (RtMemItem){ "unit registry", unit_count * sizeof(Unit) + unit_type_count * sizeof(unit_type_name[0]),
+                              sizeof(units) + sizeof(unit_hash) + sizeof(unit_avail) + sizeof(unit_type_name) };
+    items[n++] = (RtMemItem){ "unit positions", unit_count * sizeof(UnitSlot) + sizeof(unit_grid[0]) / UNIT_WORDS * GRID_BUCKETS * ((unit_count + 63) / 64),
+                              sizeof(unit_pos) + sizeof(unit_grid) };
+    items[n++] = (RtMemItem){ "call log buffers", wal.len, wal.cap + wal.spare_cap };
+    items[n++] = (RtMemItem){ "incidents + ETAs", incident_count * sizeof(Incident) + etas, sizeof(incidents) + sizeof(unit_incident) + etas };
+    return n;
+}
+/* returns total reserved bytes */
+size_t print_memory(const RtMemItem *items, int n, FILE *f) {
+    size_t used = 0, reserved = 0;
+    fprintf(f, "%-22s %14s %14s\n", "structure", "used bytes", "reserved bytes");
+    for (int i = 0; i < n; ++i) {
+        fprintf(f, "%-22s %14zu %14zu\n", items[i].what, items[i].used, items[i].reserved);
+        used += items[i].used; reserved += items[i].reserved;
+    }
+    fprintf(f, "%-22s %14zu %14zu\n", "total", used, reserved);
+    return reserved;
+}
+
+/* ---------------- Bench (call log) ---------------- */
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+/* rounds of 900 inserts then 900 extracts; per-insert latency with and without the log */
+static void bench_insert(int logged, int rounds, double *lat) {
+    int saved = wal.running; if (!logged) wal.running = 0;
+    struct Call c = {0, "Clock Tower", 3, 0};
+    for (int r = 0, k = 0; r < rounds; ++r) {
+        for (int i = 0; i < 900; ++i, ++k) {
+            c.id = k + 1; c.sev = 1 + k % 5; c.time = k;
+            double t0 = now_us(); insert_call(c); lat[k] = now_us() - t0;
         }
-        int dst_idx = extmap_get(emap, dst_ext);
-        if (dst_idx == -1) {
-            char namebuf[64]; snprintf(namebuf, sizeof(namebuf), "node_%ld", dst_ext);
-            dst_idx = add_node(g, dst_ext, namebuf, "unknown", 0.0, 0.0);
-            extmap_add(emap, dst_ext, dst_idx);
+        while (!is_queue_empty()) extract_call();
+    }
+    wal.running = saved;
+}
+int bench_wal(void) {
+    const char *base = "bench_calls";
+    char p[3][64]; snprintf(p[0], 64, "%s.wal", base); snprintf(p[1], 64, "%s.snap", base); snprintf(p[2], 64, "%s.snap.tmp", base);
+    for (int i = 0; i < 3; ++i) unlink(p[i]);
+    int rounds = 50, n = rounds * 900;
+    double *lat = malloc(sizeof(double) * n);
+    wal_open(base);
+    for (int logged = 0; logged < 2; ++logged) {
+        bench_insert(logged, rounds, lat);
+        double sum = 0; for (int i = 0; i < n; ++i) sum += lat[i];
+        qsort(lat, n, sizeof(double), cmp_double);
+        printf("insert_call %-9s avg %.2f us  p50 %.2f  p99 %.2f  max %.1f\n", logged ? "logged" : "in-memory",
+               sum / n, lat[n / 2], lat[n * 99 / 100], lat[n - 1]);
+    }
+    double t0 = now_us(); wal_sync();
+    printf("wal_sync (flush the tail) %.0f us\n", now_us() - t0);
+
+    /* a crash with 900 calls pending: snapshot + log tail to replay */
+    struct Call c = {0, "ISBT", 4, 0};
+    for (int i = 0; i < 900; ++i) { c.id = i + 1; c.time = i; insert_call(c); }
+    for (int i = 0; i < 300; ++i) change_severity(1 + i * 3, 5);
+    for (int i = 0; i < 300; ++i) cancel_call(2 + i * 3);
+    wal_close();
+    int pending = heap_size;
+    heap_size = 0;
+    t0 = now_us(); int got = wal_open(base);
+    printf("recovery: %d of %d calls back in %.2f ms\n", got, pending, (now_us() - t0) / 1e3);
+    wal_close();
+    for (int i = 0; i < 3; ++i) unlink(p[i]);
+    free(lat);
+    return got == pending ? 0 : 1;
+}
+
+/* ---------------- Bench (re-optimizer) ---------------- */
+/* simulated shift on the loaded map: random calls every ~5 min, 15 min on scene; greedy dispatch
+   (a unit is never taken back) against the rolling-horizon re-optimizer on the same call stream */
+static void bench_shift(RtGraph *rg, int moves, int calls, double *lat, int *n_lat, double *resp, double *resp5, int *changes) {
+    const double gap = 300, on_scene = 900;
+    srand(7);
+    int n = rt_node_count(rg), issued = 0, served = 0, served5 = 0;
+    double next_call = 0, wsum = 0, wtot = 0, sum5 = 0;
+    double *done = calloc(UNITS_MAX, sizeof(double));    /* unit back at station (0 = not busy) */
+    *n_lat = 0; *changes = 0;
+    for (double now = 0; issued < calls || incident_count; now += 1) {
+        int event = 0;
+        for (int u = 0; u < unit_count; ++u)
+            if (done[u] && now >= done[u]) { done[u] = 0; set_unit_available(units[u].id, 1); event = 1; }
+        for (int k = 0; k < incident_count; ++k) {
+            Incident *in = &incidents[k];
+            if (in->unit == -1 || now < in->assigned_at + in->eta[in->unit]) continue;
+            double r = now - in->call.time;
+            wsum += in->call.sev * r; wtot += in->call.sev; ++served;
+            if (in->call.sev == 5) { sum5 += r; ++served5; }
+            /* on scene, then the drive back; the unit stays claimed until then */
+            int u = in->unit; done[u] = now + on_scene + in->eta[u];
+            unit_incident[u] = 0; in->unit = -1;
+            free(in->eta); *in = incidents[--incident_count];
+            if (k < incident_count && in->unit != -1) unit_incident[in->unit] = k + 1;
+            --k;
+        }
+        if (issued < calls && now >= next_call) {
+            struct Call c = {issued + 1, "", 1 + rand() % 5, (int)now};
+            int target = rand() % n;
+            const char *type = c.sev >= 4 ? "ambulance" : c.sev == 3 ? "police" : "fire";
+            snprintf(c.loc, sizeof(c.loc), "%s", node_label(rg, target));
+            reopt_add(rg, &c, target, unit_type_lookup(type), now);
+            ++issued; next_call = now + 1 + rand() % (int)(2 * gap);
+            event = 1;
         }
-        add_edge(g, src_idx, dst_idx, weight_km);
-        add_edge(g, dst_idx, src_idx, weight_km);
-        count++;
+        if (!event) continue;
+        double t0 = now_us();
+        *changes += reopt_run(rg, now, REOPT_BUDGET_US, moves);
+        lat[(*n_lat)++] = now_us() - t0;
+    }
+    for (int u = 0; u < unit_count; ++u) if (done[u]) set_unit_available(units[u].id, 1);
+    free(done);
+    *resp = wsum / (wtot ? wtot : 1); *resp5 = sum5 / (served5 ? served5 : 1);
+}
+
+int bench_reopt(void) {
+    RtGraph *rg = rt_load("nodes.csv", "edges.csv");
+    if (!rg) { fprintf(stderr, "Failed to load nodes.csv / edges.csv\n"); return 1; }
+    init_units_from_graph(rg);
+    int calls = 500;
+    double *lat = malloc(sizeof(double) * 3 * calls);
+    for (int moves = 0; moves < 2; ++moves) {
+        int n_lat, changes; double resp, resp5;
+        bench_shift(rg, moves, calls, lat, &n_lat, &resp, &resp5, &changes);
+        qsort(lat, n_lat, sizeof(double), cmp_double);
+        printf("%-12s weighted response %.1f min  severity-5 %.1f min  assignments %d  run p50 %.1f us p99 %.1f max %.1f (budget %d)\n",
+               moves ? "re-optimize" : "greedy", resp / 60, resp5 / 60, changes,
+               lat[n_lat / 2], lat[n_lat * 99 / 100], lat[n_lat - 1], REOPT_BUDGET_US);
     }
-    fclose(f);
+    free(lat);
+    rt_free(rg);
     return 0;
 }
 
-/* ---------------- Priority queue (calls) ---------------- */
-struct Call { int id; char loc[200]; int sev; int time; };
-static struct Call heapQ[HEAP_MAX];
-static int heap_size = 0;
-static int compare_calls(const struct Call *a, const struct Call *b) {
-    if (a->sev != b->sev) return a->sev > b->sev;
-    return a->time < b->time;
+/* ---------------- Bench (unit positions) ---------------- */
+/* a synthetic fleet of 3000 units over the map, half of them busy. pings go to random points of
+   the map, each thread feeding its own share of the fleet (one feed per unit, as in the field);
+   nearest-unit queries are timed on a quiet store and checked against a full scan, then timed
+   again while every feed keeps pinging */
+typedef struct { const RtGraph *rg; int first, count, pings; double lat0, lat1, lon0, lon1; atomic_int *stop; long done; } PingFeed;
+static double bench_rand(unsigned *s, double lo, double hi) {
+    *s ^= *s << 13; *s ^= *s >> 17; *s ^= *s << 5;
+    return lo + (hi - lo) * (*s / 4294967296.0);
 }
-static void swap_calls(struct Call *a, struct Call *b) { struct Call t = *a; *a = *b; *b = t; }
+static void *ping_feed(void *arg) {
+    PingFeed *f = arg; unsigned seed = 2463534242u + f->first;
+    for (long p = 0; f->stop ? !atomic_load(f->stop) : p < f->pings; ++p, ++f->done)
+        unit_ping(f->rg, units[f->first + p % f->count].id, bench_rand(&seed, f->lat0, f->lat1), bench_rand(&seed, f->lon0, f->lon1));
+    return NULL;
+}
+/* all feeds at once; returns pings per second */
+static double run_feeds(const RtGraph *rg, int threads, int pings, const double *box, atomic_int *stop, void (*during)(void *), void *ctx) {
+    pthread_t th[64]; PingFeed feed[64];
+    if (threads > 64) threads = 64;
+    double t0 = now_us();
+    for (int t = 0; t < threads; ++t) {
+        int first = unit_count * t / threads, last = unit_count * (t + 1) / threads;
+        feed[t] = (PingFeed){ rg, first, last - first, pings / threads, box[0], box[1], box[2], box[3], stop, 0 };
+        pthread_create(&th[t], NULL, ping_feed, &feed[t]);
+    }
+    if (during) { during(ctx); atomic_store(stop, 1); }
+    long done = 0;
+    for (int t = 0; t < threads; ++t) { pthread_join(th[t], NULL); done += feed[t].done; }
+    return done / ((now_us() - t0) / 1e6);
+}
+typedef struct { int queries, k, mismatches; double *lat; const double *box; } NearestRun;
+static void run_nearest(void *arg) {
+    NearestRun *q = arg; unsigned seed = 88172645u;
+    int out[64]; double km[64], *all = malloc(sizeof(double) * (unit_count + 1));
+    for (int i = 0; i < q->queries; ++i) {
+        double lat = bench_rand(&seed, q->box[0], q->box[1]), lon = bench_rand(&seed, q->box[2], q->box[3]);
+        int t = i % unit_type_count;
+        double t0 = now_us(); int n = nearest_available_units(lat, lon, t, q->k, out, km); q->lat[i] = now_us() - t0;
+        if (q->mismatches < 0) continue;
+        int m = 0;
+        for (int u = next_available_unit(t, 0); u != -1; u = next_available_unit(t, u + 1)) { UnitPos p; unit_read(u, &p); all[m++] = flat_km(lat, lon, p.lat, p.lon); }
+        qsort(all, m, sizeof(double), cmp_double);
+        int bad = n != (m < q->k ? m : q->k);
+        for (int j = 0; j < n && !bad; ++j) bad = fabs(km[j] - all[j]) > 1e-9;
+        q->mismatches += bad;
+    }
+    free(all);
+}
+int bench_positions(int threads) {
+    RtGraph *rg = rt_load("nodes.csv", "edges.csv");
+    if (!rg) { fprintf(stderr, "Failed to load nodes.csv / edges.csv\n"); return 1; }
+    init_units_from_graph(rg);
+    double box[4] = { 90, -90, 180, -180 }, lat, lon;
+    int n = rt_node_count(rg), *placed = malloc(sizeof(int) * (n + 1)), n_placed = 0;
+    for (int v = 0; v < n; ++v)
+        if (rt_coords(rg, v, &lat, &lon)) {
+            placed[n_placed++] = v;
+            box[0] = fmin(box[0], lat); box[1] = fmax(box[1], lat);
+            box[2] = fmin(box[2], lon); box[3] = fmax(box[3], lon);
+        }
+    if (!n_placed) { fprintf(stderr, "no positioned nodes\n"); free(placed); rt_free(rg); return 1; }
+    const char *types[3] = { "ambulance", "police", "fire" };
+    while (unit_count < 3000) {
+        int i = unit_count;
+        add_unit(placed[i % n_placed], types[i % 3], 100000 + i);
+        unit_place_at_station(rg, i);
+        if (i % 2) claim_unit(i);
+    }
+    free(placed);
 
-void insert_call(struct Call c) {
-    if (heap_size + 1 >= HEAP_MAX) return;
-    heapQ[++heap_size] = c;
-    int i = heap_size;
-    while (i > 1 && compare_calls(&heapQ[i], &heapQ[i/2])) { swap_calls(&heapQ[i], &heapQ[i/2]); i /= 2; }
+    double rate1 = run_feeds(rg, 1, 200000, box, NULL, NULL, NULL);
+    double rate = run_feeds(rg, threads, 200000, box, NULL, NULL, NULL);
+    printf("GPS pings (snap + publish): %.0f/s on 1 thread, %.0f/s on %d threads\n", rate1, rate, threads);
+
+    int queries = 20000, k = 5;
+    double *qlat = malloc(sizeof(double) * queries);
+    NearestRun q = { queries, k, 0, qlat, box };
+    run_nearest(&q);
+    qsort(qlat, queries, sizeof(double), cmp_double);
+    printf("nearest %d free units of a type: p50 %.2f us  p99 %.2f  max %.1f  (%d of %d differ from a full scan)\n",
+           k, qlat[queries / 2], qlat[queries * 99 / 100], qlat[queries - 1], q.mismatches, queries);
+
+    int mismatches = q.mismatches;
+    atomic_int stop = 0; q.mismatches = -1;   /* positions move under the queries, nothing to check against */
+    rate = run_feeds(rg, threads, 0, box, &stop, run_nearest, &q);
+    qsort(qlat, queries, sizeof(double), cmp_double);
+    printf("while %d feeds ping (%.0f/s): p50 %.2f us  p99 %.2f  max %.1f\n",
+           threads, rate, qlat[queries / 2], qlat[queries * 99 / 100], qlat[queries - 1]);
+    free(qlat);
+    rt_free(rg);
+    return mismatches ? 1 : 0;
 }
-struct Call extract_call(void) {
-    struct Call nullC = {0, "", 0, 0};
-    if (heap_size == 0) return nullC;
-    struct Call root = heapQ[1];
-    heapQ[1] = heapQ[heap_size--];
-    int i = 1;
-    while (1) {
-        int largest = i, l = 2*i, r = 2*i+1;
-        if (l <= heap_size && compare_calls(&heapQ[l], &heapQ[largest])) largest = l;
-        if (r <= heap_size && compare_calls(&heapQ[r], &heapQ[largest])) largest = r;
-        if (largest == i) break;
-        swap_calls(&heapQ[i], &heapQ[largest]);
-        i = largest;
+
+/* ---------------- Load test ----------------
+   open-loop replay against the real dispatcher in real time: arrivals are drawn up front
+   (bursts of mean size B at rate/B per second, so B = 1 is Poisson; a share of calls at H hotspot
+   nodes; a share given as GPS fixes jittered around a node, the rest by name), then one loop does
+   what a dispatcher does: insert_call() each call as its time comes, extract_call(), resolve the
+   location, pick and claim a unit through the re-optimizer, route it. intake-to-dispatch runs from
+   the call's scheduled arrival to its route being ready, so time spent queued behind a backlog
+   counts. a call that is never dispatched (location not found, no unit of its type free, queue
+   full) is a miss with infinite intake-to-dispatch, and the run fails once more than max_dropped
+   calls are lost. routing is the ETA fill plus the final route, timed after the location is
+   resolved; resolving is reported on its own. units are busy for their ETA plus 15 min on scene,
+   in simulated time running scale times faster than the wall clock. output is key=value, one line
+   per measure, so runs diff cleanly. */
+typedef struct { double at_us; int sev; char loc[64]; } Arrival;
+typedef struct {
+    double rate, burst, hotspot_share, gps, duration, scale; int hotspots, fleet, log; unsigned seed; int max_dropped;
+} LoadSpec;
+/* e2e holds every call that was dispatched or dropped (INFINITY), nresolve the resolve samples */
+typedef struct { int offered, dispatched, no_unit, unresolved, rejected, ne2e, nresolve; double span_us, *e2e, *route, *resolve; } LoadResult;
+
+static int draw_arrivals(const RtGraph *rg, const LoadSpec *ls, Arrival **out) {
+    unsigned seed = ls->seed * 2654435761u + 1;
+    int n = rt_node_count(rg), *pool = malloc(sizeof(int) * (n + 1)), m = 0, hot[64];
+    double lat, lon;
+    for (int v = 0; v < n; ++v) if (rt_name(rg, v) && rt_coords(rg, v, &lat, &lon)) pool[m++] = v;
+    if (!m) { free(pool); return 0; }
+    int h = ls->hotspots < 1 ? 1 : ls->hotspots > 64 ? 64 : ls->hotspots;
+    for (int i = 0; i < h; ++i) hot[i] = pool[(int)bench_rand(&seed, 0, m)];
+    int cap = (int)(ls->rate * ls->duration * 1.5) + 64, count = 0;
+    Arrival *a = malloc(sizeof(Arrival) * cap);
+    double burst = ls->burst < 1 ? 1 : ls->burst;
+    for (double t = 0;;) {
+        t += -log(1 - bench_rand(&seed, 0, 1)) * burst / ls->rate;
+        if (t >= ls->duration) break;
+        /* geometric burst size with mean burst */
+        int size = 1; while (bench_rand(&seed, 0, 1) < 1 - 1 / burst) ++size;
+        for (int j = 0; j < size; ++j) {
+            if (count == cap) { cap *= 2; a = realloc(a, sizeof(Arrival) * cap); }
+            Arrival *c = &a[count++];
+            int v = bench_rand(&seed, 0, 1) < ls->hotspot_share ? hot[(int)bench_rand(&seed, 0, h)] : pool[(int)bench_rand(&seed, 0, m)];
+            c->at_us = t * 1e6; c->sev = 1 + (int)bench_rand(&seed, 0, 5);
+            rt_coords(rg, v, &lat, &lon);
+            if (bench_rand(&seed, 0, 1) < ls->gps)
+                snprintf(c->loc, sizeof(c->loc), "%.5f,%.5f", lat + bench_rand(&seed, -0.0005, 0.0005), lon + bench_rand(&seed, -0.0005, 0.0005));
+            else snprintf(c->loc, sizeof(c->loc), "%s", rt_name(rg, v));
+        }
     }
-    return root;
+    free(pool);
+    *out = a; return count;
 }
-int is_queue_empty(void) { return heap_size == 0; }
 
-/* ---------------- Units ---------------- */
-typedef struct { int id; int node_idx; char type[32]; int available; } Unit;
-Unit units[200]; int unit_count = 0;
+static void load_reset(const RtGraph *rg, int fleet) {
+    while (incident_count) reopt_complete(0);
+    heap_size = 0;
+    init_units_from_graph(rg);
+    int base = unit_count;
+    for (int c = 1; c < fleet; ++c)
+        for (int i = 0; i < base && unit_count < UNITS_MAX; ++i) {
+            add_unit(units[i].node_idx, unit_type_name[units[i].type], units[i].id + 100000 * c);
+            unit_place_at_station(rg, unit_count - 1);
+        }
+}
 
-void add_unit(int node_idx, const char *type, int id) {
-    if (unit_count >= (int)(sizeof(units)/sizeof(units[0]))) return;
-    units[unit_count].node_idx = node_idx;
-    strncpy(units[unit_count].type, type, sizeof(units[unit_count].type)-1);
-    units[unit_count].id = id;
-    units[unit_count].available = 1;
-    unit_count++;
-}
-
-void init_units_from_graph(Graph *g) {
-    unit_count = 0;
-    for (int i = 0; i < g->V; ++i) {
-        if (node_matches_type_or_name(g, i, "hospital")) add_unit(i, "ambulance", 1000 + i);
-        if (node_matches_type_or_name(g, i, "fire")) add_unit(i, "fire", 2000 + i);
-        if (node_matches_type_or_name(g, i, "police")) add_unit(i, "police", 3000 + i);
-    }
-}
-
-/* helper used in init_units */
-int node_matches_type_or_name(Graph *g, int idx, const char *key) {
-    if (!g || !key || idx < 0 || idx >= g->V) return 0;
-    char lname[256], ltype[256], lkey[256];
-    snprintf(lname, sizeof(lname), "%s", g->nodes[idx].name);
-    snprintf(ltype, sizeof(ltype), "%s", g->nodes[idx].type);
-    snprintf(lkey, sizeof(lkey), "%s", key);
-    for (int i = 0; lname[i]; ++i) lname[i] = tolower((unsigned char)lname[i]);
-    for (int i = 0; ltype[i]; ++i) ltype[i] = tolower((unsigned char)ltype[i]);
-    for (int i = 0; lkey[i]; ++i) lkey[i] = tolower((unsigned char)lkey[i]);
-    return (strstr(lname, lkey) != NULL) || (strstr(ltype, lkey) != NULL);
-}
-
-/* ---------------- Dispatch (automatic) ---------------- */
-void dispatch_all(Graph *g) {
-    while (!is_queue_empty()) {
-        struct Call inc = extract_call();
-        int target = find_node_fuzzy(g, inc.loc);
-        if (target == -1) {
-            printf("Location '%s' not found. Skipping.\n", inc.loc);
-            continue;
+static void load_run(RtGraph *rg, const LoadSpec *ls, LoadResult *res) {
+    Arrival *arr = NULL; int n = draw_arrivals(rg, ls, &arr);
+    memset(res, 0, sizeof(*res));
+    res->offered = n;
+    res->e2e = malloc(sizeof(double) * (n + 1)); res->route = malloc(sizeof(double) * (n + 1)); res->resolve = malloc(sizeof(double) * (n + 1));
+    load_reset(rg, ls->fleet);
+    int *rel_id = malloc(sizeof(int) * (n + 1)), rel_head = 0, rel_tail = 0;
+    double *rel_at = malloc(sizeof(double) * (n + 1));
+    int *path = malloc(sizeof(int) * (rt_node_count(rg) + 1)), path_len;
+    const char *type_of[6] = { "fire", "fire", "fire", "police", "ambulance", "ambulance" };
+    double t0 = now_us(), done_us = 0;
+    for (int next = 0; next < n || !is_queue_empty();) {
+        double now = now_us() - t0;
+        /* units back from scene, in release order */
+        while (rel_head < rel_tail && rel_at[rel_head] <= now) {
+            for (int k = 0; k < incident_count; ++k) if (incidents[k].call.id == rel_id[rel_head]) { reopt_complete(k); break; }
+            ++rel_head;
         }
-        char required_type[32];
-        if (inc.sev >= 4) strcpy(required_type, "ambulance");
-        else if (inc.sev == 3) strcpy(required_type, "police");
-        else strcpy(required_type, "fire");
-
-        double best = INF; int bestUnit = -1;
-        double distarr[MAX_NODES]; int parent[MAX_NODES];
-
-        for (int i = 0; i < unit_count; ++i) {
-            if (!units[i].available) continue;
-            if (strcasecmp(units[i].type, required_type) != 0) continue;
-            dijkstra(g, units[i].node_idx, distarr, parent);
-            if (distarr[target] < best) { best = distarr[target]; bestUnit = i; }
+        while (next < n && arr[next].at_us <= now) {
+            struct Call c = { next + 1, "", arr[next].sev, next };
+            snprintf(c.loc, sizeof(c.loc), "%s", arr[next].loc);
+            int before = heap_size;
+            insert_call(c);
+            if (heap_size == before) { ++res->rejected; res->e2e[res->ne2e++] = INFINITY; }
+            ++next;
         }
-        if (bestUnit == -1) {
-            printf("All %s units busy. Skipping '%s'.\n", required_type, inc.loc);
+        if (is_queue_empty()) {
+            double wait = (next < n ? arr[next].at_us : now) - now;
+            if (rel_head < rel_tail && rel_at[rel_head] - now < wait) wait = rel_at[rel_head] - now;
+            if (wait > 50) { struct timespec ts = { 0, (long)(wait < 5e5 ? wait : 5e5) * 1000 }; nanosleep(&ts, NULL); }
             continue;
         }
-        units[bestUnit].available = 0;
-        double avg_speed = 40.0;
-        double eta_min = (best / avg_speed) * 60.0;
-        printf("\nDispatching %s unit %d to '%s'\n", units[bestUnit].type, units[bestUnit].id, g->nodes[target].name);
-        printf(" Distance: %.2f km | ETA: %.1f min\n", best, eta_min);
-        /* recompute parent for printing path */
-        double tmpd[MAX_NODES]; int parent2[MAX_NODES];
-        dijkstra(g, units[bestUnit].node_idx, tmpd, parent2);
-        printf(" Route:"); print_path(g, parent2, target); printf("\n");
-        units[bestUnit].available = 1; /* immediate free (simulate) */
-        printf(" Unit %d now available.\n", units[bestUnit].id);
+        struct Call c = extract_call();
+        double q0 = now_us();
+        int target = rt_resolve(rg, c.loc, NULL);
+        double r0 = now_us();
+        res->resolve[res->nresolve++] = r0 - q0;
+        if (target == -1) { ++res->unresolved; res->e2e[res->ne2e++] = INFINITY; continue; }
+        double sim = now / 1e6 * ls->scale;
+        int k = reopt_add(rg, &c, target, unit_type_lookup(type_of[c.sev]), sim);
+        if (k == -1) { ++res->no_unit; res->e2e[res->ne2e++] = INFINITY; continue; }
+        double route_us = now_us() - r0;
+        /* greedy: moving units between calls would change calls already counted as dispatched
+           and the unit each release frees; --bench-reopt measures the re-optimizer on its own */
+        reopt_run(rg, sim, REOPT_BUDGET_US, 0);
+        int u = incidents[k].unit;
+        if (u == -1) { reopt_complete(k); ++res->no_unit; res->e2e[res->ne2e++] = INFINITY; continue; }
+        double r1 = now_us();
+        int start = unit_route_start(rg, u, target, NULL);
+        rt_route(rg, start, target, path, &path_len);
+        double end = now_us();
+        res->route[res->dispatched++] = route_us + (end - r1);
+        res->e2e[res->ne2e++] = end - t0 - arr[c.time].at_us;
+        rel_id[rel_tail] = c.id; rel_at[rel_tail++] = end - t0 + (incidents[k].eta[u] + 900) / ls->scale * 1e6;
+        done_us = end - t0;
     }
-    printf("\nAll incidents processed.\n");
+    res->span_us = done_us > ls->duration * 1e6 ? done_us : ls->duration * 1e6;
+    load_reset(rg, 1);
+    free(arr); free(rel_id); free(rel_at); free(path);
 }
 
-/* ---------------- Main ---------------- */
-int main(void) {
-    Graph *g = graph_create();
-    if (!g) { fprintf(stderr, "Memory error\n"); return 1; }
+static void print_percentiles(const char *what, double *v, int n) {
+    qsort(v, n, sizeof(double), cmp_double);
+    if (!n) { printf("%s n=0\n", what); return; }
+    printf("%s p50=%.0f p95=%.0f p99=%.0f p99.9=%.0f max=%.0f\n", what,
+           v[n / 2], v[(int)(n * 0.95)], v[(int)(n * 0.99)], v[(int)(n * 0.999)], v[n - 1]);
+}
+/* prints one run; returns 1 when it met the SLO: p99 intake-to-dispatch over every call, dropped
+   ones included, and no more than max_dropped calls lost */
+static int load_report(const LoadSpec *ls, LoadResult *r) {
+    printf("load rate=%.0f burst=%.1f hotspots=%d share=%.2f gps=%.2f duration=%.0f fleet=%d scale=%.0f seed=%u log=%d max_dropped=%d\n",
+           ls->rate, ls->burst, ls->hotspots, ls->hotspot_share, ls->gps, ls->duration, ls->fleet, ls->scale, ls->seed, ls->log, ls->max_dropped);
+    int dropped = r->no_unit + r->unresolved + r->rejected;
+    printf("calls offered=%d dispatched=%d dropped=%d no_unit=%d unresolved=%d rejected=%d throughput=%.1f\n",
+           r->offered, r->dispatched, dropped, r->no_unit, r->unresolved, r->rejected, r->dispatched / (r->span_us / 1e6));
+    int n = r->ne2e;
+    print_percentiles("intake_to_dispatch_us", r->e2e, n);
+    print_percentiles("resolve_us", r->resolve, r->nresolve);
+    print_percentiles("routing_us", r->route, r->dispatched);
+    int met = dropped <= ls->max_dropped && (n == 0 || r->e2e[(int)(n * 0.99)] <= SLO_US);
+    printf("slo p99<=%.0fus dropped<=%d %s\n", SLO_US, ls->max_dropped, met ? "met" : "broken");
+    free(r->e2e); free(r->route); free(r->resolve);
+    return met;
+}
 
-    ExtMap emap; extmap_init(&emap);
-    if (load_nodes_custom(g, "nodes.csv", &emap) == -1) {
-        fprintf(stderr, "Failed to open nodes.csv\n"); return 1;
+int load_test(int argc, char **argv) {
+    LoadSpec ls = { 50, 1, 0.5, 0.3, 5, 1000, 3, 40, 1, 1, 0 };
+    int sweep = 0;
+    for (int i = 2; i < argc; ++i) {
+        const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "--sweep") == 0) sweep = 1;
+        else if (strcmp(a, "--no-log") == 0) ls.log = 0;
+        else if (v && strcmp(a, "--rate") == 0) { ls.rate = atof(v); ++i; }
+        else if (v && strcmp(a, "--burst") == 0) { ls.burst = atof(v); ++i; }
+        else if (v && strcmp(a, "--hotspots") == 0) { ls.hotspots = atoi(v); ++i; }
+        else if (v && strcmp(a, "--hotspot-share") == 0) { ls.hotspot_share = atof(v); ++i; }
+        else if (v && strcmp(a, "--gps") == 0) { ls.gps = atof(v); ++i; }
+        else if (v && strcmp(a, "--duration") == 0) { ls.duration = atof(v); ++i; }
+        else if (v && strcmp(a, "--fleet") == 0) { ls.fleet = atoi(v); ++i; }
+        else if (v && strcmp(a, "--scale") == 0) { ls.scale = atof(v); ++i; }
+        else if (v && strcmp(a, "--seed") == 0) { ls.seed = (unsigned)atoi(v); ++i; }
+        else if (v && strcmp(a, "--max-dropped") == 0) { ls.max_dropped = atoi(v); ++i; }
+        else { fprintf(stderr, "load test: unknown option %s\n", a); return 2; }
     }
-    if (load_edges_custom(g, "edges.csv", &emap) == -1) {
-        fprintf(stderr, "Failed to open edges.csv\n"); return 1;
+    if (ls.rate <= 0 || ls.duration <= 0 || ls.scale <= 0 || ls.fleet < 1) { fprintf(stderr, "load test: rate, duration, scale and fleet must be positive\n"); return 2; }
+    RtGraph *rg = rt_load("nodes.csv", "edges.csv");
+    if (!rg) { fprintf(stderr, "Failed to load nodes.csv / edges.csv\n"); return 1; }
+    const char *base = "loadtest_calls";
+    char p[3][64]; snprintf(p[0], 64, "%s.wal", base); snprintf(p[1], 64, "%s.snap", base); snprintf(p[2], 64, "%s.snap.tmp", base);
+    for (int i = 0; i < 3; ++i) unlink(p[i]);
+    if (ls.log) wal_open(base);
+    double broke = 0, held = 0; int met;
+    for (;;) {
+        LoadResult r;
+        load_run(rg, &ls, &r);
+        met = load_report(&ls, &r);
+        if (met) held = ls.rate; else if (!broke) broke = ls.rate;
+        if (!sweep || !met || ls.rate > 1e6) break;
+        ls.rate *= 2;
+        printf("\n");
     }
+    if (sweep) printf("\nslo_held_rate=%.0f slo_break_rate=%.0f\n", held, broke);
+    if (ls.log) wal_close();
+    for (int i = 0; i < 3; ++i) unlink(p[i]);
+    rt_free(rg);
+    /* a sweep is expected to break the SLO at some rate; a single run fails when it does */
+    return sweep || met ? 0 : 1;
+}
 
-    init_units_from_graph(g);
-    printf("System ready with %d locations and %d units.\n", g->V, unit_count);
+/* ---------------- Main ---------------- */
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--bench-wal") == 0) return bench_wal();
+    if (argc > 1 && strcmp(argv[1], "--bench-reopt") == 0) return bench_reopt();
+    if (argc > 1 && strcmp(argv[1], "--load-test") == 0) return load_test(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "--bench-positions") == 0) return bench_positions(argc > 2 ? atoi(argv[2]) : 4);
+    int show_memory = 0; size_t budget = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--memory") == 0) show_memory = 1;
+        else if (strcmp(argv[i], "--memory-budget") == 0 && i + 1 < argc) budget = (size_t)(atof(argv[++i]) * 1048576.0);
+    }
+    rt_set_memory_budget(budget);
+
+    RtGraph *rg = rt_load("nodes.csv", "edges.csv");
+    if (!rg) { fprintf(stderr, "Failed to load nodes.csv / edges.csv\n"); return 1; }
+
+    init_units_from_graph(rg);
+    RtMemItem items[40]; int n_items = memory_items(rg, items);
+    if (show_memory) { print_memory(items, n_items, stdout); rt_free(rg); return 0; }
+    /* the routing core checked its own share; this covers the tables here as they stand, and
+       mem_grow() holds what they grow into later to the same budget */
+    size_t reserved = 0;
+    for (int i = 0; i < n_items; ++i) reserved += items[i].reserved;
+    if (budget && reserved > budget) {
+        fprintf(stderr, "%zu bytes reserved, over the memory budget of %zu\n", reserved, budget);
+        print_memory(items, n_items, stderr);
+        rt_free(rg); return 1;
+    }
+    mem_budget_bytes = budget; mem_base = reserved;
+    printf("System ready with %d locations and %d units.\n", rt_node_count(rg), unit_count);
     printf("Severity guide: 4-5 => Hospital/Ambulance | 3 => Police | 1-2 => Fire\n\n");
 
+    /* calls still pending when the last run died are dispatched along with the new ones */
     char cont = 'y'; int call_id = 1; int timestamp = 1;
+    int recovered = wal_open("calls");
+    if (recovered < 0) { rt_free(rg); return 1; }
+    for (int i = 1; i <= heap_size; ++i) {
+        if (heapQ[i].id >= call_id) call_id = heapQ[i].id + 1;
+        if (heapQ[i].time >= timestamp) timestamp = heapQ[i].time + 1;
+    }
+    if (recovered) printf("Recovered %d pending call(s) from the call log.\n\n", recovered);
+
     while (tolower((unsigned char)cont) == 'y') {
         struct Call c; c.id = call_id++;
-        printf("Enter location: ");
+        printf("Enter location (name or lat,lon): ");
         if (!fgets(c.loc, sizeof(c.loc), stdin)) break;
         c.loc[strcspn(c.loc, "\n")] = '\0';
         if (!c.loc[0]) { printf("Empty input — try again.\n"); continue; }
         printf("Enter severity (1-5): ");
-        if (scanf("%d", &c.sev) != 1) { printf("Invalid severity\n"); return 1; }
+        if (scanf("%d", &c.sev) != 1) { printf("Invalid severity\n"); wal_close(); rt_free(rg); return 1; }
         c.time = timestamp++;
         int ch = getchar(); (void)ch;
-        insert_call(c);
-        printf("Recorded: [%s] (severity %d)\n", c.loc, c.sev);
+        if (insert_call(c)) printf("Recorded: [%s] (severity %d)\n", c.loc, c.sev);
+        else printf("Not recorded: [%s] (queue full or no room in the call log)\n", c.loc);
         printf("Add another? (y/n): ");
         if (scanf(" %c", &cont) != 1) break;
         ch = getchar(); (void)ch;
     }
 
     printf("\nAutomatic dispatch starting...\n");
-    dispatch_all(g);
+    dispatch_all(rg);
 
     /* cleanup */
-    extmap_free(&emap);
-    for (int i = 0; i < g->V; ++i) {
-        Edge *e = g->nodes[i].adj;
-        while (e) { Edge *tmp = e; e = e->next; free(tmp); }
-    }
-    free(g);
+    wal_close();
+    rt_free(rg);
     return 0;
 }
@@ -0,0 +1,2617 @@
+/* routing.c
+   Routing core: graph storage and csv loaders, Dijkstra, customizable route planning,
+   spatial index, isochrones, route cache, ALT, hub labels, and the stable API declared in routing.h.
+   Compile:
+     gcc -std=c11 -O2 -pthread -c routing.c
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "routing_engine.h"
+#include "routing.h"
+
+#define LINEBUF 4096
+#define INITIAL_NODES 1024
+#define INITIAL_EDGES 16384
+
+
+static unsigned long long hash_u64(unsigned long long x){
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x = x ^ (x >> 31);
+    return x;
+}
+LLMap* llmap_create(int cap){
+    LLMap *m = malloc(sizeof(LLMap));
+    m->cap = 1; while (m->cap < cap) m->cap <<= 1;
+    m->table = calloc(m->cap, sizeof(LLMapEntry)); m->size = 0; return m;
+}
+void llmap_free(LLMap *m){ if(!m) return; free(m->table); free(m); }
+int llmap_find(LLMap *m, long long key){
+    unsigned long long h = hash_u64((unsigned long long)key);
+    int idx = (int)(h & (m->cap - 1));
+    while (m->table[idx].used){
+        if (m->table[idx].key == key) return m->table[idx].val;
+        idx = (idx + 1) & (m->cap - 1);
+    }
+    return -1;
+}
+void llmap_put(LLMap *m, long long key, int val){
+    if (m->size * 2 >= m->cap){
+        int newcap = m->cap * 2;
+        LLMapEntry *old = m->table; int oldcap = m->cap;
+        m->table = calloc(newcap, sizeof(LLMapEntry)); m->cap = newcap; m->size = 0;
+        for (int i=0;i<oldcap;i++) if (old[i].used){
+            unsigned long long h = hash_u64((unsigned long long)old[i].key);
+            int idx = (int)(h & (m->cap - 1));
+            while (m->table[idx].used) idx = (idx + 1) & (m->cap - 1);
+            m->table[idx].used = 1; m->table[idx].key = old[i].key; m->table[idx].val = old[i].val; m->size++;
+        }
+        free(old);
+    }
+    unsigned long long h = hash_u64((unsigned long long)key);
+    int idx = (int)(h & (m->cap - 1));
+    while (m->table[idx].used){
+        if (m->table[idx].key == key){ m->table[idx].val = val; return; }
+        idx = (idx + 1) & (m->cap - 1);
+    }
+    m->table[idx].used = 1; m->table[idx].key = key; m->table[idx].val = val; m->size++;
+}
+
+
+Graph* graph_create(int node_cap){
+    Graph *g = malloc(sizeof(Graph));
+    g->V = 0; g->node_cap = node_cap; g->edge_count = 0; g->edge_cap = INITIAL_EDGES; g->version = 1; g->shared_names = 0;
+    g->rev_off = g->rev_from = g->rev_edge = NULL; g->rev_edges = -1;
+    g->edges = malloc(sizeof(Edge) * g->edge_cap);
+    g->head = malloc(sizeof(int) * node_cap);
+    g->ext_id = malloc(sizeof(long long) * node_cap);
+    g->lat = malloc(sizeof(double) * node_cap); g->lon = malloc(sizeof(double) * node_cap);
+    g->name = malloc(sizeof(char*) * node_cap); g->type = malloc(sizeof(char*) * node_cap);
+    for (int i=0;i<node_cap;i++){ g->head[i] = -1; g->ext_id[i]=0; g->lat[i]=g->lon[i]=0.0; g->name[i]=NULL; g->type[i]=NULL; }
+    g->idmap = llmap_create(node_cap*2 + 16);
+    return g;
+}
+void graph_ensure_nodecap(Graph *g, int need){
+    if (need <= g->node_cap) return;
+    int cap = g->node_cap; while (need > cap) cap *= 2;
+    g->head = realloc(g->head, sizeof(int) * cap);
+    g->ext_id = realloc(g->ext_id, sizeof(long long) * cap);
+    g->lat = realloc(g->lat, sizeof(double) * cap); g->lon = realloc(g->lon, sizeof(double) * cap);
+    g->name = realloc(g->name, sizeof(char*) * cap); g->type = realloc(g->type, sizeof(char*) * cap);
+    for (int i=g->node_cap;i<cap;i++){ g->head[i] = -1; g->ext_id[i]=0; g->lat[i]=g->lon[i]=0.0; g->name[i]=NULL; g->type[i]=NULL; }
+    g->node_cap = cap;
+}
+int graph_add_node(Graph *g, long long ext, double lat, double lon, const char *name, const char *type){
+    int idx = g->V++; graph_ensure_nodecap(g, g->V);
+    g->ext_id[idx] = ext; g->lat[idx] = lat; g->lon[idx] = lon;
+    g->name[idx] = (name && strlen(name)) ? strdup(name) : NULL;
+    g->type[idx] = (type && strlen(type)) ? strdup(type) : NULL;
+    g->head[idx] = -1; llmap_put(g->idmap, ext, idx); return idx;
+}
+void graph_add_edge(Graph *g, int u, int v, double w, double length){
+    if (g->edge_count >= g->edge_cap){ g->edge_cap *= 2; g->edges = realloc(g->edges, sizeof(Edge) * g->edge_cap); }
+    int ei = g->edge_count++; g->edges[ei].to = v; g->edges[ei].weight = w; g->edges[ei].length = length; g->edges[ei].next = g->head[u]; g->head[u] = ei;
+    g->version++;
+}
+void graph_set_edge_weight(Graph *g, int e, double w){ if (e < 0 || e >= g->edge_count) return; g->edges[e].weight = w; g->version++; }
+/* deep copy of everything but the name/type strings, which the copy borrows; no reverse index */
+Graph* graph_clone(const Graph *src){
+    Graph *g = malloc(sizeof(Graph)); *g = *src;
+    int nc = src->node_cap;
+    g->head = malloc(sizeof(int)*nc); memcpy(g->head, src->head, sizeof(int)*nc);
+    g->ext_id = malloc(sizeof(long long)*nc); memcpy(g->ext_id, src->ext_id, sizeof(long long)*nc);
+    g->lat = malloc(sizeof(double)*nc); memcpy(g->lat, src->lat, sizeof(double)*nc);
+    g->lon = malloc(sizeof(double)*nc); memcpy(g->lon, src->lon, sizeof(double)*nc);
+    g->name = malloc(sizeof(char*)*nc); memcpy(g->name, src->name, sizeof(char*)*nc);
+    g->type = malloc(sizeof(char*)*nc); memcpy(g->type, src->type, sizeof(char*)*nc);
+    g->edges = malloc(sizeof(Edge)*src->edge_cap); memcpy(g->edges, src->edges, sizeof(Edge)*src->edge_count);
+    g->idmap = malloc(sizeof(LLMap)); *g->idmap = *src->idmap;
+    g->idmap->table = malloc(sizeof(LLMapEntry)*src->idmap->cap); memcpy(g->idmap->table, src->idmap->table, sizeof(LLMapEntry)*src->idmap->cap);
+    g->rev_off = g->rev_from = g->rev_edge = NULL; g->rev_edges = -1;
+    g->shared_names = 1;
+    return g;
+}
+int graph_get_or_create(Graph *g, long long ext){
+    int idx = llmap_find(g->idmap, ext); if (idx != -1) return idx;
+    return graph_add_node(g, ext, 0.0, 0.0, NULL, NULL);
+}
+void graph_free(Graph *g){
+    if (!g) return;
+    if (!g->shared_names) for (int i=0;i<g->V;i++){ if (g->name[i]) free(g->name[i]); if (g->type[i]) free(g->type[i]); }
+    free(g->head); free(g->ext_id); free(g->lat); free(g->lon); free(g->name); free(g->type);
+    free(g->edges); free(g->rev_off); free(g->rev_from); free(g->rev_edge); llmap_free(g->idmap); free(g);
+}
+
+
+void str_trim(char *s){ char *p=s; while(*p && (*p==' '||*p=='\t')) p++; if (p!=s) memmove(s,p,strlen(p)+1); int len=strlen(s); while(len>0 && (s[len-1]=='\r'||s[len-1]=='\n'||s[len-1]==' '||s[len-1]=='\t')) s[--len]=0; }
+void str_to_lower(const char *src, char *dst){ while (*src){ *dst = (char)tolower((unsigned char)*src); src++; dst++; } *dst = 0; }
+
+
+int node_matches_type_or_name(Graph *g, int idx, const char *requested){
+    if (!requested) return 0;
+    char rl[256]; str_to_lower(requested, rl);
+    if (g->type[idx]){
+        char t[256]; str_to_lower(g->type[idx], t);
+        if (strstr(t, rl)) return 1;
+    }
+    if (g->name[idx]){
+        char n[1024]; str_to_lower(g->name[idx], n);
+        if (strstr(n, rl)) return 1;
+    }
+    return 0;
+}
+
+int name_match_ci(const char *node_name, const char *query){ if (!node_name || !query) return 0; char a[1024], b[1024]; str_to_lower(node_name,a); str_to_lower(query,b); return strstr(a,b) != NULL; }
+int type_is_allowed(const char *type){ if (!type) return 0; char t[256]; str_to_lower(type,t); if (strstr(t,"hospital")!=NULL) return 1; if (strstr(t,"fire")!=NULL) return 1; if (strstr(t,"police")!=NULL) return 1; return 0; }
+int type_matches_requested(const char *type, const char *requested){ if (!type || !requested) return 0; char t[256], r[256]; str_to_lower(type,t); str_to_lower(requested,r); return strstr(t,r) != NULL; }
+
+
+/* doubling the node arrays by grow_nodes slots and the edge array by grow_edges would pass the budget */
+static int load_over_budget(const Graph *g, int grow_nodes, int grow_edges, const char *fname){
+    size_t b = mem_budget(); if (!b) return 0;
+    MemReport r = {0}; graph_memory(g, &r);
+    size_t grow = (size_t)grow_nodes * (sizeof(int) + sizeof(long long) + 2*sizeof(double) + 2*sizeof(char*)) + (size_t)grow_edges * sizeof(Edge);
+    if (mem_total(&r, NULL) + grow <= b) return 0;
+    fprintf(stderr, "%s: loading further would pass the memory budget of %zu bytes\n", fname, b);
+    mem_print(&r, stderr);
+    return 1;
+}
+
+int load_nodes(Graph *g, const char *fname){
+    FILE *f = fopen(fname,"r"); if (!f){ perror("open nodes.csv"); return -1; }
+    char line[LINEBUF];
+    if (!fgets(line, LINEBUF, f)){ fclose(f); return 0; } // header
+    while (fgets(line, LINEBUF, f)){
+        str_trim(line); if (strlen(line)==0) continue;
+        char *tok = strtok(line, ","); if (!tok) continue;
+        long long ext = atoll(tok); if (ext==0 && tok[0] != '0') continue;
+        tok = strtok(NULL, ","); double lat = tok ? atof(tok) : 0.0;
+        tok = strtok(NULL, ","); double lon = tok ? atof(tok) : 0.0;
+        tok = strtok(NULL, ","); char namebuf[1024] = ""; if (tok) { strncpy(namebuf, tok, 1023); namebuf[1023]=0; str_trim(namebuf); }
+        tok = strtok(NULL, ","); char typebuf[256] = ""; if (tok) { strncpy(typebuf, tok, 255); typebuf[255]=0; str_trim(typebuf); }
+        int idx = llmap_find(g->idmap, ext);
+        if (idx == -1 && g->V == g->node_cap && load_over_budget(g, g->node_cap, 0, fname)){ fclose(f); return -1; }
+        if (idx == -1) graph_add_node(g, ext, lat, lon, namebuf, typebuf);
+        else {
+            g->lat[idx]=lat; g->lon[idx]=lon;
+            if (g->name[idx]) free(g->name[idx]); if (strlen(namebuf)) g->name[idx]=strdup(namebuf); else g->name[idx]=NULL;
+            if (g->type[idx]) free(g->type[idx]); if (strlen(typebuf)) g->type[idx]=strdup(typebuf); else g->type[idx]=NULL;
+        }
+    }
+    fclose(f); return g->V;
+}
+int load_edges(Graph *g, const char *fname){
+    FILE *f = fopen(fname,"r"); if (!f){ perror("open edges.csv"); return -1; }
+    char line[LINEBUF];
+    if (!fgets(line, LINEBUF, f)){ fclose(f); return 0; } // header
+    int count=0;
+    while (fgets(line, LINEBUF, f)){
+        str_trim(line); if (strlen(line)==0) continue;
+        char *tok = strtok(line, ","); if (!tok) continue; // edge_id
+        tok = strtok(NULL, ","); if (!tok) continue; long long from = atoll(tok);
+        tok = strtok(NULL, ","); if (!tok) continue; long long to = atoll(tok);
+        tok = strtok(NULL, ","); double length = tok ? atof(tok) : 0.0;
+        tok = strtok(NULL, ","); double travel_time = tok ? atof(tok) : 0.0;
+        tok = strtok(NULL, ","); int one_way = tok ? atoi(tok) : 0;
+        if ((g->edge_count + 2 > g->edge_cap || g->V + 2 > g->node_cap) && load_over_budget(g, g->V + 2 > g->node_cap ? g->node_cap : 0, g->edge_count + 2 > g->edge_cap ? g->edge_cap : 0, fname)){ fclose(f); return -1; }
+        int u = graph_get_or_create(g, from);
+        int v = graph_get_or_create(g, to);
+        if (one_way) graph_add_edge(g, u, v, travel_time, length);
+        else { graph_add_edge(g, u, v, travel_time, length); graph_add_edge(g, v, u, travel_time, length); }
+        count++;
+    }
+    fclose(f); return count;
+}
+
+
+typedef struct { int node; double dist; } HNode;
+typedef struct { HNode *a; int size; int cap; } MinHeap;
+static MinHeap* heap_create(int cap){ MinHeap *h = malloc(sizeof(MinHeap)); h->cap = cap>16?cap:16; h->a = malloc(sizeof(HNode)*(h->cap+1)); h->size=0; return h;}
+static void heap_free(MinHeap *h){ if(!h) return; free(h->a); free(h); } static void heap_swap(HNode *x, HNode *y){ HNode t=*x; *x=*y; *y=t; }
+static void heap_push(MinHeap *h, int node, double dist){ if (h->size+1>h->cap){ h->cap*=2; h->a=realloc(h->a,sizeof(HNode)*(h->cap+1));} int i=++h->size; h->a[i].node=node; h->a[i].dist=dist; while(i>1){ int p=i>>1; if (h->a[p].dist<=h->a[i].dist) break; heap_swap(&h->a[p],&h->a[i]); i=p; } }
+static int heap_empty(MinHeap *h){ return h->size==0; } static HNode heap_pop(MinHeap *h){ HNode ret = h->a[1]; h->a[1]=h->a[h->size--]; int i=1; while(1){ int l=i<<1, r=l+1, s=i; if (l<=h->size && h->a[l].dist < h->a[s].dist) s=l; if (r<=h->size && h->a[r].dist < h->a[s].dist) s=r; if (s==i) break; heap_swap(&h->a[i], &h->a[s]); i=s; } return ret; }
+
+void dijkstra(Graph *g, int src, double *dist, int *parent){
+    int n = g->V; for (int i=0;i<n;i++){ dist[i]=INF; parent[i]=-1; } dist[src]=0.0;
+    MinHeap *pq = heap_create(n>16?n:16); heap_push(pq, src, 0.0); char *vis = calloc(n,1);
+    while (!heap_empty(pq)){
+        HNode hn = heap_pop(pq); int u = hn.node; double d = hn.dist;
+        if (d > dist[u]) continue; if (vis[u]) continue; vis[u]=1;
+        for (int e = g->head[u]; e!=-1; e = g->edges[e].next){
+            int v = g->edges[e].to; double w = g->edges[e].weight;
+            double nd = dist[u] + w;
+            if (nd < dist[v]){ dist[v] = nd; parent[v]=u; heap_push(pq, v, nd); }
+        }
+    }
+    free(vis); heap_free(pq);
+}
+
+
+int find_node_by_name(Graph *g, const char *query){
+    char qlow[1024]; str_to_lower(query, qlow);
+    for (int i=0;i<g->V;i++){
+        if (g->name[i]){
+            char lnm[1024]; str_to_lower(g->name[i], lnm);
+            if (strstr(lnm, qlow)) return i;
+        }
+    }
+    return -1;
+}
+
+
+int find_nearest_of_type_from(Graph *g, int start_idx, const char *requested_type){
+    if (!g || start_idx < 0 || start_idx >= g->V) return -1;
+    SearchWork *w = search_work_create(g->V);
+    int best_idx = nearest_of_type_query(g, w, start_idx, requested_type, NULL, NULL);
+    search_work_free(w);
+    return best_idx;
+}
+
+
+/* ---- integer weights: Dial's bucket queue ----
+   edges.csv travel times are whole seconds, so a one-to-all search can use maxw+1 circular
+   buckets instead of a comparison heap: every pending label lies in [cur, cur+maxw], so bucket
+   cur % (maxw+1) holds exactly the labels equal to cur. entries are never removed; a label
+   that has since improved is skipped when its bucket comes round. */
+static const char *queue_names[] = { "heap", "dial" };
+int queue_mode(const char *name){
+    for (int m=0; m<(int)(sizeof(queue_names)/sizeof(queue_names[0])); m++) if (strcmp(name, queue_names[m]) == 0) return m;
+    return -1;
+}
+
+IntGraph* intgraph_build(Graph *g){
+    unsigned maxw = 0;
+    for (int e=0;e<g->edge_count;e++){
+        double w = g->edges[e].weight;
+        if (!(w >= 0) || w > DIAL_MAX_WEIGHT || w != floor(w)) return NULL;
+        if ((unsigned)w > maxw) maxw = (unsigned)w;
+    }
+    IntGraph *ig = malloc(sizeof(IntGraph)); int n = g->V, m = g->edge_count;
+    ig->n = n; ig->maxw = maxw; ig->version = g->version;
+    ig->off = malloc(sizeof(int)*(n+1)); ig->to = malloc(sizeof(int)*(m>0?m:1)); ig->w = malloc(sizeof(unsigned)*(m>0?m:1));
+    int k = 0;
+    for (int u=0;u<n;u++){ ig->off[u] = k; for (int e=g->head[u]; e!=-1; e=g->edges[e].next){ ig->to[k] = g->edges[e].to; ig->w[k++] = (unsigned)g->edges[e].weight; } }
+    ig->off[n] = k;
+    return ig;
+}
+void intgraph_free(IntGraph *ig){ if (!ig) return; free(ig->off); free(ig->to); free(ig->w); free(ig); }
+
+void dial_dijkstra(const IntGraph *ig, int src, unsigned *dist, int *parent){
+    int n = ig->n, m = ig->off[n]; unsigned C = ig->maxw + 1;
+    for (int i=0;i<n;i++){ dist[i] = UINF; parent[i] = -1; }
+    /* bucket lists share one entry pool: a label is only pushed when it improves, so at most m+1 */
+    int *bhead = malloc(sizeof(int)*C), *enode = malloc(sizeof(int)*(m+1)), *enext = malloc(sizeof(int)*(m+1)), used = 0;
+    for (unsigned b=0;b<C;b++) bhead[b] = -1;
+    dist[src] = 0; enode[0] = src; enext[0] = -1; bhead[0] = 0; used = 1;
+    long long pending = 1;
+    for (unsigned cur = 0; pending; cur++){
+        unsigned b = cur % C;
+        while (bhead[b] != -1){
+            int x = bhead[b], u = enode[x]; bhead[b] = enext[x]; pending--;
+            if (dist[u] != cur) continue;
+            for (int i=ig->off[u]; i<ig->off[u+1]; i++){
+                int v = ig->to[i]; unsigned nd = cur + ig->w[i];
+                if (nd < dist[v]){ dist[v] = nd; parent[v] = u; unsigned nb = nd % C; enode[used] = v; enext[used] = bhead[nb]; bhead[nb] = used++; pending++; }
+            }
+        }
+    }
+    free(bhead); free(enode); free(enext);
+}
+
+/* one-to-all with the chosen queue; the heap is used whenever the integer copy is missing or stale */
+void shortest_all(Graph *g, const IntGraph *ig, int mode, int src, double *dist, int *parent){
+    if (mode != QUEUE_DIAL || !ig || ig->version != g->version){ dijkstra(g, src, dist, parent); return; }
+    unsigned *d = malloc(sizeof(unsigned)*(g->V>0?g->V:1));
+    dial_dijkstra(ig, src, d, parent);
+    for (int i=0;i<g->V;i++) dist[i] = d[i] == UINF ? INF : (double)d[i];
+    free(d);
+}
+
+
+
+/* ---- multi-metric routing: time and length side by side, one kernel per order ----
+   metric_search is always inlined with the ranking metric and the tie-break flag as constants,
+   so each of the ORDER_COUNT kernels reads its metric at a fixed offset and only the
+   lexicographic ones contain the tie comparison; the order is picked once per query through
+   metric_kernels. labels are (first, second) pairs of integer sums, and with non-negative roads
+   lexicographic pairs settle in order just like plain distances, so "fastest, then shortest
+   among the fastest" is one search. the second sum is carried along in every kernel, so a
+   fastest route also knows its length. */
+static const char *order_names[] = { "time", "length", "time,length", "length,time" };
+int route_order(const char *name){
+    for (int o=0; o<ORDER_COUNT; o++) if (strcmp(name, order_names[o]) == 0) return o;
+    return -1;
+}
+const char* route_order_name(int order){ return order >= 0 && order < ORDER_COUNT ? order_names[order] : "?"; }
+
+static unsigned metric_units(double v, double scale){ double x = round(v * scale); return !(x > 0) ? 0 : x >= 4294967295.0 ? 4294967295u : (unsigned)x; }
+MetricGraph* metricgraph_build(const Graph *g){
+    MetricGraph *mg = malloc(sizeof(MetricGraph)); int n = g->V, m = g->edge_count;
+    mg->n = n; mg->version = g->version;
+    mg->off = malloc(sizeof(int)*(n+1)); mg->e = malloc(sizeof(MetricEdge)*(m>0?m:1));
+    int k = 0;
+    for (int u=0;u<n;u++){
+        mg->off[u] = k;
+        for (int e=g->head[u]; e!=-1; e=g->edges[e].next){ MetricEdge *x = &mg->e[k++]; x->to = g->edges[e].to; x->w[METRIC_TIME] = metric_units(g->edges[e].weight, 1000); x->w[METRIC_LENGTH] = metric_units(g->edges[e].length, 100); }
+    }
+    mg->off[n] = k;
+    return mg;
+}
+void metricgraph_free(MetricGraph *mg){ if (!mg) return; free(mg->off); free(mg->e); free(mg); }
+size_t metricgraph_bytes(const MetricGraph *mg){ return mg ? mem_block(sizeof(MetricGraph)) + mem_block(sizeof(int)*((size_t)mg->n+1)) + mem_block(sizeof(MetricEdge)*(size_t)(mg->off[mg->n] > 0 ? mg->off[mg->n] : 1)) : 0; }
+
+#define MUNSEEN 0xffffffffffffffffULL
+/* lazy binary heap of (k1, k2, node) entries carrying their keys, so sifting never leaves the
+   heap array; a popped entry whose keys no longer match the node's is stale and skipped. the
+   per-node arrays are reset lazily through the touched list, like SearchWork. */
+typedef struct { unsigned long long k1, k2; int v; } MetricEntry;
+struct MetricWork { int cap, hsize, hcap, ntouched; unsigned long long *k1, *k2; int *par, *touched; char *done; MetricEntry *heap; };
+MetricWork* metric_work_create(int n){
+    MetricWork *w = malloc(sizeof(MetricWork)); int c = n > 0 ? n : 1;
+    w->cap = n; w->hsize = w->ntouched = 0; w->hcap = c;
+    w->k1 = malloc(sizeof(unsigned long long)*c); w->k2 = malloc(sizeof(unsigned long long)*c);
+    w->par = malloc(sizeof(int)*c); w->touched = malloc(sizeof(int)*c); w->done = calloc(c, 1); w->heap = malloc(sizeof(MetricEntry)*c);
+    for (int i=0;i<n;i++){ w->k1[i] = w->k2[i] = MUNSEEN; w->par[i] = -1; }
+    return w;
+}
+void metric_work_free(MetricWork *w){ if (!w) return; free(w->k1); free(w->k2); free(w->par); free(w->touched); free(w->done); free(w->heap); free(w); }
+size_t metric_work_bytes(int n){ size_t c = n > 0 ? n : 1; return mem_block(sizeof(MetricWork)) + 2*mem_block(sizeof(unsigned long long)*c) + 2*mem_block(sizeof(int)*c) + mem_block(c) + mem_block(sizeof(MetricEntry)*c); }
+static void metric_work_reset(MetricWork *w){
+    for (int i=0;i<w->ntouched;i++){ int v = w->touched[i]; w->k1[v] = w->k2[v] = MUNSEEN; w->par[v] = -1; w->done[v] = 0; }
+    w->ntouched = 0; w->hsize = 0;
+}
+
+#define ME_LESS(a, b, lex) ((a).k1 < (b).k1 || ((lex) && (a).k1 == (b).k1 && (a).k2 < (b).k2))
+static inline __attribute__((always_inline)) void mw_push(MetricWork *w, unsigned long long k1, unsigned long long k2, int v, const int lex){
+    if (w->hsize == w->hcap){ w->hcap *= 2; w->heap = realloc(w->heap, sizeof(MetricEntry)*w->hcap); }
+    MetricEntry x = { k1, k2, v }; int i = w->hsize++;
+    while (i > 0){ int p = (i-1)>>1; if (!ME_LESS(x, w->heap[p], lex)) break; w->heap[i] = w->heap[p]; i = p; }
+    w->heap[i] = x;
+}
+static inline __attribute__((always_inline)) MetricEntry mw_pop(MetricWork *w, const int lex){
+    MetricEntry top = w->heap[0], x = w->heap[--w->hsize]; int i = 0, n = w->hsize;
+    while (1){
+        int l = 2*i+1, s = l; if (l >= n) break;
+        if (l+1 < n && ME_LESS(w->heap[l+1], w->heap[l], lex)) s = l+1;
+        if (!ME_LESS(w->heap[s], x, lex)) break;
+        w->heap[i] = w->heap[s]; i = s;
+    }
+    if (n) w->heap[i] = x;
+    return top;
+}
+static inline __attribute__((always_inline)) void mw_start(MetricWork *w, int src){
+    metric_work_reset(w);
+    w->k1[src] = w->k2[src] = 0; w->touched[w->ntouched++] = src; w->heap[0] = (MetricEntry){ 0, 0, src }; w->hsize = 1;
+}
+/* m1 ranks, the other metric is summed alongside and breaks ties when lex */
+static inline __attribute__((always_inline)) int metric_search(const MetricGraph *mg, MetricWork *w, int src, int dst, const int m1, const int lex){
+    const int m2 = 1 - m1;
+    mw_start(w, src);
+    while (w->hsize){
+        MetricEntry x = mw_pop(w, lex); int u = x.v;
+        if (w->done[u] || x.k1 != w->k1[u] || x.k2 != w->k2[u]) continue;
+        w->done[u] = 1;
+        if (u == dst) return 1;
+        for (int i=mg->off[u]; i<mg->off[u+1]; i++){
+            const MetricEdge *e = &mg->e[i]; int v = e->to;
+            unsigned long long a = x.k1 + e->w[m1], b = x.k2 + e->w[m2];
+            if (!(a < w->k1[v] || (lex && a == w->k1[v] && b < w->k2[v]))) continue;
+            if (w->k1[v] == MUNSEEN) w->touched[w->ntouched++] = v;
+            w->k1[v] = a; w->k2[v] = b; w->par[v] = u;
+            mw_push(w, a, b, v, lex);
+        }
+    }
+    return dst == -1;
+}
+typedef int (*MetricKernel)(const MetricGraph*, MetricWork*, int, int);
+static int metric_search_time(const MetricGraph *mg, MetricWork *w, int s, int t){ return metric_search(mg, w, s, t, METRIC_TIME, 0); }
+static int metric_search_length(const MetricGraph *mg, MetricWork *w, int s, int t){ return metric_search(mg, w, s, t, METRIC_LENGTH, 0); }
+static int metric_search_time_length(const MetricGraph *mg, MetricWork *w, int s, int t){ return metric_search(mg, w, s, t, METRIC_TIME, 1); }
+static int metric_search_length_time(const MetricGraph *mg, MetricWork *w, int s, int t){ return metric_search(mg, w, s, t, METRIC_LENGTH, 1); }
+static const MetricKernel metric_kernels[ORDER_COUNT] = { metric_search_time, metric_search_length, metric_search_time_length, metric_search_length_time };
+static const int order_first[ORDER_COUNT] = { METRIC_TIME, METRIC_LENGTH, METRIC_TIME, METRIC_LENGTH };
+
+static int metric_finish(const MetricWork *w, int first, int dst, double *time, double *length, int *path, int *path_len){
+    if (path_len) *path_len = 0;
+    if (time) *time = INF;
+    if (length) *length = INF;
+    if (dst < 0 || w->k1[dst] == MUNSEEN) return 0;
+    unsigned long long t = first == METRIC_TIME ? w->k1[dst] : w->k2[dst], l = first == METRIC_TIME ? w->k2[dst] : w->k1[dst];
+    if (time) *time = t / 1000.0;
+    if (length) *length = l / 100.0;
+    if (path){
+        int len = 0; for (int v=dst; v!=-1; v=w->par[v]) path[len++] = v;
+        for (int i=0, j=len-1; i<j; i++, j--){ int x = path[i]; path[i] = path[j]; path[j] = x; }
+        if (path_len) *path_len = len;
+    }
+    return 1;
+}
+int metric_route(const MetricGraph *mg, MetricWork *w, RouteOrder order, int src, int dst, double *time, double *length, int *path, int *path_len){
+    if (order < 0 || order >= ORDER_COUNT || src < 0 || src >= mg->n || dst >= mg->n) return 0;
+    metric_kernels[order](mg, w, src, dst);
+    return metric_finish(w, order_first[order], dst, time, length, path, path_len);
+}
+
+int metric_route_two_pass(const MetricGraph *mg, MetricWork *w, RouteOrder order, int src, int dst, double *time, double *length, int *path, int *path_len){
+    if (order != ORDER_TIME_LENGTH && order != ORDER_LENGTH_TIME) return metric_route(mg, w, order, src, dst, time, length, path, path_len);
+    if (src < 0 || src >= mg->n || dst < 0 || dst >= mg->n) return 0;
+    int m1 = order_first[order], m2 = 1 - m1, n = mg->n;
+    metric_kernels[m1 == METRIC_TIME ? ORDER_TIME : ORDER_LENGTH](mg, w, src, -1);
+    unsigned long long *best = malloc(sizeof(unsigned long long)*(n>0?n:1)), bound = w->k1[dst];
+    for (int v=0;v<n;v++) best[v] = w->k1[v];
+    if (bound == MUNSEEN){ free(best); return metric_finish(w, m1, -1, time, length, path, path_len); }
+    /* second pass: plain search on m2 over tight roads only */
+    MetricWork *x = w; mw_start(x, src);
+    while (x->hsize){
+        MetricEntry top = mw_pop(x, 0); int u = top.v;
+        if (x->done[u] || top.k1 != x->k1[u]) continue;
+        x->done[u] = 1;
+        if (u == dst) break;
+        for (int i=mg->off[u]; i<mg->off[u+1]; i++){
+            const MetricEdge *e = &mg->e[i]; int v = e->to;
+            if (best[u] + e->w[m1] != best[v] || best[v] > bound) continue;
+            unsigned long long a = top.k1 + e->w[m2];
+            if (a >= x->k1[v]) continue;
+            if (x->k1[v] == MUNSEEN) x->touched[x->ntouched++] = v;
+            x->k1[v] = a; x->k2[v] = best[v]; x->par[v] = u;
+            mw_push(x, a, best[v], v, 0);
+        }
+    }
+    free(best);
+    return metric_finish(x, m2, dst, time, length, path, path_len);
+}
+
+
+
+/* ---- customizable route planning: multi-level partition + overlay cliques ---- */
+double now_sec(void){ struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); return ts.tv_sec + ts.tv_nsec * 1e-9; }
+int default_threads(void){ long n = sysconf(_SC_NPROCESSORS_ONLN); return n > 0 ? (int)n : 1; }
+
+/* unit-capacity max flow (Dinic) on the undirected subgraph induced by nodes[], used by inertial flow */
+typedef struct { int *head, *to, *cap, *next, *lvl, *it, *q, *stk; int n, m, mcap; } FlowNet;
+static void flow_arc(FlowNet *f, int u, int v, int c){
+    if (f->m + 2 > f->mcap){ f->mcap *= 2; f->to = realloc(f->to, sizeof(int)*f->mcap); f->cap = realloc(f->cap, sizeof(int)*f->mcap); f->next = realloc(f->next, sizeof(int)*f->mcap); }
+    f->to[f->m]=v; f->cap[f->m]=c; f->next[f->m]=f->head[u]; f->head[u]=f->m++;
+    f->to[f->m]=u; f->cap[f->m]=c; f->next[f->m]=f->head[v]; f->head[v]=f->m++;
+}
+static int flow_bfs(FlowNet *f, int s, int t){
+    for (int i=0;i<f->n;i++) f->lvl[i] = -1;
+    int qh=0, qt=0; f->q[qt++] = s; f->lvl[s] = 0;
+    while (qh<qt){ int u = f->q[qh++]; if (f->lvl[t] >= 0 && f->lvl[u] >= f->lvl[t]) break; for (int a=f->head[u]; a!=-1; a=f->next[a]) if (f->cap[a]>0 && f->lvl[f->to[a]]<0){ f->lvl[f->to[a]] = f->lvl[u]+1; f->q[qt++] = f->to[a]; } }
+    return f->lvl[t] >= 0;
+}
+static int flow_augment(FlowNet *f, int s, int t){
+    /* iterative DFS over the level graph; stk holds the arcs of the current path */
+    int top = 0, u = s;
+    while (1){
+        if (u == t){
+            int bott = INT_MAX; for (int i=0;i<top;i++) if (f->cap[f->stk[i]] < bott) bott = f->cap[f->stk[i]];
+            for (int i=0;i<top;i++){ f->cap[f->stk[i]] -= bott; f->cap[f->stk[i]^1] += bott; }
+            return bott;
+        }
+        int a = f->it[u];
+        while (a != -1 && !(f->cap[a] > 0 && f->lvl[f->to[a]] == f->lvl[u]+1)) a = f->next[a];
+        f->it[u] = a;
+        if (a != -1){ f->stk[top++] = a; u = f->to[a]; continue; }
+        f->lvl[u] = -1;
+        if (top == 0) return 0;
+        u = f->to[f->stk[--top]^1]; f->it[u] = f->next[f->it[u]];
+    }
+}
+
+typedef struct { int idx; double key; } ProjItem;
+static int proj_cmp(const void *a, const void *b){ double x = ((const ProjItem*)a)->key, y = ((const ProjItem*)b)->key; return (x>y) - (x<y); }
+
+/* split nodes[0..cnt) into two halves along the cheapest of four lat/lon directions; returns the size of side 0
+   and reorders nodes[] so that side 0 comes first. loc[] maps global -> local index and must be -1 on entry/exit. */
+static int crp_bisect(Graph *g, int *nodes, int cnt, int *loc){
+    static const double dirs[4][2] = { {1,0}, {0,1}, {0.7071,0.7071}, {0.7071,-0.7071} };
+    double lat0 = 0; for (int i=0;i<cnt;i++) lat0 += g->lat[nodes[i]]; lat0 /= cnt;
+    double lonscale = cos(lat0 * 3.14159265358979323846 / 180.0);
+    for (int i=0;i<cnt;i++) loc[nodes[i]] = i;
+    ProjItem *pi = malloc(sizeof(ProjItem) * cnt);
+    char *best_side = malloc(cnt), *side = malloc(cnt);
+    int best_cut = INT_MAX, best_bal = INT_MAX, best_n0 = cnt/2;
+    FlowNet f; f.n = cnt + 2; f.mcap = 1024; f.m = 0;
+    f.head = malloc(sizeof(int)*f.n); f.to = malloc(sizeof(int)*f.mcap); f.cap = malloc(sizeof(int)*f.mcap); f.next = malloc(sizeof(int)*f.mcap);
+    f.lvl = malloc(sizeof(int)*f.n); f.it = malloc(sizeof(int)*f.n); f.q = malloc(sizeof(int)*f.n); f.stk = malloc(sizeof(int)*f.n);
+    int S = cnt, T = cnt + 1, k = cnt / 4 > 0 ? cnt / 4 : 1;
+    for (int d=0; d<4; d++){
+        for (int i=0;i<cnt;i++){ pi[i].idx = i; pi[i].key = g->lat[nodes[i]]*dirs[d][0] + g->lon[nodes[i]]*lonscale*dirs[d][1]; }
+        qsort(pi, cnt, sizeof(ProjItem), proj_cmp);
+        for (int i=0;i<f.n;i++) f.head[i] = -1;
+        f.m = 0;
+        for (int i=0;i<cnt;i++) for (int e=g->head[nodes[i]]; e!=-1; e=g->edges[e].next){ int j = loc[g->edges[e].to]; if (j >= 0 && j != i) flow_arc(&f, i, j, 1); }
+        for (int i=0;i<k;i++){ flow_arc(&f, S, pi[i].idx, cnt); flow_arc(&f, pi[cnt-1-i].idx, T, cnt); }
+        int flow = 0;
+        while (flow < best_cut && flow_bfs(&f, S, T)){ for (int i=0;i<f.n;i++) f.it[i] = f.head[i]; int a; while ((a = flow_augment(&f, S, T)) > 0) flow += a; }
+        if (flow > best_cut) continue;
+        flow_bfs(&f, S, T); /* residual reachability from S is the source side of the min cut */
+        int n0 = 0; for (int i=0;i<cnt;i++){ side[i] = f.lvl[i] >= 0 ? 0 : 1; n0 += !side[i]; }
+        int bal = abs(2*n0 - cnt);
+        if (n0 == 0 || n0 == cnt) continue;
+        if (flow < best_cut || bal < best_bal){ best_cut = flow; best_bal = bal; best_n0 = n0; memcpy(best_side, side, cnt); }
+    }
+    if (best_cut == INT_MAX){ for (int i=0;i<cnt;i++) best_side[pi[i].idx] = i >= cnt/2; best_n0 = cnt/2; }
+    int *tmp = malloc(sizeof(int)*cnt); int a = 0, b = best_n0;
+    for (int i=0;i<cnt;i++){ if (best_side[i]) tmp[b++] = nodes[i]; else tmp[a++] = nodes[i]; }
+    for (int i=0;i<cnt;i++){ loc[nodes[i]] = -1; nodes[i] = tmp[i]; }
+    free(tmp); free(pi); free(best_side); free(side);
+    free(f.head); free(f.to); free(f.cap); free(f.next); free(f.lvl); free(f.it); free(f.q); free(f.stk);
+    return best_n0;
+}
+static void crp_partition_rec(Graph *g, int *nodes, int cnt, int maxsize, int *cell, int *ncells, int *loc){
+    if (cnt <= maxsize){ for (int i=0;i<cnt;i++) cell[nodes[i]] = *ncells; (*ncells)++; return; }
+    int n0 = crp_bisect(g, nodes, cnt, loc);
+    crp_partition_rec(g, nodes, n0, maxsize, cell, ncells, loc);
+    crp_partition_rec(g, nodes + n0, cnt - n0, maxsize, cell, ncells, loc);
+}
+
+/* builds the nested partition and boundary lists; cell_size[l] is the max cell size of level l (ascending) */
+Crp* crp_build(Graph *g, int levels, const int *cell_size){
+    levels = levels < 1 ? 1 : levels > CRP_MAX_LEVELS ? CRP_MAX_LEVELS : levels;
+    Crp *c = calloc(1, sizeof(Crp)); c->levels = levels; c->n = g->V;
+    int n = g->V, *loc = malloc(sizeof(int)*(n>0?n:1)), *nodes = malloc(sizeof(int)*(n>0?n:1));
+    for (int i=0;i<n;i++){ loc[i] = -1; nodes[i] = i; }
+    for (int l=levels-1; l>=0; l--){
+        c->cell[l] = malloc(sizeof(int)*(n>0?n:1)); c->ncells[l] = 0;
+        if (l == levels-1){ crp_partition_rec(g, nodes, n, cell_size[l], c->cell[l], &c->ncells[l], loc); continue; }
+        /* refine each parent cell; nodes[] is grouped by parent cell after a stable counting pass */
+        int pc = c->ncells[l+1], *cnt = calloc(pc+1, sizeof(int));
+        for (int i=0;i<n;i++) cnt[c->cell[l+1][i]+1]++;
+        for (int i=0;i<pc;i++) cnt[i+1] += cnt[i];
+        int *pos = malloc(sizeof(int)*(pc+1)); memcpy(pos, cnt, sizeof(int)*(pc+1));
+        for (int i=0;i<n;i++) nodes[pos[c->cell[l+1][i]]++] = i;
+        for (int p=0;p<pc;p++) crp_partition_rec(g, nodes + cnt[p], cnt[p+1]-cnt[p], cell_size[l], c->cell[l], &c->ncells[l], loc);
+        free(cnt); free(pos);
+    }
+    for (int l=0; l<levels; l++){
+        int nc = c->ncells[l], *cl = c->cell[l];
+        char *isb = calloc(n>0?n:1, 1);
+        for (int u=0;u<n;u++) for (int e=g->head[u]; e!=-1; e=g->edges[e].next){ int v = g->edges[e].to; if (cl[u] != cl[v]){ isb[u] = 1; isb[v] = 1; } }
+        c->bnd_off[l] = calloc(nc+1, sizeof(int)); c->bnd_pos[l] = malloc(sizeof(int)*(n>0?n:1));
+        for (int u=0;u<n;u++) if (isb[u]) c->bnd_off[l][cl[u]+1]++;
+        for (int i=0;i<nc;i++) c->bnd_off[l][i+1] += c->bnd_off[l][i];
+        c->bnd[l] = malloc(sizeof(int)*(c->bnd_off[l][nc]+1));
+        int *fill = calloc(nc, sizeof(int));
+        for (int u=0;u<n;u++){ c->bnd_pos[l][u] = -1; if (isb[u]){ int p = fill[cl[u]]++; c->bnd_pos[l][u] = p; c->bnd[l][c->bnd_off[l][cl[u]] + p] = u; } }
+        c->clq_off[l] = malloc(sizeof(long long)*(nc+1)); c->clq_off[l][0] = 0;
+        for (int i=0;i<nc;i++){ long long b = c->bnd_off[l][i+1] - c->bnd_off[l][i]; c->clq_off[l][i+1] = c->clq_off[l][i] + b*b; }
+        c->clq[l] = malloc(sizeof(double)*(c->clq_off[l][nc]+1));
+        free(fill); free(isb);
+    }
+    free(loc); free(nodes);
+    return c;
+}
+void crp_free(Crp *c){
+    if (!c) return;
+    for (int l=0;l<c->levels;l++){ free(c->cell[l]); free(c->bnd_off[l]); free(c->bnd[l]); free(c->bnd_pos[l]); free(c->clq_off[l]); free(c->clq[l]); }
+    free(c);
+}
+
+SearchWork* search_work_create(int n){
+    SearchWork *w = malloc(sizeof(SearchWork)); int m = n>0?n:1;
+    w->dist = malloc(sizeof(double)*m); w->par = malloc(sizeof(int)*m); w->plvl = malloc(m);
+    w->touched = malloc(sizeof(int)*m); w->heap = malloc(sizeof(int)*m); w->pos = malloc(sizeof(int)*m);
+    w->ntouched = 0; w->hsize = 0;
+    for (int i=0;i<n;i++){ w->dist[i] = INF; w->par[i] = -1; w->pos[i] = -1; }
+    return w;
+}
+void search_work_free(SearchWork *w){ if (!w) return; free(w->dist); free(w->par); free(w->plvl); free(w->touched); free(w->heap); free(w->pos); free(w); }
+void search_work_reset(SearchWork *w){ for (int i=0;i<w->ntouched;i++){ int v = w->touched[i]; w->dist[v] = INF; w->par[v] = -1; w->pos[v] = -1; } w->ntouched = 0; w->hsize = 0; }
+int nearest_of_type_query(Graph *g, SearchWork *w, int src, const char *requested, int (*progress)(void *ctx, int settled, int total), void *ctx){
+    search_work_reset(w); sw_relax(w, src, 0.0, -1, -1);
+    int settled = 0;
+    while (w->hsize){
+        int u = sw_heap_pop(w); double du = w->dist[u];
+        if (node_matches_type_or_name(g, u, requested)) return u;
+        if (progress && (++settled & 255) == 0 && progress(ctx, settled, g->V)) return -1;
+        for (int e=g->head[u]; e!=-1; e=g->edges[e].next) sw_relax(w, g->edges[e].to, du + g->edges[e].weight, u, -1);
+    }
+    return -1;
+}
+
+/* distances between the boundary nodes of one cell, over original edges (level 0) or the level below */
+static void crp_customize_cell(Crp *c, Graph *g, int l, int cellid, SearchWork *w){
+    int b0 = c->bnd_off[l][cellid], b = c->bnd_off[l][cellid+1] - b0;
+    double *out = c->clq[l] + c->clq_off[l][cellid];
+    const int *cl = c->cell[l];
+    for (int i=0;i<b;i++){
+        search_work_reset(w);
+        sw_relax(w, c->bnd[l][b0+i], 0.0, -1, -1);
+        while (w->hsize){
+            int u = sw_heap_pop(w); double du = w->dist[u];
+            if (l == 0){
+                for (int e=g->head[u]; e!=-1; e=g->edges[e].next){ int v = g->edges[e].to; if (cl[v] == cellid) sw_relax(w, v, du + g->edges[e].weight, u, -1); }
+            } else {
+                int sl = l-1, sc = c->cell[sl][u], sb0 = c->bnd_off[sl][sc], sb = c->bnd_off[sl][sc+1] - sb0, p = c->bnd_pos[sl][u];
+                const double *row = c->clq[sl] + c->clq_off[sl][sc] + (long long)p*sb;
+                for (int j=0;j<sb;j++) if (row[j] < INF) sw_relax(w, c->bnd[sl][sb0+j], du + row[j], u, sl);
+                for (int e=g->head[u]; e!=-1; e=g->edges[e].next){ int v = g->edges[e].to; if (cl[v] == cellid && c->cell[sl][v] != sc) sw_relax(w, v, du + g->edges[e].weight, u, -1); }
+            }
+        }
+        for (int j=0;j<b;j++) out[(long long)i*b + j] = w->dist[c->bnd[l][b0+j]];
+    }
+}
+
+typedef struct { Crp *c; Graph *g; int level; int next; pthread_mutex_t mu; } CrpJob;
+static void* crp_customize_worker(void *arg){
+    CrpJob *job = arg; SearchWork *w = search_work_create(job->g->V);
+    while (1){
+        pthread_mutex_lock(&job->mu); int cellid = job->next++; pthread_mutex_unlock(&job->mu);
+        if (cellid >= job->c->ncells[job->level]) break;
+        crp_customize_cell(job->c, job->g, job->level, cellid, w);
+    }
+    search_work_free(w); return NULL;
+}
+/* recomputes every clique from the current edge weights; levels run bottom-up, cells of a level in parallel */
+void crp_customize(Crp *c, Graph *g, int threads){
+    if (threads < 1) threads = 1;
+    pthread_t *tid = malloc(sizeof(pthread_t)*threads);
+    for (int l=0; l<c->levels; l++){
+        CrpJob job = { c, g, l, 0, PTHREAD_MUTEX_INITIALIZER };
+        for (int i=0;i<threads;i++) pthread_create(&tid[i], NULL, crp_customize_worker, &job);
+        for (int i=0;i<threads;i++) pthread_join(tid[i], NULL);
+        pthread_mutex_destroy(&job.mu);
+    }
+    free(tid);
+}
+
+/* highest level whose cell of u contains neither s nor t; -1 means search the original edges */
+static inline int crp_query_level(const Crp *c, int u, int s, int t){
+    for (int l=c->levels-1; l>=0; l--){ int cu = c->cell[l][u]; if (cu != c->cell[l][s] && cu != c->cell[l][t]) return l; }
+    return -1;
+}
+
+/* expands a clique shortcut u->v of level l into original nodes, appended to out[] (u excluded) */
+static int crp_unpack(Crp *c, Graph *g, int l, int u, int v, SearchWork *w, int *out, int len){
+    int cellid = c->cell[l][u];
+    search_work_reset(w); sw_relax(w, u, 0.0, -1, -1);
+    while (w->hsize){
+        int x = sw_heap_pop(w); double dx = w->dist[x];
+        if (x == v) break;
+        for (int e=g->head[x]; e!=-1; e=g->edges[e].next){ int y = g->edges[e].to; if (c->cell[l][y] == cellid) sw_relax(w, y, dx + g->edges[e].weight, x, -1); }
+    }
+    int start = len;
+    for (int x = v; x != u && x != -1; x = w->par[x]) out[len++] = x;
+    for (int i=start, j=len-1; i<j; i++, j--){ int t = out[i]; out[i] = out[j]; out[j] = t; }
+    return len;
+}
+
+/* point-to-point query over the overlay; fills path[] (capacity g->V) when given and returns the distance.
+   shortcuts are unpacked with uw, a second workspace that must be given along with path */
+double crp_query(Crp *c, Graph *g, int s, int t, SearchWork *w, SearchWork *uw, int *path, int *path_len){
+    search_work_reset(w);
+    sw_relax(w, s, 0.0, -1, -1);
+    while (w->hsize){
+        int u = sw_heap_pop(w); double du = w->dist[u];
+        if (u == t) break;
+        int l = crp_query_level(c, u, s, t);
+        if (l < 0){
+            for (int e=g->head[u]; e!=-1; e=g->edges[e].next) sw_relax(w, g->edges[e].to, du + g->edges[e].weight, u, -1);
+            continue;
+        }
+        int cu = c->cell[l][u], b0 = c->bnd_off[l][cu], b = c->bnd_off[l][cu+1] - b0;
+        const double *row = c->clq[l] + c->clq_off[l][cu] + (long long)c->bnd_pos[l][u]*b;
+        for (int j=0;j<b;j++) if (row[j] < INF) sw_relax(w, c->bnd[l][b0+j], du + row[j], u, l);
+        for (int e=g->head[u]; e!=-1; e=g->edges[e].next){ int v = g->edges[e].to; if (c->cell[l][v] != cu) sw_relax(w, v, du + g->edges[e].weight, u, -1); }
+    }
+    double d = w->dist[t];
+    if (path && path_len){
+        *path_len = 0;
+        if (d < INF){
+            int hops = 0; for (int x = t; x != -1; x = w->par[x]) hops++;
+            int *seq = calloc(hops, sizeof(int)); signed char *lv = malloc(hops);
+            for (int x = t, i = hops-1; x != -1; x = w->par[x], i--){ seq[i] = x; lv[i] = w->plvl[x]; }
+            int len = 0; path[len++] = seq[0];
+            for (int i=1;i<hops;i++){ if (lv[i] < 0) path[len++] = seq[i]; else len = crp_unpack(c, g, lv[i], seq[i-1], seq[i], uw, path, len); }
+            free(seq); free(lv);
+            *path_len = len;
+        }
+    }
+    return d;
+}
+
+
+/* ---- region shards: the graph cut into geographic regions, one per worker process ----
+   the regions come from the same inertial-flow bisection as the CRP partition, halved until there
+   are k of them (k a power of two keeps them even). each region is written as its own nodes.csv /
+   edges.csv pair with every road inside it, so a worker loads it with the usual loaders; the roads
+   between regions go to overlay.csv, whose endpoints are the regions' boundary nodes. */
+static void shard_split_rec(Graph *g, int *nodes, int cnt, int k, int first, int *region, int *loc){
+    if (k == 1 || cnt < 2){ for (int i=0;i<cnt;i++) region[nodes[i]] = first; return; }
+    int n0 = crp_bisect(g, nodes, cnt, loc);
+    shard_split_rec(g, nodes, n0, k/2, first, region, loc);
+    shard_split_rec(g, nodes + n0, cnt - n0, k - k/2, first + k/2, region, loc);
+}
+void shard_partition(Graph *g, int k, int *region){
+    int n = g->V, *loc = malloc(sizeof(int)*(n>0?n:1)), *nodes = malloc(sizeof(int)*(n>0?n:1));
+    for (int i=0;i<n;i++){ loc[i] = -1; nodes[i] = i; }
+    shard_split_rec(g, nodes, n, k < 1 ? 1 : k, 0, region, loc);
+    free(loc); free(nodes);
+}
+
+int shard_write(Graph *g, const int *region, int k, const char *dir){
+    char fn[4096]; int rc = 0;
+    snprintf(fn, sizeof(fn), "%s/overlay.csv", dir); FILE *ov = fopen(fn, "w");
+    if (!ov){ perror(fn); return -1; }
+    fprintf(ov, "from_id,to_id,from_shard,to_shard,length_meters,travel_time(sec)\n");
+    for (int r=0; r<k && rc == 0; r++){
+        snprintf(fn, sizeof(fn), "%s/shard-%d.nodes.csv", dir, r); FILE *nf = fopen(fn, "w");
+        if (!nf){ perror(fn); rc = -1; break; }
+        snprintf(fn, sizeof(fn), "%s/shard-%d.edges.csv", dir, r); FILE *ef = fopen(fn, "w");
+        if (!ef){ perror(fn); fclose(nf); rc = -1; break; }
+        fprintf(nf, "external_id,lat,lon,name,type\n");
+        fprintf(ef, "edge_id,from_id,to_id,length_meters,travel_time(sec),one_way\n");
+        long long eid = 0;
+        for (int u=0;u<g->V;u++){
+            if (region[u] != r) continue;
+            fprintf(nf, "%lld,%.8f,%.8f,%s,%s\n", g->ext_id[u], g->lat[u], g->lon[u], g->name[u] ? g->name[u] : "", g->type[u] ? g->type[u] : "");
+            for (int e=g->head[u]; e!=-1; e=g->edges[e].next){
+                const Edge *ed = &g->edges[e];
+                if (region[ed->to] == r) fprintf(ef, "%lld,%lld,%lld,%.17g,%.17g,1\n", ++eid, g->ext_id[u], g->ext_id[ed->to], ed->length, ed->weight);
+                else fprintf(ov, "%lld,%lld,%d,%d,%.17g,%.17g\n", g->ext_id[u], g->ext_id[ed->to], r, region[ed->to], ed->length, ed->weight);
+            }
+        }
+        if (ferror(nf) || ferror(ef)) rc = -1;
+        if (fclose(nf) != 0 || fclose(ef) != 0) rc = -1;
+    }
+    if (fclose(ov) != 0) rc = -1;
+    if (rc) fprintf(stderr, "writing shards to %s failed\n", dir);
+    return rc;
+}
+
+
+unsigned rng_next(unsigned *s){ unsigned x = *s; x ^= x << 13; x ^= x >> 17; x ^= x << 5; return *s = x ? x : 0x9e3779b9u; }
+
+/* synthetic rows x cols street grid south of ISBT (~120 m blocks, integer travel times), used by the benchmarks */
+void graph_build_grid(Graph *g, int rows, int cols, unsigned seed){
+    static const char *kinds[3] = { "Hospital", "Police Station", "Fire Station" };
+    long long base = 100000; char nm[64];
+    graph_ensure_nodecap(g, g->V + rows*cols);
+    for (int r=0;r<rows;r++) for (int c=0;c<cols;c++){
+        unsigned h = rng_next(&seed) % 400; const char *type = h < 3 ? kinds[h] : NULL;
+        if (type) snprintf(nm, sizeof(nm), "Grid %s %d-%d", type, r, c);
+        graph_add_node(g, base + (long long)r*cols + c, 30.317 - r*0.00108, 78.028 + c*0.00125, type ? nm : NULL, type);
+    }
+    int first = g->V - rows*cols;
+    for (int r=0;r<rows;r++) for (int c=0;c<cols;c++){
+        int u = first + r*cols + c;
+        if (c+1 < cols && rng_next(&seed) % 10){ double w = 8 + rng_next(&seed) % 18, len = round(1000*haversine(g->lat[u], g->lon[u], g->lat[u+1], g->lon[u+1])); graph_add_edge(g, u, u+1, w, len); graph_add_edge(g, u+1, u, w, len); }
+        if (r+1 < rows && rng_next(&seed) % 10){ double w = 8 + rng_next(&seed) % 18, len = round(1000*haversine(g->lat[u], g->lon[u], g->lat[u+cols], g->lon[u+cols])); graph_add_edge(g, u, u+cols, w, len); graph_add_edge(g, u+cols, u, w, len); }
+    }
+}
+
+/* scales every edge that touches the disc around (lat, lon); models a closed or congested district */
+void graph_scale_region(Graph *g, double lat, double lon, double radius_km, double factor){
+    for (int u=0;u<g->V;u++){
+        double dy = (g->lat[u]-lat)*111.2, dx = (g->lon[u]-lon)*111.2*cos(lat*3.14159265358979323846/180.0);
+        if (dx*dx + dy*dy > radius_km*radius_km) continue;
+        for (int e=g->head[u]; e!=-1; e=g->edges[e].next) g->edges[e].weight *= factor;
+    }
+    g->version++;
+}
+
+
+
+/* ---- node reordering: renumber so road neighbours sit close in every per-node array ----
+   load order is csv row order with placeholders appended as edges.csv mentions them, which
+   scatters a search over dist/par/head. external ids, names and positions move with their
+   node, so only internal indices change; run it right after loading, before anything keeps
+   node or edge indices. */
+static const char *reorder_names[] = { "none", "hilbert", "bfs", "rcm" };
+
+int reorder_mode(const char *name){
+    for (int m=0; m<(int)(sizeof(reorder_names)/sizeof(reorder_names[0])); m++) if (strcmp(name, reorder_names[m]) == 0) return m;
+    return -1;
+}
+const char* reorder_name(int mode){ return mode >= 0 && mode <= REORDER_RCM ? reorder_names[mode] : "?"; }
+
+/* order[new] = old. edges of each node become contiguous, in the order the list had them */
+void graph_permute(Graph *g, const int *order){
+    int n = g->V;
+    long long *ext = malloc(sizeof(long long)*g->node_cap); double *lat = malloc(sizeof(double)*g->node_cap), *lon = malloc(sizeof(double)*g->node_cap);
+    char **name = malloc(sizeof(char*)*g->node_cap), **type = malloc(sizeof(char*)*g->node_cap);
+    int *head = malloc(sizeof(int)*g->node_cap), *inv = malloc(sizeof(int)*(n>0?n:1));
+    Edge *edges = malloc(sizeof(Edge)*g->edge_cap);
+    for (int i=0;i<n;i++) inv[order[i]] = i;
+    for (int i=n;i<g->node_cap;i++){ head[i] = -1; ext[i] = 0; lat[i] = lon[i] = 0.0; name[i] = type[i] = NULL; }
+    int k = 0;
+    for (int i=0;i<n;i++){
+        int o = order[i];
+        ext[i] = g->ext_id[o]; lat[i] = g->lat[o]; lon[i] = g->lon[o]; name[i] = g->name[o]; type[i] = g->type[o];
+        head[i] = g->head[o] == -1 ? -1 : k;
+        for (int e=g->head[o]; e!=-1; e=g->edges[e].next){ edges[k] = g->edges[e]; edges[k].to = inv[g->edges[e].to]; edges[k].next = g->edges[e].next == -1 ? -1 : k+1; k++; }
+    }
+    free(g->ext_id); free(g->lat); free(g->lon); free(g->name); free(g->type); free(g->head); free(g->edges);
+    g->ext_id = ext; g->lat = lat; g->lon = lon; g->name = name; g->type = type; g->head = head; g->edges = edges;
+    llmap_free(g->idmap); g->idmap = llmap_create(n*2 + 16);
+    for (int i=0;i<n;i++) llmap_put(g->idmap, ext[i], i);
+    int had_rev = g->rev_edges >= 0; g->rev_edges = -1;
+    if (had_rev) graph_build_reverse(g);
+    g->version++;
+    free(inv);
+}
+
+/* position along a Hilbert curve over a 2^bits square */
+static unsigned long long hilbert_key(unsigned x, unsigned y, int bits){
+    unsigned long long d = 0; unsigned n = 1u << bits;
+    for (unsigned s = n >> 1; s > 0; s >>= 1){
+        unsigned rx = (x & s) != 0, ry = (y & s) != 0;
+        d += (unsigned long long)s * s * ((3 * rx) ^ ry);
+        if (!ry){ if (rx){ x = n-1 - x; y = n-1 - y; } unsigned t = x; x = y; y = t; }
+    }
+    return d;
+}
+typedef struct { unsigned long long key; int v; } ReorderKey;
+static int reorder_key_cmp(const void *a, const void *b){
+    const ReorderKey *p = a, *q = b;
+    if (p->key != q->key) return p->key < q->key ? -1 : 1;
+    return p->v - q->v;
+}
+
+/* placeholders take the curve position of a positioned neighbour, so they land beside it */
+static void reorder_hilbert(Graph *g, int *order){
+    int n = g->V; double la0 = 90, la1 = -90, lo0 = 180, lo1 = -180;
+    for (int v=0;v<n;v++) if (g->lat[v]!=0.0 || g->lon[v]!=0.0){
+        la0 = fmin(la0, g->lat[v]); la1 = fmax(la1, g->lat[v]);
+        lo0 = fmin(lo0, g->lon[v]); lo1 = fmax(lo1, g->lon[v]);
+    }
+    double sla = la1 > la0 ? 65535.0 / (la1 - la0) : 0, slo = lo1 > lo0 ? 65535.0 / (lo1 - lo0) : 0;
+    ReorderKey *k = malloc(sizeof(ReorderKey)*(n>0?n:1));
+    for (int v=0;v<n;v++){ k[v].v = v; k[v].key = ~0ULL; if (g->lat[v]!=0.0 || g->lon[v]!=0.0) k[v].key = hilbert_key((unsigned)((g->lon[v]-lo0)*slo), (unsigned)((g->lat[v]-la0)*sla), 16); }
+    for (int v=0;v<n;v++) if (k[v].key == ~0ULL){
+        for (int e=g->head[v]; e!=-1 && k[v].key == ~0ULL; e=g->edges[e].next){ int u = g->edges[e].to; if (g->lat[u]!=0.0 || g->lon[u]!=0.0) k[v].key = k[u].key; }
+        for (int i=g->rev_off[v]; i<g->rev_off[v+1] && k[v].key == ~0ULL; i++){ int u = g->rev_from[i]; if (g->lat[u]!=0.0 || g->lon[u]!=0.0) k[v].key = k[u].key; }
+    }
+    qsort(k, n, sizeof(ReorderKey), reorder_key_cmp);
+    for (int i=0;i<n;i++) order[i] = k[i].v;
+    free(k);
+}
+
+/* breadth-first over roads in both directions, one component after another. rcm starts each
+   component at its lowest-degree node, queues neighbours by ascending degree and reverses the
+   result (reverse Cuthill-McKee); plain bfs keeps index order throughout */
+static void reorder_bfs(Graph *g, int *order, int rcm){
+    int n = g->V, head = 0, tail = 0;
+    char *seen = calloc(n>0?n:1, 1); int *deg = malloc(sizeof(int)*(n>0?n:1));
+    ReorderKey *start = malloc(sizeof(ReorderKey)*(n>0?n:1)), *nb = malloc(sizeof(ReorderKey)*(n>0?n:1));
+    for (int v=0;v<n;v++){ deg[v] = g->rev_off[v+1] - g->rev_off[v]; for (int e=g->head[v]; e!=-1; e=g->edges[e].next) deg[v]++; }
+    for (int v=0;v<n;v++) start[v] = (ReorderKey){ rcm ? (unsigned long long)deg[v] : 0, v };
+    if (rcm) qsort(start, n, sizeof(ReorderKey), reorder_key_cmp);
+    for (int si=0; si<n; si++){
+        if (seen[start[si].v]) continue;
+        seen[start[si].v] = 1; order[tail++] = start[si].v;
+        while (head < tail){
+            int u = order[head++], c = 0;
+            for (int e=g->head[u]; e!=-1; e=g->edges[e].next){ int v = g->edges[e].to; if (!seen[v]){ seen[v] = 1; nb[c++] = (ReorderKey){ rcm ? (unsigned long long)deg[v] : 0, v }; } }
+            for (int i=g->rev_off[u]; i<g->rev_off[u+1]; i++){ int v = g->rev_from[i]; if (!seen[v]){ seen[v] = 1; nb[c++] = (ReorderKey){ rcm ? (unsigned long long)deg[v] : 0, v }; } }
+            if (rcm) qsort(nb, c, sizeof(ReorderKey), reorder_key_cmp);
+            for (int i=0;i<c;i++) order[tail++] = nb[i].v;
+        }
+    }
+    if (rcm) for (int i=0, j=n-1; i<j; i++, j--){ int x = order[i]; order[i] = order[j]; order[j] = x; }
+    free(seen); free(deg); free(start); free(nb);
+}
+
+void graph_reorder(Graph *g, int mode){
+    if (mode <= REORDER_NONE || mode > REORDER_RCM || g->V < 2) return;
+    graph_build_reverse(g);
+    int *order = malloc(sizeof(int)*g->V);
+    if (mode == REORDER_HILBERT) reorder_hilbert(g, order);
+    else reorder_bfs(g, order, mode == REORDER_RCM);
+    graph_permute(g, order);
+    free(order);
+}
+
+
+/* ---- static spatial index: packed 3-d tree over unit-sphere node positions ---- */
+double haversine(double lat1, double lon1, double lat2, double lon2){
+    double d1 = (lat2-lat1)*DEG2RAD, d2 = (lon2-lon1)*DEG2RAD;
+    double a = sin(d1/2)*sin(d1/2) + cos(lat1*DEG2RAD)*cos(lat2*DEG2RAD)*sin(d2/2)*sin(d2/2);
+    return 2 * EARTH_R_KM * atan2(sqrt(a), sqrt(1-a));
+}
+
+/* chord length between unit vectors is monotone in great-circle distance, so a euclidean
+   tree over (x,y,z) answers exact nearest-node queries. tree order: the median of [lo,hi)
+   sits at (lo+hi)/2 and splits on axis[mid]. */
+static void geo_to_xyz(double lat, double lon, double *p){ double la = lat*DEG2RAD, lo = lon*DEG2RAD; p[0] = cos(la)*cos(lo); p[1] = cos(la)*sin(lo); p[2] = sin(la); }
+static void geo_swap(GeoIndex *gi, int a, int b){
+    int t = gi->idx[a]; gi->idx[a] = gi->idx[b]; gi->idx[b] = t;
+    for (int k=0;k<3;k++){ double x = gi->xyz[3*a+k]; gi->xyz[3*a+k] = gi->xyz[3*b+k]; gi->xyz[3*b+k] = x; }
+}
+static void geo_build_rec(GeoIndex *gi, int lo, int hi){
+    if (hi - lo <= 1){ if (hi > lo) gi->axis[lo] = 0; return; }
+    double mn[3] = {2,2,2}, mx[3] = {-2,-2,-2};
+    for (int i=lo;i<hi;i++) for (int k=0;k<3;k++){ double x = gi->xyz[3*i+k]; if (x<mn[k]) mn[k]=x; if (x>mx[k]) mx[k]=x; }
+    int ax = 0; for (int k=1;k<3;k++) if (mx[k]-mn[k] > mx[ax]-mn[ax]) ax = k;
+    int mid = (lo+hi)/2, l = lo, r = hi-1;
+    while (l < r){ /* quickselect the median on ax */
+        double piv = gi->xyz[3*((l+r)/2)+ax]; int i = l, j = r;
+        while (i <= j){ while (gi->xyz[3*i+ax] < piv) i++; while (gi->xyz[3*j+ax] > piv) j--; if (i <= j){ geo_swap(gi, i, j); i++; j--; } }
+        if (mid <= j) r = j; else if (mid >= i) l = i; else break;
+    }
+    gi->axis[mid] = (unsigned char)ax;
+    geo_build_rec(gi, lo, mid); geo_build_rec(gi, mid+1, hi);
+}
+/* indexes every node that has coordinates; placeholder nodes created from edges.csv sit at 0,0 and are skipped */
+GeoIndex* geo_build(Graph *g){
+    GeoIndex *gi = malloc(sizeof(GeoIndex)); int m = g->V>0?g->V:1;
+    gi->idx = malloc(sizeof(int)*m); gi->xyz = malloc(sizeof(double)*3*m); gi->axis = malloc(m); gi->n = 0;
+    for (int i=0;i<g->V;i++){ if (g->lat[i]==0.0 && g->lon[i]==0.0) continue; gi->idx[gi->n] = i; geo_to_xyz(g->lat[i], g->lon[i], gi->xyz + 3*gi->n); gi->n++; }
+    geo_build_rec(gi, 0, gi->n);
+    return gi;
+}
+void geo_free(GeoIndex *gi){ if (!gi) return; free(gi->idx); free(gi->xyz); free(gi->axis); free(gi); }
+
+/* bounded max-heap of the k best squared chords seen so far */
+typedef struct { int k, size; double *d2; int *id; } GeoBest;
+static void geo_offer(GeoBest *b, double d2, int id){
+    if (b->size == b->k && d2 >= b->d2[0]) return;
+    int i;
+    if (b->size < b->k) i = b->size++;
+    else { /* drop the current worst, sift down the hole from the root */
+        i = 0;
+        while (1){ int l = 2*i+1, s = l; if (l >= b->size-1) break; if (l+1 < b->size-1 && b->d2[l+1] > b->d2[l]) s = l+1; if (b->d2[s] <= b->d2[b->size-1]) break; b->d2[i] = b->d2[s]; b->id[i] = b->id[s]; i = s; }
+        b->d2[i] = b->d2[b->size-1]; b->id[i] = b->id[b->size-1]; i = b->size-1;
+    }
+    while (i > 0){ int p = (i-1)/2; if (b->d2[p] >= d2) break; b->d2[i] = b->d2[p]; b->id[i] = b->id[p]; i = p; }
+    b->d2[i] = d2; b->id[i] = id;
+}
+static void geo_search(const GeoIndex *gi, int lo, int hi, const double *q, GeoBest *b){
+    while (lo < hi){
+        int mid = (lo+hi)/2; const double *p = gi->xyz + 3*mid;
+        double dx = p[0]-q[0], dy = p[1]-q[1], dz = p[2]-q[2];
+        geo_offer(b, dx*dx+dy*dy+dz*dz, gi->idx[mid]);
+        double diff = q[gi->axis[mid]] - p[gi->axis[mid]];
+        int nlo = diff < 0 ? lo : mid+1, nhi = diff < 0 ? mid : hi; /* near side */
+        int flo = diff < 0 ? mid+1 : lo, fhi = diff < 0 ? hi : mid;  /* far side */
+        geo_search(gi, nlo, nhi, q, b);
+        if (b->size == b->k && diff*diff >= b->d2[0]) return;
+        lo = flo; hi = fhi;
+    }
+}
+static double geo_chord_km(double d2){ double c = sqrt(d2) / 2; return 2 * EARTH_R_KM * asin(c > 1 ? 1 : c); }
+
+/* up to k nearest indexed nodes, closest first; returns the count written */
+int geo_knearest(const GeoIndex *gi, double lat, double lon, int k, int *out, double *out_km){
+    if (!gi || gi->n == 0 || k <= 0) return 0;
+    double q[3]; geo_to_xyz(lat, lon, q);
+    double d2buf[64]; int idbuf[64];
+    GeoBest b = { k, 0, k <= 64 ? d2buf : malloc(sizeof(double)*k), k <= 64 ? idbuf : malloc(sizeof(int)*k) };
+    geo_search(gi, 0, gi->n, q, &b);
+    int cnt = b.size;
+    for (int i=cnt-1;i>=0;i--){ /* heap-sort in place: repeatedly move the worst to the back */
+        out[i] = b.id[0]; if (out_km) out_km[i] = geo_chord_km(b.d2[0]);
+        double d2 = b.d2[b.size-1]; int id = b.id[b.size-1]; b.size--;
+        int j = 0; while (1){ int l = 2*j+1, s = l; if (l >= b.size) break; if (l+1 < b.size && b.d2[l+1] > b.d2[l]) s = l+1; if (b.d2[s] <= d2) break; b.d2[j] = b.d2[s]; b.id[j] = b.id[s]; j = s; }
+        if (b.size){ b.d2[j] = d2; b.id[j] = id; }
+    }
+    if (k > 64){ free(b.d2); free(b.id); }
+    return cnt;
+}
+int geo_nearest(const GeoIndex *gi, double lat, double lon, double *dist_km){
+    int id = -1; double km = 0;
+    if (geo_knearest(gi, lat, lon, 1, &id, &km) == 0) return -1;
+    if (dist_km) *dist_km = km;
+    return id;
+}
+
+/* "30.3165,78.0322", "30.3165 78.0322" or "geo:30.3165,78.0322" */
+int parse_latlon(const char *s, double *lat, double *lon){
+    if (!s) return 0;
+    while (*s==' '||*s=='\t') s++;
+    if (strncmp(s, "geo:", 4) == 0) s += 4;
+    char *end; double a = strtod(s, &end); if (end == s) return 0;
+    s = end; while (*s==' '||*s==',') s++;
+    double b = strtod(s, &end); if (end == s) return 0;
+    while (*end==' '||*end=='\t') end++;
+    if (*end || a < -90 || a > 90 || b < -180 || b > 180) return 0;
+    *lat = a; *lon = b; return 1;
+}
+
+
+
+/* ---- straight-line lower bounds: prune candidates that cannot beat the best road time ----
+   the chord between unit vectors never exceeds the arc, and no road covers ground faster than
+   kmps, so chord_km / kmps is a lower bound on travel time needing no trig per candidate. */
+GeoBound* geobound_build(Graph *g){
+    GeoBound *gb = calloc(1, sizeof(GeoBound)); int m = g->V>0?g->V:1;
+    gb->n = g->V; gb->x = malloc(sizeof(double)*3*m); gb->y = gb->x + m; gb->z = gb->y + m; gb->has = calloc(m, 1);
+    for (int i=0;i<g->V;i++){
+        double p[3] = {0,0,0};
+        if (g->lat[i]!=0.0 || g->lon[i]!=0.0){ geo_to_xyz(g->lat[i], g->lon[i], p); gb->has[i] = 1; }
+        gb->x[i] = p[0]; gb->y[i] = p[1]; gb->z[i] = p[2];
+    }
+    /* a road that touches a placeholder node or takes no time has no speed limit: no pruning */
+    double kmps = 0;
+    for (int u=0;u<g->V && kmps>=0;u++) for (int e=g->head[u]; e!=-1; e=g->edges[e].next){
+        int v = g->edges[e].to; double w = g->edges[e].weight;
+        if (u == v) continue;
+        if (!gb->has[u] || !gb->has[v] || w <= 0){ kmps = -1; break; }
+        double s = haversine(g->lat[u], g->lon[u], g->lat[v], g->lon[v]) / w; if (s > kmps) kmps = s;
+    }
+    gb->kmps = kmps > 0 ? kmps : 0; gb->version = g->version;
+    return gb;
+}
+void geobound_free(GeoBound *gb){ if (!gb) return; free(gb->x); free(gb->has); free(gb); }
+
+void geo_lower_bound_km_scalar(const double *x, const double *y, const double *z, int n, const double *t, double *out){
+    for (int i=0;i<n;i++){ double dx = x[i]-t[0], dy = y[i]-t[1], dz = z[i]-t[2]; out[i] = EARTH_R_KM * sqrt(dx*dx + dy*dy + dz*dz); }
+}
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,fma"))) static void geo_lower_bound_km_avx2(const double *x, const double *y, const double *z, int n, const double *t, double *out){
+    __m256d tx = _mm256_set1_pd(t[0]), ty = _mm256_set1_pd(t[1]), tz = _mm256_set1_pd(t[2]), r = _mm256_set1_pd(EARTH_R_KM);
+    int i = 0;
+    for (; i+4 <= n; i += 4){
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x+i), tx), dy = _mm256_sub_pd(_mm256_loadu_pd(y+i), ty), dz = _mm256_sub_pd(_mm256_loadu_pd(z+i), tz);
+        __m256d d2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dz, dz)));
+        _mm256_storeu_pd(out+i, _mm256_mul_pd(r, _mm256_sqrt_pd(d2)));
+    }
+    geo_lower_bound_km_scalar(x+i, y+i, z+i, n-i, t, out+i);
+}
+#endif
+void geo_lower_bound_km(const double *x, const double *y, const double *z, int n, const double *t, double *out){
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){ geo_lower_bound_km_avx2(x, y, z, n, t, out); return; }
+#endif
+    geo_lower_bound_km_scalar(x, y, z, n, t, out);
+}
+
+typedef struct { int i; double lb; } BoundCand;
+static int bound_cand_cmp(const void *a, const void *b){
+    const BoundCand *p = a, *q = b;
+    if (p->lb != q->lb) return (p->lb > q->lb) - (p->lb < q->lb);
+    return p->i - q->i;
+}
+/* candidates in lower-bound order; stops at the first whose bound exceeds the best time found */
+int best_source_query(Graph *g, const GeoBound *gb, RouteCache *rc, SearchWork *w, int *path, const int *src, int m, int dst, double *time, int *routed){
+    int best_i = -1, n_routed = 0, len; double best = INF;
+    if (dst < 0 || dst >= g->V) m = 0;
+    double *buf = malloc(sizeof(double)*(4*(size_t)m + 1)), *x = buf, *y = buf + m, *z = buf + 2*m, *lb = buf + 3*m;
+    BoundCand *c = malloc(sizeof(BoundCand)*(m+1));
+    int prune = m > 0 && gb && gb->kmps > 0 && gb->version == g->version && gb->has[dst];
+    if (prune){
+        double t[3] = { gb->x[dst], gb->y[dst], gb->z[dst] };
+        for (int i=0;i<m;i++){ int v = src[i] >= 0 && src[i] < g->V ? src[i] : dst; x[i] = gb->x[v]; y[i] = gb->y[v]; z[i] = gb->z[v]; }
+        geo_lower_bound_km(x, y, z, m, t, lb);
+    }
+    /* shave a little so rounding can never turn the bound into an overestimate */
+    for (int i=0;i<m;i++) c[i] = (BoundCand){ i, prune && src[i] >= 0 && src[i] < g->V && gb->has[src[i]] ? lb[i] / gb->kmps * (1 - 1e-9) : 0 };
+    qsort(c, m, sizeof(BoundCand), bound_cand_cmp);
+    for (int k=0;k<m && c[k].lb <= best;k++){
+        int s = src[c[k].i];
+        if (s < 0 || s >= g->V) continue;
+        double d = route_query(g, rc, w, s, dst, path, &len); n_routed++;
+        if (d < best || (d == best && d < INF && c[k].i < best_i)){ best = d; best_i = c[k].i; }
+    }
+    free(c); free(buf);
+    if (time) *time = best;
+    if (routed) *routed = n_routed;
+    return best_i;
+}
+
+/* ---- isochrones: which stations reach each node within each time budget ---- */
+static const char *kind_names[KIND_COUNT] = { "hospital", "police", "fire" };
+
+int station_kind(Graph *g, int idx){
+    if (!g->type[idx]) return -1;
+    char t[256]; str_to_lower(g->type[idx], t);
+    if (strstr(t, "hospital")) return KIND_HOSPITAL;
+    if (strstr(t, "police")) return KIND_POLICE;
+    if (strstr(t, "fire")) return KIND_FIRE;
+    return -1;
+}
+
+typedef struct { Coverage *cv; Graph *g; atomic_int next; } CoverageJob;
+static void* coverage_worker(void *arg){
+    CoverageJob *job = arg; Coverage *cv = job->cv; Graph *g = job->g;
+    SearchWork *w = search_work_create(g->V);
+    double limit = cv->thresh[cv->nthresh-1];
+    int s;
+    while ((s = atomic_fetch_add(&job->next, 1)) < cv->nst){
+        unsigned long long bit = 1ULL << (s & 63); int word = s >> 6;
+        search_work_reset(w); sw_relax(w, cv->station[s], 0.0, -1, -1);
+        while (w->hsize){
+            int u = sw_heap_pop(w); double du = w->dist[u];
+            if (du > limit) break;
+            for (int t=cv->nthresh-1; t>=0 && du <= cv->thresh[t]; t--) atomic_fetch_or_explicit(&cv->bits[((long long)t*cv->n + u)*cv->words + word], bit, memory_order_relaxed);
+            for (int e=g->head[u]; e!=-1; e=g->edges[e].next) sw_relax(w, g->edges[e].to, du + g->edges[e].weight, u, -1);
+        }
+    }
+    search_work_free(w); return NULL;
+}
+/* one bounded search per station, spread over a thread pool; thresholds in seconds, ascending */
+Coverage* coverage_compute(Graph *g, const double *thresh, int nthresh, int threads){
+    Coverage *cv = calloc(1, sizeof(Coverage));
+    cv->n = g->V; cv->nthresh = nthresh > ISO_MAX_THRESH ? ISO_MAX_THRESH : nthresh;
+    memcpy(cv->thresh, thresh, sizeof(double)*cv->nthresh);
+    cv->station = malloc(sizeof(int)*(g->V+1)); cv->kind = malloc(g->V+1);
+    for (int i=0;i<g->V;i++){ int k = station_kind(g, i); if (k >= 0){ cv->station[cv->nst] = i; cv->kind[cv->nst++] = (signed char)k; } }
+    cv->words = (cv->nst + 63) / 64; if (cv->words == 0) cv->words = 1;
+    cv->bits = calloc((size_t)cv->nthresh * cv->n * cv->words + 1, sizeof(atomic_ullong));
+    cv->kind_mask = calloc((size_t)KIND_COUNT * cv->words, sizeof(unsigned long long));
+    for (int s=0;s<cv->nst;s++) cv->kind_mask[cv->kind[s]*cv->words + (s>>6)] |= 1ULL << (s & 63);
+    if (threads < 1) threads = 1;
+    CoverageJob job = { cv, g, 0 };
+    pthread_t *tid = malloc(sizeof(pthread_t)*threads);
+    for (int i=0;i<threads;i++) pthread_create(&tid[i], NULL, coverage_worker, &job);
+    for (int i=0;i<threads;i++) pthread_join(tid[i], NULL);
+    free(tid);
+    return cv;
+}
+void coverage_free(Coverage *cv){ if (!cv) return; free(cv->station); free(cv->kind); free(cv->bits); free(cv->kind_mask); free(cv); }
+
+/* number of stations of kind k covering v within thresh[t] */
+int coverage_count(const Coverage *cv, int t, int v, int k){
+    const atomic_ullong *row = cv->bits + ((long long)t*cv->n + v)*cv->words; int c = 0;
+    for (int w=0; w<cv->words; w++) c += __builtin_popcountll(atomic_load_explicit(&row[w], memory_order_relaxed) & cv->kind_mask[k*cv->words + w]);
+    return c;
+}
+
+/* csv: one row per node, per-threshold counts by kind (0 = coverage gap), then every station within the largest budget */
+void coverage_write_csv(const Coverage *cv, Graph *g, FILE *f){
+    fprintf(f, "external_id,lat,lon");
+    for (int t=0;t<cv->nthresh;t++) for (int k=0;k<KIND_COUNT;k++) fprintf(f, ",%s_%gmin", kind_names[k], cv->thresh[t]/60.0);
+    fprintf(f, ",stations\n");
+    for (int v=0; v<cv->n; v++){
+        fprintf(f, "%lld,%.6f,%.6f", g->ext_id[v], g->lat[v], g->lon[v]);
+        for (int t=0;t<cv->nthresh;t++) for (int k=0;k<KIND_COUNT;k++) fprintf(f, ",%d", coverage_count(cv, t, v, k));
+        fputc(',', f);
+        const atomic_ullong *row = cv->bits + ((long long)(cv->nthresh-1)*cv->n + v)*cv->words; int first = 1;
+        for (int w=0; w<cv->words; w++){
+            unsigned long long x = atomic_load_explicit(&row[w], memory_order_relaxed);
+            while (x){ int s = w*64 + __builtin_ctzll(x); x &= x-1; fprintf(f, first ? "%lld" : ";%lld", g->ext_id[cv->station[s]]); first = 0; }
+        }
+        fputc('\n', f);
+    }
+}
+/* binary: "ISO1", n, nthresh, nst, words (int32), thresholds (double), station ext ids, node ext ids (int64),
+   then the raw bitsets, threshold-major, words per node */
+void coverage_write_bin(const Coverage *cv, Graph *g, FILE *f){
+    int hdr[4] = { cv->n, cv->nthresh, cv->nst, cv->words };
+    fwrite("ISO1", 1, 4, f); fwrite(hdr, sizeof(int), 4, f); fwrite(cv->thresh, sizeof(double), cv->nthresh, f);
+    for (int s=0;s<cv->nst;s++) fwrite(&g->ext_id[cv->station[s]], sizeof(long long), 1, f);
+    fwrite(g->ext_id, sizeof(long long), cv->n, f);
+    fwrite(cv->bits, sizeof(unsigned long long), (size_t)cv->nthresh * cv->n * cv->words, f);
+}
+
+
+/* ---- route cache: (src, dst, metric version) -> (distance, delta-coded path) ----
+   sharded by key; each shard has a reader/writer lock, so lookups on different shards never
+   contend and lookups on the same shard share the lock. replacement is CLOCK (second chance),
+   which only needs an atomic reference bit on the read path. entries from an older metric
+   version are treated as misses and overwritten. */
+#define ROUTE_SHARDS 64
+
+typedef struct RouteEntry {
+    int src, dst, path_len, enc_len;
+    unsigned long long version;
+    double dist;
+    atomic_uchar ref;
+    struct RouteEntry *hnext;
+    int ring_slot;
+    unsigned char enc[];
+} RouteEntry;
+typedef struct {
+    pthread_rwlock_t lock;
+    RouteEntry **buckets; int nbuckets;
+    RouteEntry **ring; int ring_n, ring_cap, hand;
+    size_t bytes;
+} RouteShard;
+struct RouteCache {
+    RouteShard shard[ROUTE_SHARDS];
+    size_t shard_cap;
+    atomic_ullong hits, misses, stale, inserts, evictions;
+};
+
+RouteCache* route_cache_create(size_t cap_bytes){
+    RouteCache *rc = calloc(1, sizeof(RouteCache));
+    rc->shard_cap = cap_bytes / ROUTE_SHARDS;
+    for (int i=0;i<ROUTE_SHARDS;i++){
+        RouteShard *sh = &rc->shard[i];
+        pthread_rwlock_init(&sh->lock, NULL);
+        sh->nbuckets = 256; sh->buckets = calloc(sh->nbuckets, sizeof(RouteEntry*));
+        sh->ring_cap = 256; sh->ring = malloc(sizeof(RouteEntry*)*sh->ring_cap);
+    }
+    return rc;
+}
+void route_cache_free(RouteCache *rc){
+    if (!rc) return;
+    for (int i=0;i<ROUTE_SHARDS;i++){
+        RouteShard *sh = &rc->shard[i];
+        for (int j=0;j<sh->ring_n;j++) free(sh->ring[j]);
+        free(sh->ring); free(sh->buckets); pthread_rwlock_destroy(&sh->lock);
+    }
+    free(rc);
+}
+static unsigned long long route_key_hash(int src, int dst){ return hash_u64(((unsigned long long)(unsigned)src << 32) | (unsigned)dst); }
+
+/* zigzag deltas as LEB128 varints: neighbouring road nodes mostly have close indices */
+static int route_encode(const int *path, int len, unsigned char *out){
+    int n = 0, prev = 0;
+    for (int i=0;i<len;i++){
+        int d = path[i] - prev; prev = path[i];
+        unsigned z = ((unsigned)d << 1) ^ (unsigned)(d >> 31);
+        while (z >= 0x80){ out[n++] = (unsigned char)(z | 0x80); z >>= 7; }
+        out[n++] = (unsigned char)z;
+    }
+    return n;
+}
+static void route_decode(const unsigned char *in, int len, int *path){
+    int prev = 0, p = 0;
+    for (int i=0;i<len;i++){
+        unsigned z = 0; int shift = 0;
+        while (in[p] & 0x80){ z |= (unsigned)(in[p++] & 0x7f) << shift; shift += 7; }
+        z |= (unsigned)in[p++] << shift;
+        prev += (int)((z >> 1) ^ -(z & 1)); path[i] = prev;
+    }
+}
+
+/* on a hit copies the distance and, when path is given, up to path_cap nodes; returns 1 on hit */
+int route_cache_get(RouteCache *rc, int src, int dst, unsigned long long version, double *dist, int *path, int *path_len, int path_cap){
+    unsigned long long h = route_key_hash(src, dst);
+    RouteShard *sh = &rc->shard[h % ROUTE_SHARDS];
+    int hit = 0;
+    pthread_rwlock_rdlock(&sh->lock);
+    for (RouteEntry *e = sh->buckets[(h / ROUTE_SHARDS) & (sh->nbuckets-1)]; e; e = e->hnext){
+        if (e->src != src || e->dst != dst) continue;
+        if (e->version != version){ atomic_fetch_add_explicit(&rc->stale, 1, memory_order_relaxed); break; }
+        if (path && e->path_len > path_cap) break;
+        *dist = e->dist;
+        if (path){ route_decode(e->enc, e->path_len, path); *path_len = e->path_len; }
+        atomic_store_explicit(&e->ref, 1, memory_order_relaxed);
+        hit = 1; break;
+    }
+    pthread_rwlock_unlock(&sh->lock);
+    atomic_fetch_add_explicit(hit ? &rc->hits : &rc->misses, 1, memory_order_relaxed);
+    return hit;
+}
+
+static void route_shard_unlink(RouteShard *sh, RouteEntry *e, unsigned long long h){
+    RouteEntry **pp = &sh->buckets[(h / ROUTE_SHARDS) & (sh->nbuckets-1)];
+    while (*pp != e) pp = &(*pp)->hnext;
+    *pp = e->hnext;
+    int slot = e->ring_slot; sh->ring[slot] = sh->ring[--sh->ring_n]; sh->ring[slot]->ring_slot = slot;
+    if (sh->hand >= sh->ring_n) sh->hand = 0;
+    sh->bytes -= sizeof(RouteEntry) + e->enc_len;
+    free(e);
+}
+void route_cache_put(RouteCache *rc, int src, int dst, unsigned long long version, double dist, const int *path, int path_len){
+    unsigned char stackbuf[1024];
+    unsigned char *enc = path_len*5 <= (int)sizeof(stackbuf) ? stackbuf : malloc((size_t)path_len*5);
+    int enc_len = route_encode(path, path_len, enc);
+    size_t need = sizeof(RouteEntry) + enc_len;
+    unsigned long long h = route_key_hash(src, dst);
+    RouteShard *sh = &rc->shard[h % ROUTE_SHARDS];
+    if (need > rc->shard_cap){ if (enc != stackbuf) free(enc); return; }
+    pthread_rwlock_wrlock(&sh->lock);
+    for (RouteEntry *e = sh->buckets[(h / ROUTE_SHARDS) & (sh->nbuckets-1)]; e; e = e->hnext)
+        if (e->src == src && e->dst == dst){ route_shard_unlink(sh, e, h); break; }
+    while (sh->bytes + need > rc->shard_cap && sh->ring_n){
+        RouteEntry *victim = sh->ring[sh->hand];
+        if (atomic_exchange_explicit(&victim->ref, 0, memory_order_relaxed)){ sh->hand = (sh->hand + 1) % sh->ring_n; continue; }
+        route_shard_unlink(sh, victim, route_key_hash(victim->src, victim->dst));
+        atomic_fetch_add_explicit(&rc->evictions, 1, memory_order_relaxed);
+    }
+    RouteEntry *e = malloc(need);
+    e->src = src; e->dst = dst; e->path_len = path_len; e->enc_len = enc_len; e->version = version; e->dist = dist;
+    atomic_init(&e->ref, 0); memcpy(e->enc, enc, enc_len);
+    if (sh->ring_n == sh->ring_cap){ sh->ring_cap *= 2; sh->ring = realloc(sh->ring, sizeof(RouteEntry*)*sh->ring_cap); }
+    if (sh->ring_n >= sh->nbuckets){ /* keep chains short: double the bucket array and rehash */
+        int nb = sh->nbuckets * 2; RouteEntry **nbk = calloc(nb, sizeof(RouteEntry*));
+        for (int i=0;i<sh->ring_n;i++){ RouteEntry *x = sh->ring[i]; RouteEntry **b = &nbk[(route_key_hash(x->src, x->dst) / ROUTE_SHARDS) & (nb-1)]; x->hnext = *b; *b = x; }
+        free(sh->buckets); sh->buckets = nbk; sh->nbuckets = nb;
+    }
+    RouteEntry **b = &sh->buckets[(h / ROUTE_SHARDS) & (sh->nbuckets-1)];
+    e->hnext = *b; *b = e;
+    e->ring_slot = sh->ring_n; sh->ring[sh->ring_n++] = e;
+    sh->bytes += need;
+    pthread_rwlock_unlock(&sh->lock);
+    atomic_fetch_add_explicit(&rc->inserts, 1, memory_order_relaxed);
+    if (enc != stackbuf) free(enc);
+}
+void route_cache_counters(RouteCache *rc, unsigned long long *hits, unsigned long long *misses){
+    if (hits) *hits = atomic_load(&rc->hits);
+    if (misses) *misses = atomic_load(&rc->misses);
+}
+void route_cache_print_stats(RouteCache *rc, FILE *f){
+    unsigned long long h = atomic_load(&rc->hits), m = atomic_load(&rc->misses);
+    size_t bytes = 0; int entries = 0;
+    for (int i=0;i<ROUTE_SHARDS;i++){ pthread_rwlock_rdlock(&rc->shard[i].lock); bytes += rc->shard[i].bytes; entries += rc->shard[i].ring_n; pthread_rwlock_unlock(&rc->shard[i].lock); }
+    fprintf(f, "route cache: %llu hits, %llu misses (%llu stale), hit rate %.1f%%, %d entries, %zu/%zu bytes, %llu evictions\n",
+            h, m, (unsigned long long)atomic_load(&rc->stale), h+m ? 100.0*h/(h+m) : 0.0, entries, bytes, rc->shard_cap*ROUTE_SHARDS, (unsigned long long)atomic_load(&rc->evictions));
+}
+
+/* point-to-point travel time with early exit; served from the cache when the metric is unchanged */
+double route_query(Graph *g, RouteCache *rc, SearchWork *w, int s, int t, int *path, int *path_len){
+    double d;
+    if (rc && route_cache_get(rc, s, t, g->version, &d, path, path_len, g->V)) return d;
+    search_work_reset(w); sw_relax(w, s, 0.0, -1, -1);
+    while (w->hsize){
+        int u = sw_heap_pop(w); double du = w->dist[u];
+        if (u == t) break;
+        for (int e=g->head[u]; e!=-1; e=g->edges[e].next) sw_relax(w, g->edges[e].to, du + g->edges[e].weight, u, -1);
+    }
+    d = w->dist[t];
+    int len = 0;
+    if (d < INF){ for (int x = t; x != -1; x = w->par[x]) path[len++] = x; for (int i=0, j=len-1; i<j; i++, j--){ int x = path[i]; path[i] = path[j]; path[j] = x; } }
+    *path_len = len;
+    if (rc) route_cache_put(rc, s, t, g->version, d, path, len);
+    return d;
+}
+
+
+/* ---- alternative routes: via-node candidates from one forward and one backward search ----
+   a via node v gives the route s ~> v ~> t of length df[v] + db[v]. candidates are tried
+   shortest first and kept when the route is simple, within max_stretch of the fastest and
+   shares at most max_overlap of the fastest's time with every route kept before it. */
+#define ALT_MAX_CANDIDATES 4096
+
+/* incoming edges as CSR over forward edge indices, so weight changes need no rebuild */
+void graph_build_reverse(Graph *g){
+    if (g->rev_edges == g->edge_count) return;
+    free(g->rev_off); free(g->rev_from); free(g->rev_edge);
+    int n = g->V, m = g->edge_count;
+    g->rev_off = calloc(n+1, sizeof(int)); g->rev_from = malloc(sizeof(int)*(m>0?m:1)); g->rev_edge = malloc(sizeof(int)*(m>0?m:1));
+    for (int e=0;e<m;e++) g->rev_off[g->edges[e].to+1]++;
+    for (int i=0;i<n;i++) g->rev_off[i+1] += g->rev_off[i];
+    int *fill = malloc(sizeof(int)*(n>0?n:1)); memcpy(fill, g->rev_off, sizeof(int)*(n>0?n:1));
+    for (int u=0;u<n;u++) for (int e=g->head[u]; e!=-1; e=g->edges[e].next){ int p = fill[g->edges[e].to]++; g->rev_from[p] = u; g->rev_edge[p] = e; }
+    free(fill);
+    g->rev_edges = m;
+}
+
+/* settles every node up to limit; with target set, limit becomes stretch * d(target) once it settles */
+static void alt_search(Graph *g, SearchWork *w, int src, int backward, int target, double stretch, double limit){
+    search_work_reset(w); sw_relax(w, src, 0.0, -1, -1);
+    while (w->hsize){
+        int u = w->heap[0]; double du = w->dist[u];
+        if (du > limit) break;
+        sw_heap_pop(w);
+        if (u == target) limit = du * stretch;
+        if (!backward){ for (int e=g->head[u]; e!=-1; e=g->edges[e].next) sw_relax(w, g->edges[e].to, du + g->edges[e].weight, u, -1); }
+        else for (int i=g->rev_off[u]; i<g->rev_off[u+1]; i++) sw_relax(w, g->rev_from[i], du + g->edges[g->rev_edge[i]].weight, u, -1);
+    }
+}
+
+typedef struct { int v; double len; } AltCand;
+static int alt_cand_cmp(const void *a, const void *b){ double x = ((const AltCand*)a)->len, y = ((const AltCand*)b)->len; return (x>y) - (x<y); }
+
+int alt_routes_query(Graph *g, SearchWork *fw, SearchWork *bw, int s, int t, int k, double max_stretch, double max_overlap, AltRoute *out){
+    if (k < 1 || s < 0 || t < 0 || s >= g->V || t >= g->V) return 0;
+    graph_build_reverse(g);
+    alt_search(g, fw, s, 0, t, max_stretch, INF);
+    if (fw->pos[t] != -2) return 0;
+    double D = fw->dist[t], limit = D * max_stretch;
+    alt_search(g, bw, t, 1, -1, 1.0, limit);
+
+    int nc = 0; AltCand *cand = malloc(sizeof(AltCand)*(fw->ntouched+1));
+    for (int i=0;i<fw->ntouched;i++){ int v = fw->touched[i]; if (fw->pos[v] == -2 && bw->pos[v] == -2 && fw->dist[v] + bw->dist[v] <= limit) cand[nc++] = (AltCand){ v, fw->dist[v] + bw->dist[v] }; }
+    qsort(cand, nc, sizeof(AltCand), alt_cand_cmp);
+
+    /* on[v]: 1 + index of the first kept route through v; kept[r] maps edge (a,b) of route r */
+    int *on = calloc(g->V, sizeof(int)), *path = malloc(sizeof(int)*(g->V+1)), *mark = calloc(g->V, sizeof(int));
+    double *cum = malloc(sizeof(double)*(g->V+1));
+    LLMap **kept = calloc(k, sizeof(LLMap*));
+    int found = 0, tried = 0, stamp = 0;
+    for (int c=0; c<nc && found<k && tried<ALT_MAX_CANDIDATES; c++){
+        int v = cand[c].v;
+        if (on[v] && found) continue;   /* its route is one we already have or a detour back onto it */
+        tried++; stamp++;
+        int len = 0, simple = 1;
+        for (int x = v; x != -1; x = fw->par[x]) path[len++] = x;
+        for (int i=0, j=len-1; i<j; i++, j--){ int x = path[i]; path[i] = path[j]; path[j] = x; }
+        int iv = len - 1;
+        for (int x = bw->par[v]; x != -1; x = bw->par[x]) path[len++] = x;
+        for (int i=0;i<len && simple;i++){ if (mark[path[i]] == stamp) simple = 0; mark[path[i]] = stamp; }
+        if (!simple) continue;
+        for (int i=0;i<len;i++) cum[i] = i <= iv ? fw->dist[path[i]] : cand[c].len - bw->dist[path[i]];
+        int ok = 1;
+        for (int r=0; r<found && ok; r++){
+            double shared = 0;
+            for (int i=1;i<len;i++) if (llmap_find(kept[r], (long long)path[i-1]*g->V + path[i]) >= 0) shared += cum[i] - cum[i-1];
+            if (shared > max_overlap * D) ok = 0;
+        }
+        if (!ok) continue;
+        kept[found] = llmap_create(len*2 + 16);
+        for (int i=1;i<len;i++) llmap_put(kept[found], (long long)path[i-1]*g->V + path[i], 1);
+        for (int i=0;i<len;i++) if (!on[path[i]]) on[path[i]] = found + 1;
+        out[found].time = cand[c].len; out[found].len = len;
+        out[found].path = malloc(sizeof(int)*len); memcpy(out[found].path, path, sizeof(int)*len);
+        found++;
+    }
+    for (int r=0;r<found;r++) llmap_free(kept[r]);
+    free(kept); free(cum); free(mark); free(path); free(on); free(cand);
+    return found;
+}
+
+/* ---- many-to-many: travel-time matrix from every source to every target ----
+   one backward search per target over the incoming-edge index, stopped as soon as every
+   source has settled, so a few incidents against many units cost a few partial searches
+   instead of one full search per unit. targets are spread over a thread pool; each search
+   fills its own contiguous column, and the columns are transposed into rows at the end. */
+#define MATRIX_BLOCK 32
+
+typedef struct { Graph *g; const int *dst; int m, n, distinct; const int *first, *next; double *col; atomic_int next_t; } MatrixJob;
+static void* matrix_worker(void *arg){
+    MatrixJob *job = arg; Graph *g = job->g;
+    SearchWork *w = search_work_create(g->V);
+    int j;
+    while ((j = atomic_fetch_add(&job->next_t, 1)) < job->n){
+        double *col = job->col + (size_t)j*job->m; int left = job->distinct;
+        for (int i=0;i<job->m;i++) col[i] = INF;
+        search_work_reset(w); sw_relax(w, job->dst[j], 0.0, -1, -1);
+        while (w->hsize && left){
+            int u = sw_heap_pop(w); double du = w->dist[u];
+            if (job->first[u] >= 0){ for (int i=job->first[u]; i!=-1; i=job->next[i]) col[i] = du; left--; }
+            for (int i=g->rev_off[u]; i<g->rev_off[u+1]; i++) sw_relax(w, g->rev_from[i], du + g->edges[g->rev_edge[i]].weight, u, -1);
+        }
+    }
+    search_work_free(w); return NULL;
+}
+
+int matrix_query(Graph *g, const int *src, int m, const int *dst, int n, double *out, int threads){
+    for (int i=0;i<m;i++) if (src[i] < 0 || src[i] >= g->V) return -1;
+    for (int j=0;j<n;j++) if (dst[j] < 0 || dst[j] >= g->V) return -1;
+    if (m == 0 || n == 0) return 0;
+    graph_build_reverse(g);
+    /* rows that start at node u: first[u], then next[] (units may share a station) */
+    int *first = malloc(sizeof(int)*g->V), *next = malloc(sizeof(int)*m), distinct = 0;
+    for (int u=0;u<g->V;u++) first[u] = -1;
+    for (int i=m-1;i>=0;i--){ if (first[src[i]] == -1) distinct++; next[i] = first[src[i]]; first[src[i]] = i; }
+    MatrixJob job = { g, dst, m, n, distinct, first, next, malloc(sizeof(double)*m*(size_t)n), 0 };
+    if (threads > n) threads = n;
+    if (threads < 1) threads = 1;
+    pthread_t *tid = malloc(sizeof(pthread_t)*threads);
+    for (int i=0;i<threads;i++) pthread_create(&tid[i], NULL, matrix_worker, &job);
+    for (int i=0;i<threads;i++) pthread_join(tid[i], NULL);
+    for (int i0=0;i0<m;i0+=MATRIX_BLOCK) for (int j0=0;j0<n;j0+=MATRIX_BLOCK)
+        for (int i=i0;i<m && i<i0+MATRIX_BLOCK;i++) for (int j=j0;j<n && j<j0+MATRIX_BLOCK;j++) out[(size_t)i*n + j] = job.col[(size_t)j*m + i];
+    free(tid); free(job.col); free(next); free(first);
+    return 0;
+}
+
+/* ---- parallel delta-stepping: one-to-all over many cores ----
+   bucket b holds nodes with tentative distance in [b*delta, (b+1)*delta). the lowest bucket is
+   emptied in rounds that relax light edges (weight <= delta) of its nodes, which may refill it;
+   then heavy edges of everything it held are relaxed once. each round's frontier is relaxed by
+   all threads, handing out 64-node chunks from per-thread ranges that idle threads steal half of;
+   distances are lowered with a CAS on their bits (non-negative doubles order like their bit
+   patterns). a thread files each node it lowers into its own buckets right away; the node's
+   bucket only ever moves down by CAS, so filings racing with later lowerings leave it in the
+   bucket of its final distance and the entries left behind are skipped. thread 0 gathers the
+   next frontier from every thread's buckets between rounds. the threads live as long as the engine and wait on its barrier
+   between queries, the caller of ds_run() working as thread 0. the fixpoint is
+   min over edges of dist[u] + w, computed with the same additions as dijkstra(), so distances
+   come out bit-identical. */
+#define DS_CHUNK 64
+
+typedef struct { int *v; int len, cap; } DsVec;
+static void ds_push(DsVec *a, int v){ if (a->len == a->cap){ a->cap = a->cap ? a->cap*2 : 256; a->v = realloc(a->v, sizeof(int)*a->cap); } a->v[a->len++] = v; }
+
+struct DeltaStep {
+    Graph *g; int n, threads; double delta;
+    int *off, *mid, *to; double *w;     /* CSR with light edges first: light [off, mid), heavy [mid, off+1) */
+    atomic_ullong *dist;
+    int nb; DsVec *bucket; atomic_llong pending;    /* per thread nb cyclic slots, [t*nb, (t+1)*nb), covering every live label */
+    atomic_llong *in_bk; long long *in_r;   /* absolute bucket v is filed under (-1 none); bucket whose R holds v */
+    DsVec frontier, r;
+    atomic_ullong *range;               /* per-thread [lo, hi) of the frontier, lo in the high half */
+    long long cur; int heavy, done, quit;   /* bucket being emptied; heavy: this round relaxes R's heavy edges */
+    pthread_barrier_t bar; pthread_t *tid;
+};
+typedef struct { DeltaStep *ds; int tid; } DsArg;
+static void* ds_thread(void *arg);
+
+static inline double ds_load(atomic_ullong *a){ unsigned long long b = atomic_load_explicit(a, memory_order_relaxed); double d; memcpy(&d, &b, sizeof d); return d; }
+static inline int ds_lower(atomic_ullong *a, double nd){
+    unsigned long long nb; memcpy(&nb, &nd, sizeof nb);
+    unsigned long long old = atomic_load_explicit(a, memory_order_relaxed);
+    while (nb < old) if (atomic_compare_exchange_weak_explicit(a, &old, nb, memory_order_relaxed, memory_order_relaxed)) return 1;
+    return 0;
+}
+
+/* mean edge weight: about half the edges come out light, so a bucket needs few light rounds
+   while still holding enough nodes to keep every thread busy */
+double ds_auto_delta(Graph *g){
+    double sum = 0; int m = 0;
+    for (int e=0;e<g->edge_count;e++) if (g->edges[e].weight > 0){ sum += g->edges[e].weight; m++; }
+    return m ? sum / m : 1.0;
+}
+
+DeltaStep* ds_create(Graph *g, double delta, int threads){
+    DeltaStep *ds = calloc(1, sizeof(DeltaStep)); int n = g->V, m = g->edge_count;
+    ds->g = g; ds->n = n; ds->threads = threads < 1 ? 1 : threads; ds->delta = delta > 0 ? delta : ds_auto_delta(g);
+    ds->off = malloc(sizeof(int)*(n+1)); ds->mid = malloc(sizeof(int)*(n>0?n:1)); ds->to = malloc(sizeof(int)*(m>0?m:1)); ds->w = malloc(sizeof(double)*(m>0?m:1));
+    double maxw = 0; int k = 0;
+    for (int u=0;u<n;u++){
+        ds->off[u] = k;
+        for (int e=g->head[u]; e!=-1; e=g->edges[e].next) if (g->edges[e].weight <= ds->delta){ ds->to[k] = g->edges[e].to; ds->w[k++] = g->edges[e].weight; }
+        ds->mid[u] = k;
+        for (int e=g->head[u]; e!=-1; e=g->edges[e].next) if (g->edges[e].weight > ds->delta){ ds->to[k] = g->edges[e].to; ds->w[k++] = g->edges[e].weight; }
+        for (int e=g->head[u]; e!=-1; e=g->edges[e].next) if (g->edges[e].weight > maxw) maxw = g->edges[e].weight;
+    }
+    ds->off[n] = k;
+    ds->nb = (int)(maxw / ds->delta) + 2;
+    ds->bucket = calloc((size_t)ds->nb * ds->threads, sizeof(DsVec));
+    ds->dist = malloc(sizeof(atomic_ullong)*(n>0?n:1)); ds->in_bk = malloc(sizeof(atomic_llong)*(n>0?n:1)); ds->in_r = malloc(sizeof(long long)*(n>0?n:1));
+    ds->range = calloc(ds->threads, sizeof(atomic_ullong));
+    pthread_barrier_init(&ds->bar, NULL, ds->threads);
+    ds->tid = malloc(sizeof(pthread_t)*ds->threads); DsArg *args = malloc(sizeof(DsArg)*ds->threads);
+    for (int t=1;t<ds->threads;t++){ args[t] = (DsArg){ ds, t }; pthread_create(&ds->tid[t], NULL, ds_thread, &args[t]); }
+    pthread_barrier_wait(&ds->bar);     /* every worker has read its argument */
+    free(args);
+    return ds;
+}
+void ds_free(DeltaStep *ds){
+    if (!ds) return;
+    ds->quit = 1; pthread_barrier_wait(&ds->bar);
+    for (int t=1;t<ds->threads;t++) pthread_join(ds->tid[t], NULL);
+    pthread_barrier_destroy(&ds->bar); free(ds->tid);
+    for (int b=0;b<ds->nb*ds->threads;b++) free(ds->bucket[b].v);
+    free(ds->bucket); free(ds->range); free(ds->frontier.v); free(ds->r.v);
+    free(ds->off); free(ds->mid); free(ds->to); free(ds->w); free(ds->dist); free(ds->in_bk); free(ds->in_r); free(ds);
+}
+double ds_delta(const DeltaStep *ds){ return ds->delta; }
+
+/* files v into thread tid's buckets unless it already sits in the bucket of its distance or a
+   lower one: a lower one means another thread read v's distance after a later lowering */
+static int ds_file(DeltaStep *ds, int tid, int v){
+    long long b = (long long)(ds_load(&ds->dist[v]) / ds->delta);
+    long long old = atomic_load_explicit(&ds->in_bk[v], memory_order_relaxed);
+    do if (old != -1 && old <= b) return 0; while (!atomic_compare_exchange_weak_explicit(&ds->in_bk[v], &old, b, memory_order_relaxed, memory_order_relaxed));
+    ds_push(&ds->bucket[(size_t)tid * ds->nb + b % ds->nb], v);
+    return 1;
+}
+
+static int ds_bucket_empty(DeltaStep *ds, long long b){
+    for (int t=0;t<ds->threads;t++) if (ds->bucket[(size_t)t * ds->nb + b % ds->nb].len) return 0;
+    return 1;
+}
+
+/* thread 0, between rounds: pick the next frontier */
+static void ds_next_round(DeltaStep *ds){
+    ds->frontier.len = 0;
+    while (1){
+        if (!ds->heavy){
+            for (int t=0;t<ds->threads;t++){
+                DsVec *bk = &ds->bucket[(size_t)t * ds->nb + ds->cur % ds->nb];
+                for (int i=0;i<bk->len;i++){
+                    int v = bk->v[i];
+                    if (atomic_load_explicit(&ds->in_bk[v], memory_order_relaxed) != ds->cur) continue;   /* lowered into a later bucket since */
+                    atomic_store_explicit(&ds->in_bk[v], -1, memory_order_relaxed); ds_push(&ds->frontier, v);
+                    if (ds->in_r[v] != ds->cur){ ds->in_r[v] = ds->cur; ds_push(&ds->r, v); }
+                }
+                atomic_fetch_sub_explicit(&ds->pending, bk->len, memory_order_relaxed); bk->len = 0;
+            }
+            if (ds->frontier.len) break;
+            ds->heavy = 1;
+            DsVec t = ds->frontier; ds->frontier = ds->r; ds->r = t; ds->r.len = 0;
+            if (ds->frontier.len) break;
+        }
+        ds->heavy = 0;
+        if (atomic_load_explicit(&ds->pending, memory_order_relaxed) == 0){ ds->done = 1; return; }
+        do ds->cur++; while (ds_bucket_empty(ds, ds->cur));
+    }
+    int nf = ds->frontier.len, per = (nf + ds->threads - 1) / ds->threads;
+    for (int t=0;t<ds->threads;t++){
+        unsigned long long lo = (unsigned long long)(t*per < nf ? t*per : nf), hi = (unsigned long long)((t+1)*per < nf ? (t+1)*per : nf);
+        atomic_store(&ds->range[t], lo << 32 | hi);
+    }
+}
+
+/* a chunk from the own range, else half of the fullest-looking other range */
+static int ds_grab(DeltaStep *ds, int tid, int *lo, int *hi){
+    atomic_ullong *own = &ds->range[tid];
+    unsigned long long r = atomic_load(own);
+    while ((r >> 32) < (r & 0xffffffffu)){
+        unsigned long long a = r >> 32, b = r & 0xffffffffu, na = a + DS_CHUNK < b ? a + DS_CHUNK : b;
+        if (atomic_compare_exchange_weak(own, &r, na << 32 | b)){ *lo = (int)a; *hi = (int)na; return 1; }
+    }
+    for (int k=1;k<ds->threads;k++){
+        atomic_ullong *vic = &ds->range[(tid + k) % ds->threads];
+        unsigned long long v = atomic_load(vic);
+        while ((v >> 32) < (v & 0xffffffffu)){
+            unsigned long long a = v >> 32, b = v & 0xffffffffu, m = a + (b - a) / 2;
+            if (b - a <= DS_CHUNK){ if (atomic_compare_exchange_weak(vic, &v, b << 32 | b)){ *lo = (int)a; *hi = (int)b; return 1; } continue; }
+            if (atomic_compare_exchange_weak(vic, &v, a << 32 | m)){ atomic_store(own, m << 32 | b); return ds_grab(ds, tid, lo, hi); }
+        }
+    }
+    return 0;
+}
+
+/* one query's rounds on thread tid: thread 0 picks the frontier, then everyone relaxes it */
+static void ds_rounds(DeltaStep *ds, int tid){
+    while (1){
+        pthread_barrier_wait(&ds->bar);
+        if (tid == 0) ds_next_round(ds);
+        pthread_barrier_wait(&ds->bar);
+        if (ds->done) return;
+        int lo, hi, heavy = ds->heavy; long long filed = 0;
+        while (ds_grab(ds, tid, &lo, &hi)) for (int i=lo;i<hi;i++){
+            int u = ds->frontier.v[i]; double du = ds_load(&ds->dist[u]);
+            int a = heavy ? ds->mid[u] : ds->off[u], b = heavy ? ds->off[u+1] : ds->mid[u];
+            for (int e=a;e<b;e++) if (ds_lower(&ds->dist[ds->to[e]], du + ds->w[e])) filed += ds_file(ds, tid, ds->to[e]);
+        }
+        if (filed) atomic_fetch_add_explicit(&ds->pending, filed, memory_order_relaxed);
+    }
+}
+
+/* workers 1..threads-1: one ds_rounds() per ds_run(), woken by the same barrier as thread 0 */
+static void* ds_thread(void *arg){
+    DeltaStep *ds = ((DsArg*)arg)->ds; int tid = ((DsArg*)arg)->tid;
+    pthread_barrier_wait(&ds->bar);
+    while (1){
+        pthread_barrier_wait(&ds->bar);
+        if (ds->quit) return NULL;
+        ds_rounds(ds, tid);
+    }
+}
+
+/* one-to-all from src into dist (INF when unreachable); not reentrant on the same engine */
+void ds_run(DeltaStep *ds, int src, double *dist){
+    unsigned long long inf; double x = INF; memcpy(&inf, &x, sizeof inf);
+    /* wake the workers first: past this barrier each has seen the last query's done, and they
+       touch nothing until thread 0 meets them at the first round's barrier */
+    pthread_barrier_wait(&ds->bar);
+    for (int v=0;v<ds->n;v++){ atomic_init(&ds->dist[v], inf); atomic_init(&ds->in_bk[v], -1); ds->in_r[v] = -1; }
+    for (int b=0;b<ds->nb*ds->threads;b++) ds->bucket[b].len = 0;
+    atomic_init(&ds->pending, 0); ds->heavy = 0; ds->done = 0; ds->r.len = 0; ds->cur = 0;
+    if (src >= 0 && src < ds->n){ ds_lower(&ds->dist[src], 0.0); if (ds_file(ds, 0, src)) atomic_store(&ds->pending, 1); }
+    ds_rounds(ds, 0);
+    for (int v=0;v<ds->n;v++) dist[v] = ds_load(&ds->dist[v]);
+}
+
+/* ---- ALT: A* with landmark lower bounds ----
+   for a landmark L, d(v,t) >= d(L,t) - d(L,v) and d(v,t) >= d(v,L) - d(t,L) (triangle
+   inequality), so the largest of these over all landmarks is a potential that sees the real
+   roads, detours and one-way streets included, unlike straight-line bounds. landmarks are picked
+   one at a time:
+   - farthest: the node whose nearest landmark is farthest away by road;
+   - avoid: grow a shortest-path tree from a random root, weigh each node by how much the current
+     landmarks underestimate its distance, and put the next landmark at the leaf under the
+     heaviest subtree that has no landmark yet, i.e. where queries are worst covered.
+   selection needs each landmark's forward distances before picking the next; the backward
+   distances are then computed for all landmarks in parallel. both are stored node-major
+   (v*k + i, so one potential reads one run) as 16- or 32-bit multiples of a scale chosen to
+   fit the longest distance; bounds are taken as (qa - qb - 1) * scale, which rounding can only
+   lower. rounded bounds are admissible but not always consistent, so the search reopens a node
+   whose distance improves after it was settled; it stops when the target is popped. */
+#define ALT_SEED 777
+
+struct Alt {
+    int n, k, bits; double scale;
+    void *fwd, *bwd;                /* fwd[v*k+i] ~ d(L_i, v), bwd[v*k+i] ~ d(v, L_i); all ones = unreachable */
+    int *landmark;
+};
+struct AltWork { int n; double *g, *key; int *par, *pos, *heap, *touched; int hsize, ntouched, settled; };
+
+int alt_select_mode(const char *name){
+    if (strcmp(name, "avoid") == 0) return ALT_AVOID;
+    if (strcmp(name, "farthest") == 0) return ALT_FARTHEST;
+    return -1;
+}
+
+/* one-to-all over forward or reverse edges; same relaxations as dijkstra() */
+static void alt_sssp(Graph *g, SearchWork *w, int src, int backward, double *dist, int *parent){
+    search_work_reset(w); sw_relax(w, src, 0.0, -1, -1);
+    while (w->hsize){
+        int u = sw_heap_pop(w); double du = w->dist[u];
+        if (!backward){ for (int e=g->head[u]; e!=-1; e=g->edges[e].next) if (w->pos[g->edges[e].to] != -2) sw_relax(w, g->edges[e].to, du + g->edges[e].weight, u, 0); }
+        else for (int k=g->rev_off[u]; k<g->rev_off[u+1]; k++){ int v = g->rev_from[k]; if (w->pos[v] != -2) sw_relax(w, v, du + g->edges[g->rev_edge[k]].weight, u, 0); }
+    }
+    for (int v=0;v<g->V;v++){ dist[v] = w->dist[v]; if (parent) parent[v] = w->par[v]; }
+}
+
+static int alt_cmp_far(const void *a, const void *b){
+    double x = ((const double*)a)[0], y = ((const double*)b)[0];
+    return (x < y) - (x > y);
+}
+/* next landmark by the avoid rule; -1 when every subtree already holds one */
+static int alt_pick_avoid(Graph *g, SearchWork *w, double **fwd, int have, unsigned *seed, double *d, int *par){
+    int n = g->V, root = (int)(rng_next(seed) % (unsigned)n);
+    alt_sssp(g, w, root, 0, d, par);
+    double *order = malloc(sizeof(double)*2*n), *size = calloc(n, sizeof(double));
+    int *best = malloc(sizeof(int)*n), m = 0; char *marked = calloc(n, 1);
+    for (int i=0;i<have;i++) for (int v=0;v<n;v++) if (fwd[i][v] == 0) marked[v] = 1;
+    for (int v=0;v<n;v++){ best[v] = -1; if (d[v] < INF){ order[2*m] = d[v]; order[2*m+1] = v; m++; } }
+    qsort(order, m, 2*sizeof(double), alt_cmp_far);   /* farthest first: children before parents */
+    for (int j=0;j<m;j++){
+        int v = (int)order[2*j+1];
+        double lb = 0;
+        for (int i=0;i<have;i++) if (fwd[i][v] < INF && fwd[i][root] < INF && fwd[i][v] - fwd[i][root] > lb) lb = fwd[i][v] - fwd[i][root];
+        size[v] += d[v] - lb;
+        if (marked[v]) size[v] = 0;
+        int p = par[v];
+        if (p >= 0){
+            if (marked[v]) marked[p] = 1;
+            size[p] += size[v];
+            if (best[p] == -1 || size[v] > size[best[p]]) best[p] = v;
+        }
+    }
+    int v = -1;
+    for (int j=0;j<m;j++){ int u = (int)order[2*j+1]; if (!marked[u] && size[u] > 0 && (v == -1 || size[u] > size[v])) v = u; }
+    while (v != -1 && best[v] != -1 && size[best[v]] > 0) v = best[v];
+    free(order); free(size); free(best); free(marked);
+    return v;
+}
+/* next landmark by the farthest rule: largest road distance to the nearest landmark so far */
+static int alt_pick_farthest(Graph *g, SearchWork *w, double **fwd, int have, unsigned *seed, double *d){
+    int n = g->V, pick = -1; double far = -1;
+    if (!have){ alt_sssp(g, w, (int)(rng_next(seed) % (unsigned)n), 0, d, NULL); for (int v=0;v<n;v++) if (d[v] < INF && d[v] > far){ far = d[v]; pick = v; } return pick; }
+    for (int v=0;v<n;v++){
+        double near = INF;
+        for (int i=0;i<have;i++) if (fwd[i][v] < near) near = fwd[i][v];
+        if (near < INF && near > far){ far = near; pick = v; }
+    }
+    return far > 0 ? pick : -1;
+}
+
+typedef struct { Graph *g; Alt *a; double **bwd; atomic_int next; } AltJob;
+static void* alt_backward_worker(void *arg){
+    AltJob *job = arg; SearchWork *w = search_work_create(job->g->V);
+    for (int i; (i = atomic_fetch_add(&job->next, 1)) < job->a->k; ) alt_sssp(job->g, w, job->a->landmark[i], 1, job->bwd[i], NULL);
+    search_work_free(w);
+    return NULL;
+}
+
+Alt* alt_build(Graph *g, int landmarks, int select, int bits, int threads){
+    int n = g->V; unsigned seed = ALT_SEED;
+    if (landmarks < 0) landmarks = 0;
+    if (landmarks > n) landmarks = n;
+    if (threads < 1) threads = 1;
+    graph_build_reverse(g);
+    Alt *a = calloc(1, sizeof(Alt)); a->n = n; a->bits = bits == 16 ? 16 : 32;
+    a->landmark = malloc(sizeof(int)*(landmarks+1));
+    double **fwd = calloc(landmarks+1, sizeof(double*)), **bwd = calloc(landmarks+1, sizeof(double*));
+    double *d = malloc(sizeof(double)*(n>0?n:1)); int *par = malloc(sizeof(int)*(n>0?n:1));
+    SearchWork *w = search_work_create(n);
+    while (a->k < landmarks){
+        int v = select == ALT_FARTHEST ? alt_pick_farthest(g, w, fwd, a->k, &seed, d) : alt_pick_avoid(g, w, fwd, a->k, &seed, d, par);
+        if (v == -1) v = alt_pick_farthest(g, w, fwd, a->k, &seed, d);
+        if (v == -1) break;   /* every reachable node is already a landmark */
+        fwd[a->k] = malloc(sizeof(double)*(n>0?n:1)); alt_sssp(g, w, v, 0, fwd[a->k], NULL);
+        a->landmark[a->k++] = v;
+    }
+    search_work_free(w); free(d); free(par);
+    for (int i=0;i<a->k;i++) bwd[i] = malloc(sizeof(double)*(n>0?n:1));
+    AltJob job = { g, a, bwd, 0 };
+    int nt = threads < a->k ? threads : a->k;
+    pthread_t *tid = malloc(sizeof(pthread_t)*(nt>0?nt:1));
+    for (int t=1;t<nt;t++) pthread_create(&tid[t], NULL, alt_backward_worker, &job);
+    if (nt > 0) alt_backward_worker(&job);
+    for (int t=1;t<nt;t++) pthread_join(tid[t], NULL);
+    free(tid);
+
+    double far = 0;
+    for (int i=0;i<a->k;i++) for (int v=0;v<n;v++){ if (fwd[i][v] < INF && fwd[i][v] > far) far = fwd[i][v]; if (bwd[i][v] < INF && bwd[i][v] > far) far = bwd[i][v]; }
+    unsigned long long qinf = a->bits == 16 ? 0xffffu : 0xffffffffu;
+    a->scale = far > 0 ? far / (double)(qinf - 1) : 1.0;
+    size_t cells = (size_t)n * a->k, width = a->bits / 8;
+    a->fwd = malloc(width*(cells>0?cells:1)); a->bwd = malloc(width*(cells>0?cells:1));
+    for (int i=0;i<a->k;i++) for (int v=0;v<n;v++){
+        unsigned long long qf = fwd[i][v] < INF ? (unsigned long long)(fwd[i][v] / a->scale) : qinf;
+        unsigned long long qb = bwd[i][v] < INF ? (unsigned long long)(bwd[i][v] / a->scale) : qinf;
+        if (qf >= qinf) qf = fwd[i][v] < INF ? qinf - 1 : qinf;
+        if (qb >= qinf) qb = bwd[i][v] < INF ? qinf - 1 : qinf;
+        size_t c = (size_t)v * a->k + i;
+        if (a->bits == 16){ ((unsigned short*)a->fwd)[c] = (unsigned short)qf; ((unsigned short*)a->bwd)[c] = (unsigned short)qb; }
+        else { ((unsigned*)a->fwd)[c] = (unsigned)qf; ((unsigned*)a->bwd)[c] = (unsigned)qb; }
+    }
+    for (int i=0;i<a->k;i++){ free(fwd[i]); free(bwd[i]); }
+    free(fwd); free(bwd);
+    return a;
+}
+void alt_free(Alt *a){ if (!a) return; free(a->fwd); free(a->bwd); free(a->landmark); free(a); }
+int alt_landmarks(const Alt *a){ return a->k; }
+size_t alt_bytes(const Alt *a){ return 2 * (size_t)a->n * a->k * (a->bits / 8); }
+
+/* lower bound on d(v, t) in scale units */
+#define ALT_POTENTIAL(T, QINF) { \
+    const T *fv = (const T*)a->fwd + (size_t)v*k, *ft = (const T*)a->fwd + (size_t)t*k; \
+    const T *bv = (const T*)a->bwd + (size_t)v*k, *bt = (const T*)a->bwd + (size_t)t*k; \
+    for (int i=0;i<k;i++){ \
+        if (ft[i] != QINF && fv[i] != QINF){ long long x = (long long)ft[i] - fv[i] - 1; if (x > best) best = x; } \
+        if (bv[i] != QINF && bt[i] != QINF){ long long x = (long long)bv[i] - bt[i] - 1; if (x > best) best = x; } \
+    } }
+static double alt_potential(const Alt *a, int v, int t){
+    long long best = 0; int k = a->k;
+    if (a->bits == 16) ALT_POTENTIAL(unsigned short, 0xffffu)
+    else ALT_POTENTIAL(unsigned, 0xffffffffu)
+    return best * a->scale;
+}
+
+AltWork* alt_work_create(int n){
+    AltWork *w = malloc(sizeof(AltWork)); int m = n>0?n:1; w->n = n;
+    w->g = malloc(sizeof(double)*m); w->key = malloc(sizeof(double)*m);
+    w->par = malloc(sizeof(int)*m); w->pos = malloc(sizeof(int)*m); w->heap = malloc(sizeof(int)*m); w->touched = malloc(sizeof(int)*m);
+    for (int i=0;i<n;i++){ w->g[i] = INF; w->par[i] = -1; w->pos[i] = -1; }
+    w->hsize = w->ntouched = w->settled = 0;
+    return w;
+}
+void alt_work_free(AltWork *w){ if (!w) return; free(w->g); free(w->key); free(w->par); free(w->pos); free(w->heap); free(w->touched); free(w); }
+int alt_work_settled(const AltWork *w){ return w->settled; }
+static void alt_heap_up(AltWork *w, int i){
+    int v = w->heap[i]; double k = w->key[v];
+    while (i > 0){ int p = (i-1)>>1; if (w->key[w->heap[p]] <= k) break; w->heap[i] = w->heap[p]; w->pos[w->heap[i]] = i; i = p; }
+    w->heap[i] = v; w->pos[v] = i;
+}
+static int alt_heap_pop(AltWork *w){
+    int top = w->heap[0], v = w->heap[--w->hsize]; w->pos[top] = -2;
+    if (w->hsize == 0) return top;
+    double k = w->key[v]; int i = 0;
+    while (1){
+        int l = 2*i+1, s = i; double ks = k;
+        if (l < w->hsize && w->key[w->heap[l]] < ks){ s = l; ks = w->key[w->heap[l]]; }
+        if (l+1 < w->hsize && w->key[w->heap[l+1]] < ks) s = l+1;
+        if (s == i) break;
+        w->heap[i] = w->heap[s]; w->pos[w->heap[i]] = i; i = s;
+    }
+    w->heap[i] = v; w->pos[v] = i;
+    return top;
+}
+
+double alt_query(const Alt *a, Graph *g, AltWork *w, int s, int t, int *path, int *path_len){
+    for (int i=0;i<w->ntouched;i++){ int v = w->touched[i]; w->g[v] = INF; w->par[v] = -1; w->pos[v] = -1; }
+    w->ntouched = w->hsize = w->settled = 0;
+    if (path_len) *path_len = 0;
+    if (s < 0 || t < 0 || s >= g->V || t >= g->V) return INF;
+    w->g[s] = 0; w->key[s] = alt_potential(a, s, t); w->touched[w->ntouched++] = s;
+    w->heap[w->hsize] = s; w->pos[s] = w->hsize++;
+    while (w->hsize){
+        int u = alt_heap_pop(w); w->settled++;
+        if (u == t) break;
+        for (int e=g->head[u]; e!=-1; e=g->edges[e].next){
+            int v = g->edges[e].to; double nd = w->g[u] + g->edges[e].weight;
+            if (nd >= w->g[v]) continue;
+            /* first touch, or a reopen of a node settled under a too-optimistic bound */
+            if (w->g[v] >= INF) w->touched[w->ntouched++] = v;
+            w->g[v] = nd; w->key[v] = nd + alt_potential(a, v, t); w->par[v] = u;
+            if (w->pos[v] < 0){ w->heap[w->hsize] = v; w->pos[v] = w->hsize++; }
+            alt_heap_up(w, w->pos[v]);
+        }
+    }
+    if (w->g[t] >= INF) return INF;
+    if (path && path_len){
+        int len = 0; for (int v=t; v!=-1; v=w->par[v]) path[len++] = v;
+        for (int i=0;i<len/2;i++){ int x = path[i]; path[i] = path[len-1-i]; path[len-1-i] = x; }
+        *path_len = len;
+    }
+    return w->g[t];
+}
+
+
+/* ---- hub labels: a distance is one merge of two sorted label lists ----
+   node v keeps out-labels (h, d(v,h)) and in-labels (h, d(h,v)); d(s,t) is the minimum over hubs
+   h in both out(s) and in(t). labels come from pruned searches from every node in importance
+   order (pruned landmark labeling): the search from root r gives up on a node whose distance the
+   labels so far already certify. importance is the number of descendants a node has in a few
+   sampled shortest-path trees, so nodes that many routes cross become hubs first and prune the
+   rest. roots go threads at a time, each pruning against the labels of earlier batches only;
+   that stays exact and costs a few extra labels.
+   hubs are stored as their rank, so every list is sorted, and distances as whole milliseconds.
+   the stored form is one byte block: a header, 2n+1 list offsets, then per list varint hub-rank
+   deltas interleaved with zigzag varint distance deltas. hl_save writes the block as is and
+   hl_open maps it, so queries read straight from the page cache. */
+#define HL_MAGIC "HUBLAB1"
+#define HL_SAMPLES 16
+#define HL_INF (LLONG_MAX / 4)
+
+typedef struct { char magic[8]; int n, pad; unsigned long long sig, entries, blob_bytes; } HlHeader;
+struct HubLabels {
+    int n; long long entries;
+    const unsigned long long *off;   /* out(v) = [off[2v], off[2v+1]), in(v) = [off[2v+1], off[2v+2]) */
+    const unsigned char *blob;
+    void *base; size_t len; int mapped;
+};
+
+static long long hl_ms(double w){ return llround(w * 1000.0); }
+/* ties an index to the exact graph it was built on: node count, adjacency order and weights */
+static unsigned long long hl_signature(Graph *g){
+    unsigned long long h = 1469598103934665603ULL;
+    #define HL_MIX(x) (h = (h ^ (unsigned long long)(x)) * 1099511628211ULL)
+    HL_MIX(g->V); HL_MIX(g->edge_count);
+    for (int u=0;u<g->V;u++) for (int e=g->head[u]; e!=-1; e=g->edges[e].next){ HL_MIX(g->edges[e].to); HL_MIX(hl_ms(g->edges[e].weight)); }
+    #undef HL_MIX
+    return h;
+}
+
+typedef struct { int *hub; long long *d; int n, cap; } HlList;
+static void hl_push(HlList *l, int hub, long long d){
+    if (l->n == l->cap){ l->cap = l->cap ? l->cap*2 : 4; l->hub = realloc(l->hub, sizeof(int)*l->cap); l->d = realloc(l->d, sizeof(long long)*l->cap); }
+    l->hub[l->n] = hub; l->d[l->n++] = d;
+}
+typedef struct { int node, dir; long long d; } HlFresh;
+typedef struct { HlFresh *v; int len, cap; } HlFreshVec;
+
+typedef struct {
+    Graph *g; int n, threads; const int *order; const long long *wms;
+    HlList *list;                 /* list[2v] out-labels, list[2v+1] in-labels */
+    HlFreshVec *fresh;            /* per thread, labels found in the current batch */
+    pthread_barrier_t bar;
+} HlBuild;
+typedef struct { HlBuild *b; int tid; } HlArg;
+
+static int hl_cmp_score(const void *a, const void *b){
+    const long long *x = a, *y = b;
+    if (x[0] != y[0]) return x[0] < y[0] ? 1 : -1;
+    return (x[1] > y[1]) - (x[1] < y[1]);
+}
+/* importance order: descendants summed over sampled shortest-path trees, most first */
+static void hl_order(Graph *g, const long long *wms, int *order){
+    int n = g->V, samples = n < HL_SAMPLES ? n : HL_SAMPLES; unsigned seed = 12345;
+    long long *score = malloc(sizeof(long long)*2*(n>0?n:1));
+    int *settled = malloc(sizeof(int)*(n>0?n:1)), *below = calloc(n>0?n:1, sizeof(int));
+    SearchWork *w = search_work_create(n);
+    for (int v=0;v<n;v++){ score[2*v] = 0; score[2*v+1] = v; }
+    for (int s=0;s<samples;s++){
+        int src = (int)(rng_next(&seed) % (unsigned)n), ns = 0;
+        search_work_reset(w); sw_relax(w, src, 0.0, -1, -1);
+        while (w->hsize){
+            int u = sw_heap_pop(w); settled[ns++] = u;
+            for (int e=g->head[u]; e!=-1; e=g->edges[e].next) if (w->pos[g->edges[e].to] != -2) sw_relax(w, g->edges[e].to, w->dist[u] + wms[e], u, 0);
+        }
+        for (int i=ns-1;i>=0;i--){ int v = settled[i]; below[v] += 1; score[2*v] += below[v]; if (w->par[v] >= 0) below[w->par[v]] += below[v]; }
+        for (int i=0;i<ns;i++) below[settled[i]] = 0;
+    }
+    /* nodes no sample reached score 0 and keep index order */
+    qsort(score, n, 2*sizeof(long long), hl_cmp_score);
+    for (int i=0;i<n;i++) order[i] = (int)score[2*i+1];
+    free(score); free(settled); free(below); search_work_free(w);
+}
+
+/* pruned search from root (rank) in one direction: forward fills in-labels, backward out-labels */
+static void hl_search(HlBuild *b, SearchWork *w, long long *tmp, HlFreshVec *fv, int root, int backward){
+    Graph *g = b->g;
+    const HlList *mine = &b->list[2*root + (backward ? 1 : 0)];   /* root side of the pair */
+    for (int i=0;i<mine->n;i++) tmp[mine->hub[i]] = mine->d[i];
+    search_work_reset(w); sw_relax(w, root, 0.0, -1, -1);
+    while (w->hsize){
+        int u = sw_heap_pop(w); long long du = (long long)w->dist[u];
+        const HlList *other = &b->list[2*u + (backward ? 0 : 1)];
+        int pruned = 0;
+        for (int i=0;i<other->n;i++) if (tmp[other->hub[i]] + other->d[i] <= du){ pruned = 1; break; }
+        if (pruned) continue;
+        if (fv->len == fv->cap){ fv->cap = fv->cap ? fv->cap*2 : 256; fv->v = realloc(fv->v, sizeof(HlFresh)*fv->cap); }
+        fv->v[fv->len++] = (HlFresh){ u, backward ? 0 : 1, du };
+        if (!backward){ for (int e=g->head[u]; e!=-1; e=g->edges[e].next) if (w->pos[g->edges[e].to] != -2) sw_relax(w, g->edges[e].to, w->dist[u] + b->wms[e], u, 0); }
+        else for (int k=g->rev_off[u]; k<g->rev_off[u+1]; k++){ int v = g->rev_from[k]; if (w->pos[v] != -2) sw_relax(w, v, w->dist[u] + b->wms[g->rev_edge[k]], u, 0); }
+    }
+    for (int i=0;i<mine->n;i++) tmp[mine->hub[i]] = HL_INF;
+}
+
+static void* hl_worker(void *arg){
+    HlBuild *b = ((HlArg*)arg)->b; int tid = ((HlArg*)arg)->tid;
+    SearchWork *w = search_work_create(b->n);
+    long long *tmp = malloc(sizeof(long long)*(b->n>0?b->n:1));
+    for (int i=0;i<b->n;i++) tmp[i] = HL_INF;
+    for (int base=0; base<b->n; base+=b->threads){
+        int rank = base + tid;
+        if (rank < b->n){
+            /* labels hold ranks, so tmp is indexed by rank; the root's own rank is rank */
+            hl_search(b, w, tmp, &b->fresh[tid], b->order[rank], 0);
+            hl_search(b, w, tmp, &b->fresh[tid], b->order[rank], 1);
+        }
+        pthread_barrier_wait(&b->bar);
+        if (tid == 0)   /* thread order is rank order, so every list stays sorted */
+            for (int t=0;t<b->threads;t++){
+                HlFreshVec *fv = &b->fresh[t];
+                for (int i=0;i<fv->len;i++) hl_push(&b->list[2*fv->v[i].node + fv->v[i].dir], base + t, fv->v[i].d);
+                fv->len = 0;
+            }
+        pthread_barrier_wait(&b->bar);
+    }
+    search_work_free(w); free(tmp);
+    return NULL;
+}
+
+static size_t hl_put(unsigned char *p, unsigned long long z){
+    size_t k = 0;
+    while (z >= 0x80){ p[k++] = (unsigned char)(z | 0x80); z >>= 7; }
+    p[k++] = (unsigned char)z; return k;
+}
+static inline const unsigned char* hl_next(const unsigned char *p, int *hub, long long *d){
+    unsigned long long z = 0; int shift = 0;
+    while (*p & 0x80){ z |= (unsigned long long)(*p++ & 0x7f) << shift; shift += 7; }
+    z |= (unsigned long long)*p++ << shift; *hub += (int)z;
+    z = 0; shift = 0;
+    while (*p & 0x80){ z |= (unsigned long long)(*p++ & 0x7f) << shift; shift += 7; }
+    z |= (unsigned long long)*p++ << shift; *d += (long long)(z >> 1) ^ -(long long)(z & 1);
+    return p;
+}
+static HubLabels* hl_wrap(void *base, size_t len, int mapped){
+    HubLabels *hl = calloc(1, sizeof(HubLabels)); const HlHeader *h = base;
+    hl->n = h->n; hl->entries = (long long)h->entries; hl->base = base; hl->len = len; hl->mapped = mapped;
+    hl->off = (const unsigned long long*)((const char*)base + sizeof(HlHeader));
+    hl->blob = (const unsigned char*)(hl->off + 2*(size_t)h->n + 1);
+    return hl;
+}
+
+HubLabels* hl_build(Graph *g, int threads){
+    int n = g->V; if (threads < 1) threads = 1;
+    graph_build_reverse(g);
+    long long *wms = malloc(sizeof(long long)*(g->edge_count>0?g->edge_count:1));
+    for (int e=0;e<g->edge_count;e++) wms[e] = hl_ms(g->edges[e].weight);
+    int *order = malloc(sizeof(int)*(n>0?n:1)); hl_order(g, wms, order);
+
+    HlBuild b = { .g = g, .n = n, .threads = threads, .order = order, .wms = wms, .list = calloc(2*(size_t)(n>0?n:1), sizeof(HlList)), .fresh = calloc(threads, sizeof(HlFreshVec)) };
+    pthread_barrier_init(&b.bar, NULL, threads);
+    pthread_t *tid = malloc(sizeof(pthread_t)*threads); HlArg *args = malloc(sizeof(HlArg)*threads);
+    for (int t=1;t<threads;t++){ args[t] = (HlArg){ &b, t }; pthread_create(&tid[t], NULL, hl_worker, &args[t]); }
+    args[0] = (HlArg){ &b, 0 }; hl_worker(&args[0]);
+    for (int t=1;t<threads;t++) pthread_join(tid[t], NULL);
+    pthread_barrier_destroy(&b.bar); free(tid); free(args);
+
+    /* pack: worst case two 10-byte varints per entry */
+    unsigned long long entries = 0;
+    for (int k=0;k<2*n;k++) entries += b.list[k].n;
+    size_t head = sizeof(HlHeader) + sizeof(unsigned long long)*(2*(size_t)n + 1);
+    unsigned char *buf = malloc(head + 20*entries + 1);
+    unsigned long long *off = (unsigned long long*)(buf + sizeof(HlHeader)); size_t pos = 0;
+    for (int k=0;k<2*n;k++){
+        HlList *l = &b.list[k]; int ph = 0; long long pd = 0;
+        off[k] = pos;
+        for (int i=0;i<l->n;i++){
+            long long dd = l->d[i] - pd;
+            pos += hl_put(buf + head + pos, (unsigned long long)(l->hub[i] - ph));
+            pos += hl_put(buf + head + pos, ((unsigned long long)dd << 1) ^ (unsigned long long)(dd >> 63));
+            ph = l->hub[i]; pd = l->d[i];
+        }
+        free(l->hub); free(l->d);
+    }
+    off[2*n] = pos;
+    HlHeader *h = (HlHeader*)buf; memset(h, 0, sizeof(*h));
+    memcpy(h->magic, HL_MAGIC, sizeof(HL_MAGIC)); h->n = n; h->sig = hl_signature(g); h->entries = entries; h->blob_bytes = pos;
+    buf = realloc(buf, head + pos + 1);
+    for (int t=0;t<threads;t++) free(b.fresh[t].v);
+    free(b.fresh); free(b.list); free(order); free(wms);
+    return hl_wrap(buf, head + pos, 0);
+}
+
+int hl_save(const HubLabels *hl, const char *path){
+    FILE *f = fopen(path, "wb"); if (!f){ perror(path); return -1; }
+    int ok = fwrite(hl->base, 1, hl->len, f) == hl->len;
+    if (fclose(f) != 0) ok = 0;
+    if (!ok){ perror(path); return -1; }
+    return 0;
+}
+HubLabels* hl_open(const char *path, Graph *g){
+    int fd = open(path, O_RDONLY); if (fd < 0) return NULL;
+    struct stat st; void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(HlHeader)) p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED){ fprintf(stderr, "%s: not a hub label file\n", path); return NULL; }
+    const HlHeader *h = p; size_t len = st.st_size;
+    size_t need = sizeof(HlHeader) + sizeof(unsigned long long)*(2*(size_t)(h->n >= 0 ? h->n : 0) + 1) + h->blob_bytes;
+    if (memcmp(h->magic, HL_MAGIC, sizeof(HL_MAGIC)) != 0 || h->n < 0 || need > len){ fprintf(stderr, "%s: not a hub label file\n", path); munmap(p, len); return NULL; }
+    if (h->n != g->V || h->sig != hl_signature(g)){ fprintf(stderr, "%s: built for another graph or other travel times\n", path); munmap(p, len); return NULL; }
+    return hl_wrap(p, len, 1);
+}
+void hl_free(HubLabels *hl){
+    if (!hl) return;
+    if (hl->mapped) munmap(hl->base, hl->len); else free(hl->base);
+    free(hl);
+}
+
+static long long hl_query_ms(const HubLabels *hl, int s, int t){
+    const unsigned char *a = hl->blob + hl->off[2*s], *ae = hl->blob + hl->off[2*s+1];
+    const unsigned char *b = hl->blob + hl->off[2*t+1], *be = hl->blob + hl->off[2*t+2];
+    long long best = HL_INF, da = 0, db = 0; int ha = 0, hb = 0;
+    if (a == ae || b == be) return HL_INF;
+    a = hl_next(a, &ha, &da); b = hl_next(b, &hb, &db);
+    while (1){
+        if (ha == hb){
+            if (da + db < best) best = da + db;
+            if (a == ae || b == be) break;
+            a = hl_next(a, &ha, &da); b = hl_next(b, &hb, &db);
+        } else if (ha < hb){ if (a == ae) break; a = hl_next(a, &ha, &da); }
+        else { if (b == be) break; b = hl_next(b, &hb, &db); }
+    }
+    return best;
+}
+double hl_distance(const HubLabels *hl, int s, int t){
+    if (s < 0 || t < 0 || s >= hl->n || t >= hl->n) return INF;
+    long long d = hl_query_ms(hl, s, t);
+    return d >= HL_INF ? INF : d / 1000.0;
+}
+int hl_best_target(const HubLabels *hl, int src, const int *dst, int m, double *time){
+    int best = -1; long long bd = HL_INF;
+    if (src < 0 || src >= hl->n) return -1;
+    for (int i=0;i<m;i++){
+        if (dst[i] < 0 || dst[i] >= hl->n) continue;
+        long long d = hl_query_ms(hl, src, dst[i]); if (d < bd){ bd = d; best = i; }
+    }
+    if (time) *time = best == -1 ? INF : bd / 1000.0;
+    return best;
+}
+/* walks from s along edges whose weight plus the remaining label distance is exact */
+int hl_path(const HubLabels *hl, Graph *g, int s, int t, int *path, int cap){
+    if (s < 0 || t < 0 || s >= hl->n || t >= hl->n) return 0;
+    long long d = hl_query_ms(hl, s, t); if (d >= HL_INF) return 0;
+    int len = 0, u = s;
+    if (cap < 1) return -1;
+    path[len++] = u;
+    while (u != t){
+        int next = -1;
+        for (int e=g->head[u]; e!=-1 && next==-1; e=g->edges[e].next){
+            long long w = hl_ms(g->edges[e].weight), r = hl_query_ms(hl, g->edges[e].to, t);
+            if (r < HL_INF && w + r == d){ next = g->edges[e].to; d = r; }
+        }
+        if (next == -1 || len >= cap || len > g->V) return -1;
+        path[len++] = u = next;
+    }
+    return len;
+}
+void hl_stats(const HubLabels *hl, long long *entries, size_t *bytes){
+    if (entries) *entries = hl->entries;
+    if (bytes) *bytes = hl->len;
+}
+
+
+/* ---- memory accounting: used vs reserved bytes per structure ----
+   reserved counts what each structure holds from the allocator: unfilled capacity (the graph
+   arrays double as they grow) and malloc's per-block header and rounding, which dominates for
+   the one-block-per-string names. the budget is checked where memory grows in bulk: the csv
+   loaders before each doubling, rt_load, and rt_update_roads before publishing a snapshot. */
+static atomic_size_t mem_limit;
+void mem_set_budget(size_t bytes){ atomic_store(&mem_limit, bytes); }
+size_t mem_budget(void){ return atomic_load(&mem_limit); }
+size_t mem_block(size_t n){
+    if (!n) return 0;
+    if (n >= (128u << 10)) return (n + 16 + 4095) & ~(size_t)4095;   /* served by mmap */
+    size_t c = (n + 8 + 15) & ~(size_t)15; return c < 32 ? 32 : c;
+}
+void mem_add(MemReport *r, const char *what, size_t used, size_t reserved){
+    if (r->n < MEM_ITEMS_MAX) r->item[r->n++] = (MemItem){ what, used, reserved };
+}
+size_t mem_total(const MemReport *r, size_t *used){
+    size_t u = 0, t = 0;
+    for (int i=0;i<r->n;i++){ u += r->item[i].used; t += r->item[i].reserved; }
+    if (used) *used = u;
+    return t;
+}
+void mem_print(const MemReport *r, FILE *f){
+    fprintf(f, "%-22s %14s %14s\n", "structure", "used bytes", "reserved bytes");
+    for (int i=0;i<r->n;i++) fprintf(f, "%-22s %14zu %14zu\n", r->item[i].what, r->item[i].used, r->item[i].reserved);
+    size_t u, t = mem_total(r, &u);
+    fprintf(f, "%-22s %14zu %14zu\n", "total", u, t);
+    size_t b = mem_budget();
+    if (b) fprintf(f, "%-22s %14s %14zu\n", "budget", "", b);
+}
+int mem_over_budget(const MemReport *r, const char *what, FILE *f){
+    size_t b = mem_budget(), t = mem_total(r, NULL);
+    if (!b || t <= b) return 0;
+    fprintf(f, "%s: %zu bytes reserved, over the memory budget of %zu\n", what, t, b);
+    mem_print(r, f);
+    return 1;
+}
+static void strings_memory(char *const *name, char *const *type, int n, MemReport *r){
+    size_t u = 0, t = 0;
+    for (int i=0;i<n;i++){
+        if (name[i]){ size_t l = strlen(name[i]) + 1; u += l; t += mem_block(l); }
+        if (type[i]){ size_t l = strlen(type[i]) + 1; u += l; t += mem_block(l); }
+    }
+    mem_add(r, "name/type strings", u, t);
+}
+void graph_memory(const Graph *g, MemReport *r){
+    size_t nc = g->node_cap;
+    mem_add(r, "node arrays", (size_t)g->V * (sizeof(int) + sizeof(long long) + 2*sizeof(double) + 2*sizeof(char*)),
+            mem_block(sizeof(int)*nc) + mem_block(sizeof(long long)*nc) + 2*mem_block(sizeof(double)*nc) + 2*mem_block(sizeof(char*)*nc) + mem_block(sizeof(Graph)));
+    mem_add(r, "edges", sizeof(Edge)*g->edge_count, mem_block(sizeof(Edge)*g->edge_cap));
+    mem_add(r, "id map", sizeof(LLMapEntry)*g->idmap->size, mem_block(sizeof(LLMapEntry)*g->idmap->cap) + mem_block(sizeof(LLMap)));
+    if (!g->shared_names) strings_memory(g->name, g->type, g->V, r);
+    if (g->rev_edges >= 0){
+        int m = g->rev_edges > 0 ? g->rev_edges : 1;
+        mem_add(r, "reverse index", sizeof(int)*((size_t)g->V + 1 + 2*(size_t)g->rev_edges),
+                mem_block(sizeof(int)*((size_t)g->V + 1)) + 2*mem_block(sizeof(int)*m));
+    }
+}
+size_t search_work_bytes(int n){
+    size_t m = n > 0 ? n : 1;
+    return mem_block(sizeof(SearchWork)) + mem_block(sizeof(double)*m) + 4*mem_block(sizeof(int)*m) + mem_block(m);
+}
+void geo_memory(const Graph *g, const GeoIndex *gi, const GeoBound *gb, MemReport *r){
+    if (gi){
+        /* built with room for every node of g, placeholders included */
+        size_t m = gi->n, cap = g->V > 0 ? g->V : 1;
+        mem_add(r, "spatial index", m * (sizeof(int) + 3*sizeof(double) + 1), mem_block(sizeof(GeoIndex)) + mem_block(sizeof(int)*cap) + mem_block(3*sizeof(double)*cap) + mem_block(cap));
+    }
+    if (gb){
+        size_t m = gb->n > 0 ? gb->n : 1;
+        mem_add(r, "straight-line bounds", (size_t)gb->n * (3*sizeof(double) + 1), mem_block(sizeof(GeoBound)) + mem_block(3*sizeof(double)*m) + mem_block(m));
+    }
+}
+void route_cache_memory(RouteCache *rc, MemReport *r){
+    size_t u = 0, t = mem_block(sizeof(RouteCache));
+    for (int i=0;i<ROUTE_SHARDS;i++){
+        RouteShard *sh = &rc->shard[i];
+        pthread_rwlock_rdlock(&sh->lock);
+        u += sh->bytes;
+        for (int j=0;j<sh->ring_n;j++) t += mem_block(sizeof(RouteEntry) + sh->ring[j]->enc_len);
+        t += mem_block(sizeof(RouteEntry*)*sh->nbuckets) + mem_block(sizeof(RouteEntry*)*sh->ring_cap);
+        pthread_rwlock_unlock(&sh->lock);
+    }
+    mem_add(r, "route cache", u, t);
+}
+
+
+/* ---- stable API (routing.h) ----
+   queries see an immutable snapshot reached through one atomic pointer. writers, serialized
+   among themselves, copy the current snapshot, change the copy, publish it with a pointer swap
+   and retire the old one under the epoch that swap started. a query announces the epoch it began
+   in by claiming a reader slot with a CAS, so it never takes a lock or waits for a writer; a
+   retired snapshot is freed once no slot holds an older epoch. the slot also owns the search
+   workspace its queries use. past RT_READERS concurrent queries the extra ones take overflow slots
+   from a lock-free list, pushed on first need and reused until rt_free, so no query ever waits. name/type strings are shared by every snapshot and live until
+   rt_free, so pointers handed out by rt_name stay valid. */
+#define RT_CACHE_BYTES (16u << 20)
+#define RT_READERS 256
+
+typedef struct RtSnap { Graph *g; GeoIndex *geo; GeoBound *gb; MetricGraph *mg; unsigned long long retired; struct RtSnap *next; } RtSnap;
+typedef struct { SearchWork *w, *w2; MetricWork *mw; int *path; int cap, mcap; } RtWork;
+typedef struct RtReader { _Alignas(64) atomic_ullong epoch; RtWork work; struct RtReader *next; } RtReader;   /* epoch 0: free */
+struct RtGraph {
+    _Atomic(RtSnap*) snap;
+    atomic_ullong epoch;
+    RtReader reader[RT_READERS];
+    _Atomic(RtReader*) overflow;   /* slots past RT_READERS, newest first; never unlinked before rt_free */
+    atomic_int noverflow;
+    RouteCache *rc;
+    pthread_mutex_t wmu;        /* writers only */
+    RtSnap *retired;            /* oldest last; guarded by wmu */
+    char **names, **types; int nstrings;
+    atomic_size_t work_bytes;   /* held by reader slot workspaces */
+};
+
+typedef struct { RtSnap *s; RtReader *r; RtGraph *g; } RtRead;
+static _Thread_local unsigned rt_hint;
+static RtRead rt_enter(const RtGraph *crg){
+    RtGraph *rg = (RtGraph*)crg;
+    for (unsigned n = 0, i = rt_hint % RT_READERS; n < RT_READERS; n++, i = (i + 1) % RT_READERS){
+        RtReader *r = &rg->reader[i]; unsigned long long idle = 0;
+        if (atomic_load_explicit(&r->epoch, memory_order_relaxed) == 0 && atomic_compare_exchange_strong(&r->epoch, &idle, atomic_load(&rg->epoch))){
+            rt_hint = i;
+            return (RtRead){ atomic_load(&rg->snap), r, rg };
+        }
+    }
+    /* every fixed slot is busy: a free overflow slot, or a new one pushed on the list. the epoch is
+       announced by the CAS (or the push) before the snapshot is read, as above */
+    for (RtReader *r = atomic_load(&rg->overflow); r; r = r->next){
+        unsigned long long idle = 0;
+        if (atomic_load_explicit(&r->epoch, memory_order_relaxed) == 0 && atomic_compare_exchange_strong(&r->epoch, &idle, atomic_load(&rg->epoch)))
+            return (RtRead){ atomic_load(&rg->snap), r, rg };
+    }
+    RtReader *r = aligned_alloc(64, (sizeof(RtReader) + 63) / 64 * 64); memset(&r->work, 0, sizeof(r->work));
+    atomic_init(&r->epoch, atomic_load(&rg->epoch));
+    r->next = atomic_load(&rg->overflow);
+    while (!atomic_compare_exchange_weak(&rg->overflow, &r->next, r));
+    atomic_fetch_add(&rg->noverflow, 1);
+    return (RtRead){ atomic_load(&rg->snap), r, rg };
+}
+static void rt_leave(RtRead rd){ atomic_store_explicit(&rd.r->epoch, 0, memory_order_release); }
+/* the slot's workspace, regrown when updates have added nodes since it was made */
+static RtWork* rt_work(RtRead rd, int two){
+    RtWork *k = &rd.r->work; int n = rd.s->g->V;
+    RtGraph *rg = rd.g;
+    if (k->cap < n){
+        if (k->w) atomic_fetch_sub(&rg->work_bytes, search_work_bytes(k->cap) * (k->w2 ? 2 : 1) + mem_block(sizeof(int)*((size_t)k->cap+1)));
+        search_work_free(k->w); search_work_free(k->w2); free(k->path);
+        k->w = search_work_create(n); k->w2 = NULL; k->path = malloc(sizeof(int)*(n+1)); k->cap = n;
+        atomic_fetch_add(&rg->work_bytes, search_work_bytes(n) + mem_block(sizeof(int)*((size_t)n+1)));
+    }
+    if (two && !k->w2){ k->w2 = search_work_create(k->cap); atomic_fetch_add(&rg->work_bytes, search_work_bytes(k->cap)); }
+    return k;
+}
+
+static RtSnap* rt_snap_make(Graph *g){
+    graph_build_reverse(g);
+    RtSnap *s = calloc(1, sizeof(RtSnap));
+    s->g = g; s->geo = geo_build(g); s->gb = geobound_build(g); s->mg = metricgraph_build(g);
+    return s;
+}
+static void rt_snap_free(RtSnap *s){ metricgraph_free(s->mg); geobound_free(s->gb); geo_free(s->geo); graph_free(s->g); free(s); }
+/* frees retired snapshots that no running query can still hold; wmu held */
+static void rt_reclaim(RtGraph *rg){
+    unsigned long long oldest = ULLONG_MAX;
+    for (int i=0;i<RT_READERS;i++){ unsigned long long e = atomic_load(&rg->reader[i].epoch); if (e && e < oldest) oldest = e; }
+    for (RtReader *o = atomic_load(&rg->overflow); o; o = o->next){ unsigned long long e = atomic_load(&o->epoch); if (e && e < oldest) oldest = e; }
+    for (RtSnap **p = &rg->retired; *p; ){
+        if ((*p)->retired <= oldest){ RtSnap *s = *p; *p = s->next; rt_snap_free(s); }
+        else p = &(*p)->next;
+    }
+}
+
+/* footprint with s as the current snapshot; retired ones are counted together */
+static void rt_mem_report(const RtGraph *rg, const RtSnap *s, MemReport *r){
+    graph_memory(s->g, r);
+    strings_memory(rg->names, rg->types, rg->nstrings, r);
+    mem_add(r, "string tables", 2*sizeof(char*)*(size_t)rg->nstrings, 2*mem_block(sizeof(char*)*((size_t)rg->nstrings+1)));
+    geo_memory(s->g, s->geo, s->gb, r);
+    mem_add(r, "metric graph", s->mg ? sizeof(int)*((size_t)s->mg->n+1) + sizeof(MetricEdge)*(size_t)s->mg->off[s->mg->n] : 0, metricgraph_bytes(s->mg));
+    route_cache_memory(rg->rc, r);
+    size_t ws = atomic_load(&((RtGraph*)rg)->work_bytes);
+    mem_add(r, "query workspaces", ws, ws);
+    size_t nov = (size_t)atomic_load(&((RtGraph*)rg)->noverflow);
+    mem_add(r, "reader slots", sizeof(RtGraph) + nov*sizeof(RtReader), (sizeof(RtGraph) + 63) / 64 * 64 + 16 + nov*mem_block((sizeof(RtReader) + 63) / 64 * 64));
+    size_t ru = 0, rt = 0;
+    for (const RtSnap *o = rg->retired; o; o = o->next){
+        MemReport x = {0}; graph_memory(o->g, &x); geo_memory(o->g, o->geo, o->gb, &x);
+        size_t u; rt += mem_total(&x, &u) + metricgraph_bytes(o->mg); ru += u + metricgraph_bytes(o->mg);
+    }
+    if (rg->retired) mem_add(r, "retired snapshots", ru, rt);
+}
+
+RtGraph* rt_load(const char *nodes_csv, const char *edges_csv){
+    Graph *g = graph_create(INITIAL_NODES);
+    if (load_nodes(g, nodes_csv) < 0 || load_edges(g, edges_csv) < 0){ graph_free(g); return NULL; }
+    graph_reorder(g, REORDER_HILBERT);
+    size_t sz = (sizeof(RtGraph) + 63) / 64 * 64;
+    RtGraph *rg = aligned_alloc(64, sz); memset(rg, 0, sz);
+    rg->nstrings = g->V; rg->names = malloc(sizeof(char*)*(g->V+1)); rg->types = malloc(sizeof(char*)*(g->V+1));
+    memcpy(rg->names, g->name, sizeof(char*)*g->V); memcpy(rg->types, g->type, sizeof(char*)*g->V);
+    g->shared_names = 1;
+    atomic_init(&rg->snap, rt_snap_make(g)); atomic_init(&rg->epoch, 1);
+    for (int i=0;i<RT_READERS;i++) atomic_init(&rg->reader[i].epoch, 0);
+    atomic_init(&rg->overflow, NULL); atomic_init(&rg->noverflow, 0);
+    atomic_init(&rg->work_bytes, 0);
+    rg->rc = route_cache_create(RT_CACHE_BYTES);
+    pthread_mutex_init(&rg->wmu, NULL);
+    MemReport r = {0}; rt_mem_report(rg, atomic_load(&rg->snap), &r);
+    if (mem_over_budget(&r, nodes_csv, stderr)){ rt_free(rg); return NULL; }
+    return rg;
+}
+/* no query may be running */
+void rt_free(RtGraph *rg){
+    if (!rg) return;
+    for (int i=0;i<RT_READERS;i++){ RtWork *k = &rg->reader[i].work; search_work_free(k->w); search_work_free(k->w2); metric_work_free(k->mw); free(k->path); }
+    for (RtReader *o = atomic_load(&rg->overflow), *next; o; o = next){ RtWork *k = &o->work; next = o->next; search_work_free(k->w); search_work_free(k->w2); metric_work_free(k->mw); free(k->path); free(o); }
+    while (rg->retired){ RtSnap *s = rg->retired; rg->retired = s->next; rt_snap_free(s); }
+    rt_snap_free(atomic_load(&rg->snap));
+    for (int i=0;i<rg->nstrings;i++){ free(rg->names[i]); free(rg->types[i]); }
+    free(rg->names); free(rg->types);
+    pthread_mutex_destroy(&rg->wmu); route_cache_free(rg->rc); free(rg);
+}
+
+unsigned long long rt_update_roads(RtGraph *rg, const RtRoadUpdate *u, int n){
+    pthread_mutex_lock(&rg->wmu);
+    RtSnap *old = atomic_load(&rg->snap);
+    Graph *g = graph_clone(old->g);
+    for (int i=0;i<n;i++){
+        if (!(u[i].seconds >= 0) || u[i].seconds >= INF) continue;
+        int a = graph_get_or_create(g, u[i].from), b = graph_get_or_create(g, u[i].to), hit = 0;
+        for (int e=g->head[a]; e!=-1; e=g->edges[e].next) if (g->edges[e].to == b){ graph_set_edge_weight(g, e, u[i].seconds); hit = 1; }
+        /* a new road is as long as the straight line, when both ends are placed */
+        if (!hit) graph_add_edge(g, a, b, u[i].seconds, (g->lat[a]==0.0 && g->lon[a]==0.0) || (g->lat[b]==0.0 && g->lon[b]==0.0) ? 0.0 : 1000*haversine(g->lat[a], g->lon[a], g->lat[b], g->lon[b]));
+    }
+    g->version++;   /* even an empty batch publishes a distinct version */
+    RtSnap *next = rt_snap_make(g);
+    if (mem_budget()){
+        /* the old snapshot stays until readers leave it, so both count */
+        MemReport r = {0}; rt_mem_report(rg, next, &r);
+        MemReport o = {0}; graph_memory(old->g, &o); geo_memory(old->g, old->geo, old->gb, &o);
+        size_t ou, ot = mem_total(&o, &ou) + metricgraph_bytes(old->mg); mem_add(&r, "previous snapshot", ou + metricgraph_bytes(old->mg), ot);
+        if (mem_over_budget(&r, "road update", stderr)){ rt_snap_free(next); pthread_mutex_unlock(&rg->wmu); return 0; }
+    }
+    atomic_store(&rg->snap, next);
+    old->retired = atomic_fetch_add(&rg->epoch, 1) + 1;
+    old->next = rg->retired; rg->retired = old;
+    rt_reclaim(rg);
+    unsigned long long v = g->version;
+    pthread_mutex_unlock(&rg->wmu);
+    return v;
+}
+
+unsigned long long rt_version(const RtGraph *rg){ RtRead rd = rt_enter(rg); unsigned long long v = rd.s->g->version; rt_leave(rd); return v; }
+
+int rt_node_count(const RtGraph *rg){ RtRead rd = rt_enter(rg); int n = rd.s->g->V; rt_leave(rd); return n; }
+long long rt_ext_id(const RtGraph *rg, int node){
+    RtRead rd = rt_enter(rg); Graph *g = rd.s->g;
+    long long x = node >= 0 && node < g->V ? g->ext_id[node] : -1;
+    rt_leave(rd); return x;
+}
+const char* rt_name(const RtGraph *rg, int node){
+    RtRead rd = rt_enter(rg); Graph *g = rd.s->g;
+    const char *x = node >= 0 && node < g->V ? g->name[node] : NULL;
+    rt_leave(rd); return x;
+}
+const char* rt_type(const RtGraph *rg, int node){
+    RtRead rd = rt_enter(rg); Graph *g = rd.s->g;
+    const char *x = node >= 0 && node < g->V ? g->type[node] : NULL;
+    rt_leave(rd); return x;
+}
+int rt_coords(const RtGraph *rg, int node, double *lat, double *lon){
+    RtRead rd = rt_enter(rg); Graph *g = rd.s->g; int ok = 0;
+    if (node >= 0 && node < g->V){
+        if (lat) *lat = g->lat[node];
+        if (lon) *lon = g->lon[node];
+        ok = g->lat[node] != 0.0 || g->lon[node] != 0.0;
+    }
+    rt_leave(rd); return ok;
+}
+int rt_neighbors(const RtGraph *rg, int node, int *to, double *times, int cap){
+    RtRead rd = rt_enter(rg); Graph *g = rd.s->g; int d = 0;
+    if (node >= 0 && node < g->V)
+        for (int e=g->head[node]; e!=-1; e=g->edges[e].next, d++) if (d < cap){ if (to) to[d] = g->edges[e].to; if (times) times[d] = g->edges[e].weight; }
+    rt_leave(rd); return d;
+}
+int rt_node_matches(const RtGraph *rg, int node, const char *key){
+    RtRead rd = rt_enter(rg); Graph *g = rd.s->g;
+    int x = node >= 0 && node < g->V && node_matches_type_or_name(g, node, key);
+    rt_leave(rd); return x;
+}
+
+int rt_find_ext(const RtGraph *rg, long long ext_id){ RtRead rd = rt_enter(rg); int v = llmap_find(rd.s->g->idmap, ext_id); rt_leave(rd); return v; }
+int rt_find_name(const RtGraph *rg, const char *query){
+    if (!query) return -1;
+    RtRead rd = rt_enter(rg); int v = find_node_by_name(rd.s->g, query); rt_leave(rd); return v;
+}
+int rt_nearest_node(const RtGraph *rg, double lat, double lon, double *dist_km){ RtRead rd = rt_enter(rg); int v = geo_nearest(rd.s->geo, lat, lon, dist_km); rt_leave(rd); return v; }
+/* ---- road snapping: a GPS fix projected onto the nearest road segment ----
+   candidate roads are those touching the SNAP_NODES nearest nodes (both directions, through the
+   reverse index); each is projected in a local flat-earth frame, which is exact enough at street scale. */
+#define SNAP_NODES 8
+#define KM_PER_DEG (EARTH_R_KM * DEG2RAD)
+static void snap_edge(const Graph *g, int from, int e, double lat, double lon, double kx, RtRoadPos *best){
+    int to = g->edges[e].to;
+    if ((g->lat[from]==0.0 && g->lon[from]==0.0) || (g->lat[to]==0.0 && g->lon[to]==0.0)) return;
+    double ax = (g->lon[from]-lon)*kx, ay = (g->lat[from]-lat)*KM_PER_DEG, bx = (g->lon[to]-lon)*kx, by = (g->lat[to]-lat)*KM_PER_DEG;
+    double dx = bx-ax, dy = by-ay, len2 = dx*dx + dy*dy, t = len2 > 0 ? -(ax*dx + ay*dy) / len2 : 0;
+    t = t < 0 ? 0 : t > 1 ? 1 : t;
+    double px = ax + t*dx, py = ay + t*dy, km = sqrt(px*px + py*py);
+    if (best->from >= 0 && km >= best->km) return;
+    best->from = from; best->to = to; best->frac = t; best->km = km; best->seconds = g->edges[e].weight; best->back_seconds = RT_UNREACHABLE;
+}
+int rt_snap_road(const RtGraph *rg, double lat, double lon, RtRoadPos *pos){
+    RtRead rd = rt_enter(rg); const Graph *g = rd.s->g;
+    int cand[SNAP_NODES], k = geo_knearest(rd.s->geo, lat, lon, SNAP_NODES, cand, NULL);
+    double kx = KM_PER_DEG * cos(lat*DEG2RAD);
+    RtRoadPos best = { -1, -1, 0, 0, 0, RT_UNREACHABLE };
+    for (int i=0;i<k;i++){
+        int u = cand[i];
+        for (int e=g->head[u]; e!=-1; e=g->edges[e].next) snap_edge(g, u, e, lat, lon, kx, &best);
+        for (int j=g->rev_off[u]; j<g->rev_off[u+1]; j++) snap_edge(g, g->rev_from[j], g->rev_edge[j], lat, lon, kx, &best);
+    }
+    if (best.from >= 0)
+        for (int e=g->head[best.to]; e!=-1; e=g->edges[e].next) if (g->edges[e].to == best.from && g->edges[e].weight < best.back_seconds) best.back_seconds = g->edges[e].weight;
+    rt_leave(rd);
+    if (best.from < 0) return 0;
+    *pos = best; return 1;
+}
+int rt_resolve(const RtGraph *rg, const char *location, double *snap_km){
+    double lat, lon, km;
+    if (snap_km) *snap_km = -1;
+    if (!location) return -1;
+    RtRead rd = rt_enter(rg); int v = -1;
+    if (parse_latlon(location, &lat, &lon)){ v = geo_nearest(rd.s->geo, lat, lon, &km); if (v >= 0 && snap_km) *snap_km = km; rt_leave(rd); return v; }
+    char *end; long long ext = strtoll(location, &end, 10);
+    if (end != location && *end == 0) v = llmap_find(rd.s->g->idmap, ext);
+    if (v < 0) v = find_node_by_name(rd.s->g, location);
+    rt_leave(rd); return v;
+}
+
+double rt_route(RtGraph *rg, int src, int dst, int *path, int *path_len){
+    RtRead rd = rt_enter(rg); Graph *g = rd.s->g; int len = 0;
+    if (src < 0 || src >= g->V || dst < 0 || dst >= g->V){ rt_leave(rd); if (path_len) *path_len = 0; return RT_UNREACHABLE; }
+    RtWork *k = rt_work(rd, 0);
+    double d = route_query(g, rg->rc, k->w, src, dst, path ? path : k->path, &len);
+    rt_leave(rd);
+    if (path_len) *path_len = len;
+    return d;
+}
+_Static_assert((int)RT_FASTEST == ORDER_TIME && (int)RT_SHORTEST == ORDER_LENGTH && (int)RT_FASTEST_THEN_SHORTEST == ORDER_TIME_LENGTH && (int)RT_SHORTEST_THEN_FASTEST == ORDER_LENGTH_TIME, "RtOrder mirrors RouteOrder");
+int rt_route_by(RtGraph *rg, int src, int dst, RtOrder order, double *seconds, double *meters, int *path, int *path_len){
+    if (path_len) *path_len = 0;
+    RtRead rd = rt_enter(rg); const MetricGraph *mg = rd.s->mg;
+    if (src < 0 || src >= mg->n || dst < 0 || dst >= mg->n || order < RT_FASTEST || order > RT_SHORTEST_THEN_FASTEST){ rt_leave(rd); return -1; }
+    RtWork *k = &rd.r->work;
+    if (k->mcap < mg->n){
+        if (k->mw) atomic_fetch_sub(&rg->work_bytes, metric_work_bytes(k->mcap));
+        metric_work_free(k->mw); k->mw = metric_work_create(mg->n); k->mcap = mg->n;
+        atomic_fetch_add(&rg->work_bytes, metric_work_bytes(mg->n));
+    }
+    int found = metric_route(mg, k->mw, (RouteOrder)order, src, dst, seconds, meters, path, path_len);
+    if (!found){ if (seconds) *seconds = RT_UNREACHABLE; if (meters) *meters = RT_UNREACHABLE; }
+    rt_leave(rd); return found;
+}
+
+/* answers for the three station kinds are cached under dst = -(kind+1); the path ends at the station */
+static int rt_kind_key(const char *type){
+    char t[64]; if (strlen(type) >= sizeof(t)) return 0;
+    str_to_lower(type, t);
+    for (int k=0;k<KIND_COUNT;k++) if (strcmp(t, kind_names[k]) == 0) return -(k+1);
+    return 0;
+}
+int rt_nearest_of_type(RtGraph *rg, int src, const char *type, double *time, int *path, int *path_len, rt_progress_fn progress, void *ctx){
+    if (path_len) *path_len = 0;
+    RtRead rd = rt_enter(rg); Graph *g = rd.s->g;
+    if (src < 0 || src >= g->V || !type){ rt_leave(rd); return -1; }
+    RtWork *k = rt_work(rd, 0);
+    int key = rt_kind_key(type), len = 0, found = -1; double d = RT_UNREACHABLE;
+    if (key && route_cache_get(rg->rc, src, key, g->version, &d, k->path, &len, g->V)) found = k->path[len-1];
+    else if ((found = nearest_of_type_query(g, k->w, src, type, progress, ctx)) >= 0){
+        d = k->w->dist[found];
+        for (int x = found; x != -1; x = k->w->par[x]) k->path[len++] = x;
+        for (int i=0, j=len-1; i<j; i++, j--){ int x = k->path[i]; k->path[i] = k->path[j]; k->path[j] = x; }
+        if (key) route_cache_put(rg->rc, src, key, g->version, d, k->path, len);
+    }
+    if (found >= 0){
+        if (time) *time = d;
+        if (path) memcpy(path, k->path, sizeof(int)*len);
+        if (path_len) *path_len = len;
+    }
+    rt_leave(rd);
+    return found;
+}
+
+int rt_alternatives(RtGraph *rg, int src, int dst, int k, double max_stretch, double max_overlap, RtRoutes *out){
+    memset(out, 0, sizeof(*out));
+    if (k < 1) return 0;
+    AltRoute *alt = malloc(sizeof(AltRoute)*k);
+    RtRead rd = rt_enter(rg); RtWork *wk = rt_work(rd, 1);
+    int n = alt_routes_query(rd.s->g, wk->w, wk->w2, src, dst, k, max_stretch, max_overlap, alt), total = 0;
+    rt_leave(rd);
+    for (int r=0;r<n;r++) total += alt[r].len;
+    out->count = n; out->times = malloc(sizeof(double)*(n+1)); out->offsets = malloc(sizeof(int)*(n+1)); out->nodes = malloc(sizeof(int)*(total+1));
+    out->offsets[0] = 0;
+    for (int r=0;r<n;r++){
+        out->times[r] = alt[r].time; memcpy(out->nodes + out->offsets[r], alt[r].path, sizeof(int)*alt[r].len);
+        out->offsets[r+1] = out->offsets[r] + alt[r].len; free(alt[r].path);
+    }
+    free(alt);
+    return n;
+}
+void rt_routes_free(RtRoutes *routes){ if (!routes) return; free(routes->times); free(routes->offsets); free(routes->nodes); memset(routes, 0, sizeof(*routes)); }
+
+int rt_best_source(RtGraph *rg, const int *src, int m, int dst, double *time){
+    RtRead rd = rt_enter(rg); RtWork *k = rt_work(rd, 0);
+    int i = best_source_query(rd.s->g, rd.s->gb, rg->rc, k->w, k->path, src, m, dst, time, NULL);
+    rt_leave(rd);
+    return i;
+}
+int rt_matrix(RtGraph *rg, const int *src, int m, const int *dst, int n, double *out){
+    RtRead rd = rt_enter(rg); int r = matrix_query(rd.s->g, src, m, dst, n, out, default_threads()); rt_leave(rd); return r;
+}
+int rt_route_many(RtGraph *rg, int src, const int *dst, int n, double *out){
+    RtRead rd = rt_enter(rg); Graph *g = rd.s->g;
+    int bad = src < 0 || src >= g->V;
+    for (int j=0;j<n && !bad;j++) bad = dst[j] < 0 || dst[j] >= g->V;
+    if (bad){ rt_leave(rd); return -1; }
+    SearchWork *w = rt_work(rd, 0)->w; int left = n;
+    search_work_reset(w); sw_relax(w, src, 0.0, -1, -1);
+    while (w->hsize && left){
+        int u = sw_heap_pop(w); double du = w->dist[u];
+        for (int j=0;j<n;j++) if (dst[j] == u) left--;     /* a repeated target counts each time */
+        for (int e=g->head[u]; e!=-1; e=g->edges[e].next) sw_relax(w, g->edges[e].to, du + g->edges[e].weight, u, -1);
+    }
+    for (int j=0;j<n;j++) out[j] = w->pos[dst[j]] == -2 ? w->dist[dst[j]] : RT_UNREACHABLE;
+    rt_leave(rd); return 0;
+}
+
+void rt_cache_stats(const RtGraph *rg, unsigned long long *hits, unsigned long long *misses){ route_cache_counters(rg->rc, hits, misses); }
+
+int rt_memory(const RtGraph *rg, RtMemItem *items, int cap){
+    MemReport r = {0};
+    pthread_mutex_lock(&((RtGraph*)rg)->wmu);   /* keeps the retired list still */
+    RtRead rd = rt_enter(rg); rt_mem_report(rg, rd.s, &r); rt_leave(rd);
+    pthread_mutex_unlock(&((RtGraph*)rg)->wmu);
+    for (int i=0;i<r.n && i<cap;i++){ items[i].what = r.item[i].what; items[i].used = r.item[i].used; items[i].reserved = r.item[i].reserved; }
+    return r.n;
+}
+void rt_set_memory_budget(size_t bytes){ mem_set_budget(bytes); }
@@ -0,0 +1,120 @@
+/* routing.h
+   Routing core shared by graph.c, main.c (console dispatcher) and cd.cpp (GTK dispatcher).
+   Stable C API, usable from C and C++:
+   - nodes are dense handles 0 .. rt_node_count()-1, valid for the life of the RtGraph
+     (numbered for memory locality, not file order; show and store rt_ext_id instead)
+   - times are seconds of travel, taken from edges.csv travel_time; lengths are metres, from
+     length_meters
+   - every query is thread-safe and lock-free against updates: it runs on the graph version
+     that was current when it started, while rt_update_roads publishes the next one; routes
+     are cached per graph version (rt_version), so repeated queries are cheap. there is no cap
+     on concurrent queries: past 256 at once, each extra one allocates a reader slot (and its
+     workspace) the first time, kept for reuse until rt_free
+   Build:
+     gcc -std=c11 -O2 -pthread -c routing.c     then link routing.o with -pthread -lm
+*/
+#ifndef ROUTING_H
+#define ROUTING_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct RtGraph RtGraph;
+
+#define RT_UNREACHABLE 1e18
+
+/* polled every 256 settled nodes of a long search; return nonzero to abandon it */
+typedef int (*rt_progress_fn)(void *ctx, int settled, int total);
+
+/* loads nodes.csv / edges.csv; NULL (with the reason on stderr) when a file cannot be read */
+RtGraph* rt_load(const char *nodes_csv, const char *edges_csv);
+void rt_free(RtGraph *rg);
+/* changes whenever travel times change; results from different versions must not be mixed */
+unsigned long long rt_version(const RtGraph *rg);
+
+/* new travel time for every road from -> to (external ids); a road that does not exist yet is
+   added, with placeholder nodes for unknown ids (existing handles never change). the whole batch
+   becomes visible at once; returns the new version. writers queue behind each other, readers
+   are never blocked. */
+typedef struct { long long from, to; double seconds; } RtRoadUpdate;
+unsigned long long rt_update_roads(RtGraph *rg, const RtRoadUpdate *updates, int n);
+
+int rt_node_count(const RtGraph *rg);
+long long rt_ext_id(const RtGraph *rg, int node);
+const char* rt_name(const RtGraph *rg, int node);   /* NULL for unnamed junctions */
+const char* rt_type(const RtGraph *rg, int node);   /* NULL when untyped */
+/* 0 for placeholder nodes that only appear in edges.csv and have no position */
+int rt_coords(const RtGraph *rg, int node, double *lat, double *lon);
+/* outgoing roads of node: writes up to cap neighbours (and their travel times when times
+   is given) and returns the full out-degree */
+int rt_neighbors(const RtGraph *rg, int node, int *to, double *times, int cap);
+/* case-insensitive substring match on the node's type or name */
+int rt_node_matches(const RtGraph *rg, int node, const char *key);
+
+int rt_find_ext(const RtGraph *rg, long long ext_id);
+int rt_find_name(const RtGraph *rg, const char *query);
+int rt_nearest_node(const RtGraph *rg, double lat, double lon, double *dist_km);
+/* the road a GPS fix lies on: frac of the way along from -> to (0..1), km off the road.
+   seconds is the road's travel time, back_seconds the to -> from road's (RT_UNREACHABLE when
+   one-way). 0 when no positioned road is near. */
+typedef struct { int from, to; double frac, km, seconds, back_seconds; } RtRoadPos;
+int rt_snap_road(const RtGraph *rg, double lat, double lon, RtRoadPos *pos);
+/* "lat,lon" (snapped, *snap_km set), an external id, or a name; -1 when nothing matches.
+   *snap_km is -1 when the location was not a GPS fix. */
+int rt_resolve(const RtGraph *rg, const char *location, double *snap_km);
+
+/* fastest src -> dst travel time, RT_UNREACHABLE when there is no path.
+   path (capacity rt_node_count()) and path_len may be NULL. */
+double rt_route(RtGraph *rg, int src, int dst, int *path, int *path_len);
+/* what makes a route best: the fastest, the shortest, or one of them with ties going to the
+   other (fastest, then shortest among equally fast). rt_route is RT_FASTEST. */
+typedef enum { RT_FASTEST, RT_SHORTEST, RT_FASTEST_THEN_SHORTEST, RT_SHORTEST_THEN_FASTEST } RtOrder;
+/* best src -> dst route under order, in one search; *seconds and *meters get its travel time and
+   length (RT_UNREACHABLE without a path; either may be NULL). times count in whole milliseconds
+   and lengths in whole centimetres, so equal routes tie exactly. 1 found, 0 no path, -1 bad
+   node or order. */
+int rt_route_by(RtGraph *rg, int src, int dst, RtOrder order, double *seconds, double *meters, int *path, int *path_len);
+/* nearest node matching type (see rt_node_matches) by travel time from src; -1 when none is
+   reachable or progress cancelled the search. time, path and path_len may be NULL. */
+int rt_nearest_of_type(RtGraph *rg, int src, const char *type, double *time, int *path, int *path_len, rt_progress_fn progress, void *ctx);
+
+/* index into src of the source with the fastest route to dst (lowest index on ties), -1 when none
+   reaches it; time may be NULL. sources whose straight-line bound cannot beat the best road time
+   found so far are never routed, so large candidate lists stay cheap. */
+int rt_best_source(RtGraph *rg, const int *src, int m, int dst, double *time);
+
+/* up to k routes src -> dst, fastest first. every later route is at most max_stretch times
+   the fastest (e.g. 1.3) and shares at most max_overlap (e.g. 0.5) of the fastest's time
+   with each route before it. route r is nodes[offsets[r] .. offsets[r+1]), times[r] seconds. */
+typedef struct { int count; double *times; int *offsets; int *nodes; } RtRoutes;
+int rt_alternatives(RtGraph *rg, int src, int dst, int k, double max_stretch, double max_overlap, RtRoutes *out);
+void rt_routes_free(RtRoutes *routes);
+
+/* m x n travel times, out[i*n + j] = src[i] -> dst[j] (RT_UNREACHABLE when cut off), row i
+   contiguous. much cheaper than m rt_route calls when n is small; 0, or -1 on a bad node. */
+int rt_matrix(RtGraph *rg, const int *src, int m, const int *dst, int n, double *out);
+/* src -> dst[j] travel times into out[j] (RT_UNREACHABLE when cut off) from a single search that
+   stops once every target is reached: the one-source case of rt_matrix, for a few hundred targets
+   at most. 0, or -1 on a bad node. */
+int rt_route_many(RtGraph *rg, int src, const int *dst, int n, double *out);
+
+void rt_cache_stats(const RtGraph *rg, unsigned long long *hits, unsigned long long *misses);
+
+/* footprint per structure (node arrays, edges, id map, strings, indexes, route cache, query
+   workspaces): used = what live data needs, reserved = what is held from the allocator. writes up
+   to cap items and returns how many there are; what is a static string. */
+typedef struct { const char *what; size_t used, reserved; } RtMemItem;
+int rt_memory(const RtGraph *rg, RtMemItem *items, int cap);
+/* process-wide cap on reserved bytes, 0 (the default) for none. loading and rt_update_roads
+   refuse to go past it: the footprint goes to stderr and rt_load returns NULL, rt_update_roads 0
+   (the update is dropped). */
+void rt_set_memory_budget(size_t bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
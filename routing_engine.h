@@ -0,0 +1,337 @@
+/* routing_engine.h
+   Engine internals of the routing core (routing.c): graph storage, search workspace,
+   overlay, spatial index, isochrones and route cache. Used by routing.c and the graph.c
+   tools; frontends should stay on the stable API in routing.h. C11 only.
+*/
+#ifndef ROUTING_ENGINE_H
+#define ROUTING_ENGINE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define INF 1e18
+
+
+typedef struct { long long key; int val; char used; } LLMapEntry;
+typedef struct { LLMapEntry *table; int cap; int size; } LLMap;
+LLMap* llmap_create(int cap);
+void llmap_free(LLMap *m);
+int llmap_find(LLMap *m, long long key);
+void llmap_put(LLMap *m, long long key, int val);
+
+typedef struct { int to; int next; double weight, length; } Edge;   /* weight: travel seconds, length: metres */
+typedef struct {
+    int V;
+    int node_cap;
+    int edge_count;
+    int edge_cap;
+    Edge *edges;
+    int *head;
+    long long *ext_id;
+    double *lat, *lon;
+    char **name, **type;
+    LLMap *idmap;
+    int *rev_off, *rev_from, *rev_edge;  /* incoming edges, see graph_build_reverse */
+    int rev_edges;                       /* edge_count when they were built, -1 never */
+    unsigned long long version;  /* bumped whenever edge weights change; keys cached routes */
+    int shared_names;            /* name/type strings belong to someone else (graph_clone) */
+} Graph;
+
+Graph* graph_create(int node_cap);
+void graph_ensure_nodecap(Graph *g, int need);
+int graph_add_node(Graph *g, long long ext, double lat, double lon, const char *name, const char *type);
+void graph_add_edge(Graph *g, int u, int v, double w, double length);
+void graph_set_edge_weight(Graph *g, int e, double w);
+int graph_get_or_create(Graph *g, long long ext);
+Graph* graph_clone(const Graph *g);
+void graph_free(Graph *g);
+void graph_build_grid(Graph *g, int rows, int cols, unsigned seed);
+void graph_scale_region(Graph *g, double lat, double lon, double radius_km, double factor);
+
+/* renumbers nodes for cache locality (external ids stay put); invalidates node and edge indices */
+enum { REORDER_NONE, REORDER_HILBERT, REORDER_BFS, REORDER_RCM };
+int reorder_mode(const char *name);    /* "none", "hilbert", "bfs" or "rcm"; -1 otherwise */
+const char* reorder_name(int mode);
+void graph_reorder(Graph *g, int mode);
+void graph_permute(Graph *g, const int *order);   /* order[new] = old */
+
+void str_trim(char *s);
+void str_to_lower(const char *src, char *dst);
+int node_matches_type_or_name(Graph *g, int idx, const char *requested);
+int name_match_ci(const char *node_name, const char *query);
+int type_is_allowed(const char *type);
+int type_matches_requested(const char *type, const char *requested);
+int load_nodes(Graph *g, const char *fname);
+int load_edges(Graph *g, const char *fname);
+
+double now_sec(void);
+int default_threads(void);
+unsigned rng_next(unsigned *s);
+
+void dijkstra(Graph *g, int src, double *dist, int *parent);
+int find_node_by_name(Graph *g, const char *query);
+int find_nearest_of_type_from(Graph *g, int start_idx, const char *requested_type);
+
+
+/* ---- integer weights ---- */
+/* CSR copy with whole-second weights for Dial's bucket queue; version is the graph's at build */
+#define DIAL_MAX_WEIGHT (1 << 20)
+#define UINF 0xffffffffu
+typedef struct { int n; int *off, *to; unsigned *w; unsigned maxw; unsigned long long version; } IntGraph;
+enum { QUEUE_HEAP, QUEUE_DIAL };
+int queue_mode(const char *name);    /* "heap" or "dial"; -1 otherwise */
+/* NULL when some weight is fractional, negative or above DIAL_MAX_WEIGHT */
+IntGraph* intgraph_build(Graph *g);
+void intgraph_free(IntGraph *ig);
+/* one-to-all in O(V + E + max distance); unreachable nodes get UINF */
+void dial_dijkstra(const IntGraph *ig, int src, unsigned *dist, int *parent);
+void shortest_all(Graph *g, const IntGraph *ig, int mode, int src, double *dist, int *parent);
+
+
+/* ---- search workspace ---- */
+/* per-thread search state: indexed binary heap with decrease-key, lazily reset through the touched list */
+typedef struct { double *dist; int *par; signed char *plvl; int *touched; int ntouched; int *heap, *pos; int hsize; } SearchWork;
+SearchWork* search_work_create(int n);
+void search_work_free(SearchWork *w);
+void search_work_reset(SearchWork *w);
+static inline void sw_heap_up(SearchWork *w, int i){
+    int v = w->heap[i]; double k = w->dist[v];
+    while (i > 0){ int p = (i-1)>>1; if (w->dist[w->heap[p]] <= k) break; w->heap[i] = w->heap[p]; w->pos[w->heap[i]] = i; i = p; }
+    w->heap[i] = v; w->pos[v] = i;
+}
+static inline int sw_heap_pop(SearchWork *w){
+    int top = w->heap[0], v = w->heap[--w->hsize]; w->pos[top] = -2;
+    if (w->hsize == 0) return top;
+    double k = w->dist[v]; int i = 0;
+    while (1){
+        int l = 2*i+1, s = i; double ks = k;
+        if (l < w->hsize && w->dist[w->heap[l]] < ks){ s = l; ks = w->dist[w->heap[l]]; }
+        if (l+1 < w->hsize && w->dist[w->heap[l+1]] < ks) s = l+1;
+        if (s == i) break;
+        w->heap[i] = w->heap[s]; w->pos[w->heap[i]] = i; i = s;
+    }
+    w->heap[i] = v; w->pos[v] = i;
+    return top;
+}
+/* pos: -1 unseen, -2 settled, otherwise slot in the heap */
+static inline void sw_relax(SearchWork *w, int v, double nd, int u, int lvl){
+    if (nd < w->dist[v]){
+        if (w->pos[v] == -1){ w->touched[w->ntouched++] = v; w->heap[w->hsize] = v; w->pos[v] = w->hsize++; }
+        w->dist[v] = nd; w->par[v] = u; w->plvl[v] = (signed char)lvl;
+        sw_heap_up(w, w->pos[v]);
+    }
+}
+
+/* settles nodes from src in travel-time order and stops at the first one matching requested
+   (type or name, see node_matches_type_or_name). progress, when given, is polled every 256
+   settled nodes; a nonzero return abandons the search. returns the node, its time in w->dist
+   and its tree in w->par, or -1 when nothing matches or the search was abandoned. */
+int nearest_of_type_query(Graph *g, SearchWork *w, int src, const char *requested, int (*progress)(void *ctx, int settled, int total), void *ctx);
+
+
+/* ---- customizable route planning ---- */
+#define CRP_MAX_LEVELS 4
+
+typedef struct {
+    int levels, n;
+    int *cell[CRP_MAX_LEVELS];          /* cell of each node per level, level 0 is finest */
+    int ncells[CRP_MAX_LEVELS];
+    int *bnd_off[CRP_MAX_LEVELS];       /* boundary nodes of cell c: bnd[l][bnd_off[l][c] .. bnd_off[l][c+1]) */
+    int *bnd[CRP_MAX_LEVELS];
+    int *bnd_pos[CRP_MAX_LEVELS];       /* slot of node in its cell's boundary list, -1 if interior */
+    long long *clq_off[CRP_MAX_LEVELS]; /* row-major b*b clique matrix of cell c starts at clq[l][clq_off[l][c]] */
+    double *clq[CRP_MAX_LEVELS];
+} Crp;
+
+Crp* crp_build(Graph *g, int levels, const int *cell_size);
+void crp_customize(Crp *c, Graph *g, int threads);
+/* path needs uw, a second SearchWork for unpacking shortcuts; both may be NULL for the distance alone */
+double crp_query(Crp *c, Graph *g, int s, int t, SearchWork *w, SearchWork *uw, int *path, int *path_len);
+void crp_free(Crp *c);
+
+
+/* ---- region shards ---- */
+/* region[v] in 0..k-1 for every node: geographic regions cut by inertial-flow bisection */
+void shard_partition(Graph *g, int k, int *region);
+/* dir/shard-<r>.nodes.csv and .edges.csv per region (roads inside it, one row per direction) and
+   dir/overlay.csv with the roads between regions; 0, or -1 with the reason on stderr */
+int shard_write(Graph *g, const int *region, int k, const char *dir);
+
+
+/* ---- spatial index ---- */
+#define EARTH_R_KM 6371.0
+#define DEG2RAD (3.14159265358979323846 / 180.0)
+
+typedef struct { int n; int *idx; double *xyz; unsigned char *axis; } GeoIndex;
+
+double haversine(double lat1, double lon1, double lat2, double lon2);
+GeoIndex* geo_build(Graph *g);
+void geo_free(GeoIndex *gi);
+int geo_knearest(const GeoIndex *gi, double lat, double lon, int k, int *out, double *out_km);
+int geo_nearest(const GeoIndex *gi, double lat, double lon, double *dist_km);
+int parse_latlon(const char *s, double *lat, double *lon);
+
+/* unit-sphere node positions as structure of arrays (has[v] 0 for placeholders) and the fastest
+   straight-line speed of any road; kmps is 0, disabling pruning, when some road has no measurable
+   speed. bounds are only used while version matches the graph's. */
+typedef struct { int n; double *x, *y, *z; unsigned char *has; double kmps; unsigned long long version; } GeoBound;
+GeoBound* geobound_build(Graph *g);
+void geobound_free(GeoBound *gb);
+/* out[i] = chord from (x[i],y[i],z[i]) to unit vector t in km, never more than the great-circle
+   distance. AVX2 when the cpu has it, otherwise the scalar loop */
+void geo_lower_bound_km(const double *x, const double *y, const double *z, int n, const double *t, double *out);
+void geo_lower_bound_km_scalar(const double *x, const double *y, const double *z, int n, const double *t, double *out);
+
+
+/* ---- isochrones ---- */
+#define ISO_MAX_THRESH 8
+enum { KIND_HOSPITAL, KIND_POLICE, KIND_FIRE, KIND_COUNT };
+
+/* bit s of bits[(t*n + v)*words ...] is set when station s reaches node v within thresh[t] seconds */
+typedef struct {
+    int n, nthresh, nst, words;
+    double thresh[ISO_MAX_THRESH];
+    int *station; signed char *kind;
+    atomic_ullong *bits;
+    unsigned long long *kind_mask;  /* kind_mask[k*words + w]: stations of kind k */
+} Coverage;
+
+int station_kind(Graph *g, int idx);
+Coverage* coverage_compute(Graph *g, const double *thresh, int nthresh, int threads);
+void coverage_free(Coverage *cv);
+int coverage_count(const Coverage *cv, int t, int v, int k);
+void coverage_write_csv(const Coverage *cv, Graph *g, FILE *f);
+void coverage_write_bin(const Coverage *cv, Graph *g, FILE *f);
+
+
+/* ---- route cache ---- */
+typedef struct RouteCache RouteCache;
+
+RouteCache* route_cache_create(size_t cap_bytes);
+void route_cache_free(RouteCache *rc);
+int route_cache_get(RouteCache *rc, int src, int dst, unsigned long long version, double *dist, int *path, int *path_len, int path_cap);
+void route_cache_put(RouteCache *rc, int src, int dst, unsigned long long version, double dist, const int *path, int path_len);
+void route_cache_counters(RouteCache *rc, unsigned long long *hits, unsigned long long *misses);
+void route_cache_print_stats(RouteCache *rc, FILE *f);
+double route_query(Graph *g, RouteCache *rc, SearchWork *w, int s, int t, int *path, int *path_len);
+/* index into src of the fastest source to dst (lowest index on ties), -1 when none reaches it.
+   sources are routed in straight-line lower-bound order and the rest skipped once no bound can
+   beat the best time; gb may be NULL. path is scratch of V ints; routed counts route_query calls. */
+int best_source_query(Graph *g, const GeoBound *gb, RouteCache *rc, SearchWork *w, int *path, const int *src, int m, int dst, double *time, int *routed);
+
+
+/* ---- alternative routes ---- */
+typedef struct { double time; int len; int *path; } AltRoute;
+
+/* (re)builds the incoming-edge index when edges were added since the last build; not thread-safe */
+void graph_build_reverse(Graph *g);
+/* up to k routes s -> t, fastest first, each at most max_stretch times the fastest and sharing at
+   most max_overlap of the fastest's time with every earlier one. fills out[] (paths malloc'd,
+   caller frees) and returns the count. */
+int alt_routes_query(Graph *g, SearchWork *fw, SearchWork *bw, int s, int t, int k, double max_stretch, double max_overlap, AltRoute *out);
+
+
+/* ---- multi-metric routing ---- */
+/* CSR with both metrics of a road packed in one 12-byte record, travel time in whole milliseconds
+   and length in whole centimetres (integer sums, so equal routes really tie); version is the
+   graph's at build. an order picks the metric that ranks routes, and for the lexicographic ones
+   the metric that breaks ties, settled in one search. */
+enum { METRIC_TIME, METRIC_LENGTH };
+typedef enum { ORDER_TIME, ORDER_LENGTH, ORDER_TIME_LENGTH, ORDER_LENGTH_TIME, ORDER_COUNT } RouteOrder;
+typedef struct { int to; unsigned w[2]; } MetricEdge;   /* w[METRIC_TIME] ms, w[METRIC_LENGTH] cm */
+typedef struct { int n; int *off; MetricEdge *e; unsigned long long version; } MetricGraph;
+typedef struct MetricWork MetricWork;
+int route_order(const char *name);     /* "time", "length", "time,length" or "length,time"; -1 otherwise */
+const char* route_order_name(int order);
+MetricGraph* metricgraph_build(const Graph *g);
+void metricgraph_free(MetricGraph *mg);
+size_t metricgraph_bytes(const MetricGraph *mg);
+MetricWork* metric_work_create(int n);
+void metric_work_free(MetricWork *w);
+size_t metric_work_bytes(int n);
+/* best src -> dst route under order, or every node's when dst is -1; 1 when dst was reached.
+   time (s) and length (m) are the chosen route's totals in both metrics; path and path_len,
+   time and length may be NULL. */
+int metric_route(const MetricGraph *mg, MetricWork *w, RouteOrder order, int src, int dst, double *time, double *length, int *path, int *path_len);
+/* lexicographic orders the classic way, for comparison: a full search on the first metric, then
+   a second over the roads on some best route (tight edges), ranked by the other. same answer. */
+int metric_route_two_pass(const MetricGraph *mg, MetricWork *w, RouteOrder order, int src, int dst, double *time, double *length, int *path, int *path_len);
+
+
+/* ---- many-to-many ---- */
+/* out[i*n + j] = travel time src[i] -> dst[j] (INF when unreachable), row-major, rows contiguous.
+   one early-stopped backward search per target, targets in parallel. -1 on a bad node. */
+int matrix_query(Graph *g, const int *src, int m, const int *dst, int n, double *out, int threads);
+
+
+/* ---- ALT: A* with landmark potentials ---- */
+/* landmarks (avoid or farthest selection) with forward and backward distances stored as 16- or
+   32-bit multiples of a scale; 16 bits halves the memory for slightly weaker bounds. more
+   landmarks: tighter bounds, fewer settled nodes, 2 * n * landmarks * bits/8 bytes. rebuild after
+   travel times change. */
+enum { ALT_AVOID, ALT_FARTHEST };
+typedef struct Alt Alt;
+typedef struct AltWork AltWork;
+int alt_select_mode(const char *name);   /* "avoid" or "farthest"; -1 otherwise */
+Alt* alt_build(Graph *g, int landmarks, int select, int bits, int threads);
+void alt_free(Alt *a);
+int alt_landmarks(const Alt *a);
+size_t alt_bytes(const Alt *a);
+AltWork* alt_work_create(int n);
+void alt_work_free(AltWork *w);
+int alt_work_settled(const AltWork *w);   /* nodes settled by the last query */
+/* exact s -> t travel time (INF when unreachable); path (capacity V) and path_len may be NULL */
+double alt_query(const Alt *a, Graph *g, AltWork *w, int s, int t, int *path, int *path_len);
+
+
+/* ---- hub labels ---- */
+/* distance index: every query is a merge of two short sorted lists, no search. exact to the
+   millisecond on the graph it was built for; build again after travel times change */
+typedef struct HubLabels HubLabels;
+HubLabels* hl_build(Graph *g, int threads);
+int hl_save(const HubLabels *hl, const char *path);
+/* maps a file written by hl_save; NULL when missing, or (with the reason on stderr) when it is
+   not a label file or was built for a different graph, node order or travel times */
+HubLabels* hl_open(const char *path, Graph *g);
+void hl_free(HubLabels *hl);
+double hl_distance(const HubLabels *hl, int s, int t);   /* INF when unreachable */
+/* index into dst of the closest target from src (lowest index on ties), -1 when none reachable */
+int hl_best_target(const HubLabels *hl, int src, const int *dst, int m, double *time);
+/* s .. t into path (cap nodes); 0 when unreachable, -1 when cap is too small */
+int hl_path(const HubLabels *hl, Graph *g, int s, int t, int *path, int cap);
+void hl_stats(const HubLabels *hl, long long *entries, size_t *bytes);
+
+
+/* ---- memory accounting ---- */
+/* used: bytes the live data needs; reserved: bytes held from the allocator, i.e. capacity not yet
+   filled plus malloc's per-block header and rounding. item names are static strings. */
+#define MEM_ITEMS_MAX 32
+typedef struct { const char *what; size_t used, reserved; } MemItem;
+typedef struct { int n; MemItem item[MEM_ITEMS_MAX]; } MemReport;
+size_t mem_block(size_t n);    /* what malloc(n) really takes (glibc, 64-bit) */
+void mem_add(MemReport *r, const char *what, size_t used, size_t reserved);
+size_t mem_total(const MemReport *r, size_t *used);   /* reserved, and used when given */
+void mem_print(const MemReport *r, FILE *f);
+/* process-wide cap on reserved bytes, 0 for none; loaders and the stable API refuse to go past it */
+void mem_set_budget(size_t bytes);
+size_t mem_budget(void);
+/* 1 (with the report on f) when r is over the budget */
+int mem_over_budget(const MemReport *r, const char *what, FILE *f);
+void graph_memory(const Graph *g, MemReport *r);   /* node arrays, edges, id map, strings, reverse index */
+size_t search_work_bytes(int n);
+void geo_memory(const Graph *g, const GeoIndex *gi, const GeoBound *gb, MemReport *r);
+void route_cache_memory(RouteCache *rc, MemReport *r);
+
+
+/* ---- parallel delta-stepping ---- */
+typedef struct DeltaStep DeltaStep;
+double ds_auto_delta(Graph *g);
+/* copies the graph into light/heavy CSR; delta <= 0 picks ds_auto_delta. rebuild after weight changes */
+DeltaStep* ds_create(Graph *g, double delta, int threads);
+void ds_free(DeltaStep *ds);
+double ds_delta(const DeltaStep *ds);
+/* one-to-all, same distances as dijkstra() bit for bit */
+void ds_run(DeltaStep *ds, int src, double *dist);
+
+#endif